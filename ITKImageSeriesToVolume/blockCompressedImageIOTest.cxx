@@ -0,0 +1,236 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkBlockCompressedImageIO.h"
+
+#include <itksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+   Round trip of block compressed volumes (.vbz): a volume of 23 slices
+   cut into blocks of 4 slices, the last one partial, is written in slabs
+   of various sizes, not multiples of the block, then read back whole and
+   by ranges of slices starting and ending inside blocks, with every
+   codec built in. Truncated and corrupt files must be rejected.
+ */
+
+namespace
+{
+  const unsigned int Width  = 7;
+  const unsigned int Height = 5;
+  const unsigned int Slices = 23;
+  const unsigned int SlicesPerBlock = 4;
+
+  typedef unsigned short PixelType;
+  const size_t SliceBytes = Width * Height * sizeof(PixelType);
+
+
+  /** IO of the test volume, to write or read the slices [first, first+count). */
+  itk::BlockCompressedImageIO::Pointer CreateIO (const std::string &filename, itk::BlockCompressedImageIO::CodecType codec)
+  {
+    itk::BlockCompressedImageIO::Pointer io = itk::BlockCompressedImageIO::New();
+    io->SetFileName (filename.c_str());
+    io->SetCodec (codec);
+    io->SetBlockSize (SlicesPerBlock * SliceBytes);
+    io->SetNumberOfDimensions (3);
+    io->SetDimensions (0, Width);
+    io->SetDimensions (1, Height);
+    io->SetDimensions (2, Slices);
+    io->SetComponentType (itk::ImageIOBase::USHORT);
+    io->SetNumberOfComponents (1);
+    for (unsigned int i=0; i<3; i++)
+    {
+      io->SetSpacing (i, 0.5 + i);
+      io->SetOrigin (i, -1.0 * i);
+      std::vector<double> direction (3, 0.0);
+      direction[i] = 1.0;
+      io->SetDirection (i, direction);
+    }
+    return io;
+  }
+
+
+  void SetSlices (itk::ImageIOBase *io, unsigned int first, unsigned int count)
+  {
+    itk::ImageIORegion region (3);
+    region.SetIndex (0, 0);
+    region.SetIndex (1, 0);
+    region.SetIndex (2, first);
+    region.SetSize (0, Width);
+    region.SetSize (1, Height);
+    region.SetSize (2, count);
+    io->SetIORegion (region);
+  }
+
+
+  /** Write the volume in slabs of slabSlices, read it back by ranges. */
+  bool RoundTrip (const std::string &filename, itk::BlockCompressedImageIO::CodecType codec,
+                  const std::vector<PixelType> &volume, unsigned int slabSlices)
+  {
+    itk::BlockCompressedImageIO::Pointer writer = CreateIO (filename, codec);
+    for (unsigned int first=0; first<Slices; first+=slabSlices)
+    {
+      const unsigned int count = std::min (slabSlices, Slices - first);
+      SetSlices (writer, first, count);
+      writer->Write (&volume[first * Width * Height]);
+    }
+
+    itk::BlockCompressedImageIO::Pointer reader = itk::BlockCompressedImageIO::New();
+    reader->SetFileName (filename.c_str());
+    reader->ReadImageInformation();
+    if (reader->GetNumberOfDimensions()!=3 || reader->GetDimensions (2)!=Slices
+        || reader->GetComponentType()!=itk::ImageIOBase::USHORT || reader->GetSpacing (1)!=1.5)
+    {
+      std::cerr << "codec " << codec << ", slabs of " << slabSlices << ": wrong header" << std::endl;
+      return false;
+    }
+
+    // whole volume, single slices, and ranges across block boundaries
+    static const unsigned int ranges[][2] = { {0, Slices}, {0, 1}, {3, 1}, {4, 4}, {1, 6}, {3, 10},
+                                              {5, 13}, {19, 4}, {20, 3}, {22, 1}, {2, 21} };
+    for (unsigned int r=0; r<sizeof(ranges)/sizeof(ranges[0]); r++)
+    {
+      const unsigned int first = ranges[r][0], count = ranges[r][1];
+      std::vector<PixelType> slices (count * Width * Height + 1);
+      SetSlices (reader, first, count);
+      reader->Read (&slices[0]);
+      if (memcmp (&slices[0], &volume[first * Width * Height], count * SliceBytes)!=0)
+      {
+        std::cerr << "codec " << codec << ", slabs of " << slabSlices << ": slices "
+                  << first << " to " << first + count - 1 << " differ" << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+
+  bool Throws (const std::string &filename)
+  {
+    itk::BlockCompressedImageIO::Pointer reader = itk::BlockCompressedImageIO::New();
+    reader->SetFileName (filename.c_str());
+    try
+    {
+      reader->ReadImageInformation();
+    }
+    catch (itk::ExceptionObject &)
+    {
+      return true;
+    }
+    return false;
+  }
+
+
+  /** A truncated file, and a block index pointing out of the file, are
+      rejected when the header is read. */
+  bool RejectsCorruptFiles (const std::string &filename, const std::vector<PixelType> &volume)
+  {
+    itk::BlockCompressedImageIO::Pointer writer = CreateIO (filename, itk::BlockCompressedImageIO::Uncompressed);
+    SetSlices (writer, 0, Slices);
+    writer->Write (&volume[0]);
+
+    std::string data;
+    {
+      std::ifstream in (filename.c_str(), std::ios::binary);
+      data.assign ((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+    const unsigned int blocks = (Slices + SlicesPerBlock - 1) / SlicesPerBlock;
+    const unsigned long headerSize = static_cast<unsigned char>(data[8]) | static_cast<unsigned char>(data[9]) << 8
+      | static_cast<unsigned char>(data[10]) << 16 | static_cast<unsigned long>(static_cast<unsigned char>(data[11])) << 24;
+
+    std::ofstream (filename.c_str(), std::ios::binary).write (data.data(), data.size() - SliceBytes / 2);
+    if (!Throws (filename))
+    {
+      std::cerr << "truncated file accepted" << std::endl;
+      return false;
+    }
+
+    // offset of the last block beyond the end of the file
+    std::string corrupt (data);
+    corrupt[headerSize - 16 + 7] = '\x40';
+    std::ofstream (filename.c_str(), std::ios::binary).write (corrupt.data(), corrupt.size());
+    if (!Throws (filename))
+    {
+      std::cerr << "block beyond the end of the file accepted" << std::endl;
+      return false;
+    }
+
+    // first block inside the index
+    corrupt = data;
+    corrupt[headerSize - blocks * 16] = 0;
+    corrupt[headerSize - blocks * 16 + 1] = 0;
+    std::ofstream (filename.c_str(), std::ios::binary).write (corrupt.data(), corrupt.size());
+    if (!Throws (filename))
+    {
+      std::cerr << "block inside the index accepted" << std::endl;
+      return false;
+    }
+    return true;
+  }
+}
+
+
+int main (int, char *[])
+{
+  // smooth ramps that compress, with noise that does not
+  std::vector<PixelType> volume (Slices * Width * Height);
+  unsigned int seed = 1;
+  for (size_t i=0; i<volume.size(); i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    volume[i] = static_cast<PixelType>(i % 97 * 300 + (i / (Width * Height) % 2 ? seed >> 20 : 0));
+  }
+
+  const std::string filename = "blockCompressedImageIOTest.vbz";
+  static const itk::BlockCompressedImageIO::CodecType codecs[] = {
+    itk::BlockCompressedImageIO::Uncompressed, itk::BlockCompressedImageIO::Deflate,
+    itk::BlockCompressedImageIO::Zstd, itk::BlockCompressedImageIO::Lz4 };
+  static const unsigned int slabs[] = { Slices, 1, 3, 5, 6, 9 };
+
+  unsigned int failures = 0, runs = 0;
+  for (unsigned int c=0; c<sizeof(codecs)/sizeof(codecs[0]); c++)
+  {
+    if (!itk::BlockCompressedImageIO::IsCodecAvailable (codecs[c]))
+      continue;
+    for (unsigned int s=0; s<sizeof(slabs)/sizeof(slabs[0]); s++, runs++)
+    {
+      try
+      {
+        if (!RoundTrip (filename, codecs[c], volume, slabs[s]))
+          failures++;
+      }
+      catch (itk::ExceptionObject &e)
+      {
+        std::cerr << "codec " << codecs[c] << ", slabs of " << slabs[s] << ": " << e << std::endl;
+        failures++;
+      }
+    }
+  }
+  runs++;
+  if (!RejectsCorruptFiles (filename, volume))
+    failures++;
+  itksys::SystemTools::RemoveFile (filename.c_str());
+
+  std::cout << runs - failures << " of " << runs << " round trips passed" << std::endl;
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
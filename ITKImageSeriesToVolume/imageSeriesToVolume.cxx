@@ -15,33 +15,628 @@
 
 =========================================================================*/
 #include <iostream>
+#include <fstream>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <ctime>
 #include "GetPot.h"
 
-#include <itkImageSeriesReader.h>
 #include <itkImage.h>
 #include <itkImageFileWriter.h>
+#include <itkImageIOFactory.h>
+#include <itkMultiThreader.h>
+#include <itkRealTimeClock.h>
 
 #include <itksys/SystemTools.hxx>
 #include <itksys/Directory.hxx>
 
+#include "itkSeriesToVolumeAssembler.h"
+#include "itkSeriesToVolumeUtilities.h"
+#include "itkDirectoryWatcher.h"
+#include "itkGrowingVolumeWriter.h"
+#include "itkSliceHashes.h"
+#include "itkCompressedSliceIO.h"
+#include "itkSliceArchive.h"
+#include "itkBlockCompressedImageIO.h"
+#include "itkBlockCompressedImageIOFactory.h"
+
 void PrintHelp (const char* exec)
 {
   std::cout << "Usage:\n";
-  std::cout << exec << " <-sx x spacing (default: image)> <-sy y spacing (default: image)> <-sz z spacing (default: image)> <-st t spacing (default: 1.0)> <-o output (default: output.nii.gz)> <-i input1 input2 ...> <-d directory>\n";
+  std::cout << exec << " <-sx x spacing (default: image)> <-sy y spacing (default: image)> <-sz z spacing (default: image, or the slice positions for 2D slices, else 1.0)> <-st t spacing (default: slice positions, else 1.0)> <--resample (resample unevenly spaced slices to their mean spacing)> <-o output (default: output.nii.gz)> <--max-memory size, e.g. 512M or 4G (default: unlimited)> <--codec zstd|lz4|deflate|none (.vbz output: block compressed volume, read in parallel; default: zstd if built in)> <--block-size size of the .vbz blocks (default: 4M)> <--crop-empty (drop constant slices at both ends)> <-t output type: uchar, char, ushort, short or float (default: uchar for 2D, short for 3D inputs)> <--rescale linear|percentile|lut (default: cast)> <--range min max (linear, default: sampled)> <--percentiles low high (default: 0.5 99.5)> <--lut table file, one output value per input value> <--raw width height type (size and pixel type of .raw slices; .raw, .pgm, .gz and .zst slices are streamed)> <--tolerate constant|interpolate (fill the slices that cannot be decoded, listed in output.failures.txt)> <--fill value (default: 0)> <--mip (write maximum intensity projections and a thumbnail as png)> <--verify (store a hash of each output slice in output.xxh64)> <--numa (bind the decoding threads to NUMA nodes, report per-node bandwidth)> <--follow (with -d: append the slices as they are written to a growing .mhd output)> <--marker file name ending the acquisition (default: done)> <-a archive.tar or archive.zip (slices in name order; raw, PGM, .gz and .zst slices decoded in memory, the other formats through a temporary file, in /dev/shm if any)> <-i input1 input2 ...> <-d directory>\n";
+  std::cout << exec << " --check volume <--max-memory size (default: 256M slabs)>\n";
+  std::cout << "  compare the slices of volume with the hashes stored by --verify, read slab by slab\n";
+  std::cout << exec << " --spool directory <--poll seconds (default: 1.0)>\n";
+  std::cout << "  serve the jobs dropped in directory/<submitter>/<name>.job, one argument per line\n";
 }
 
 
-int main (int argc, char* argv[])
+/**
+   Command line options of a conversion.
+ */
+struct ConversionOptions
+{
+  std::string        Output;
+  unsigned long long MaxMemory;
+  bool               CropEmpty;
+  bool               Resample;
+  std::string        PixelType;
+  std::string        Rescale;
+  double             Range[2];
+  double             Percentiles[2];
+  std::string        LookupTable;
+  std::string        Codec;
+  unsigned long long BlockSize;
+  bool               Verify;
+  bool               Projections;
+  itk::SliceInformation RawSlice;
+  std::string        Tolerate;
+  double             FillValue;
+  bool               Numa;
+  bool               Follow;
+  std::string        Marker;
+  itk::DirectoryWatcher::Pointer Watcher;
+  itk::SliceArchive::Pointer     Archive;
+  itk::SliceBufferPool::Pointer  BufferPool;
+};
+
+
+/**
+   Read a lookup table: whitespace separated output values, the k-th one
+   being used for input value k.
+ */
+template <class TPixel>
+bool ReadLookupTable (const std::string &filename, std::vector<TPixel> &table)
+{
+  std::ifstream file (filename.c_str());
+  double value;
+  while (file >> value)
+    table.push_back (static_cast<TPixel>(value));
+  return !table.empty();
+}
+
+
+/**
+   Store the slice hashes of a converted volume next to it.
+ */
+bool WriteHashes (const std::string &volume, const std::vector<unsigned long long> &hashes,
+                  const std::vector<std::string> &sources)
+{
+  const std::string filename = itk::GetSliceHashesFileName (volume);
+  if (!itk::WriteSliceHashes (filename, hashes, sources))
+  {
+    std::cerr << "Error: cannot write " << filename << std::endl;
+    return false;
+  }
+  std::cout << "Hashes: " << filename << std::endl;
+  return true;
+}
+
+
+/**
+   Re-hash the slices of a volume, slab by slab within maxMemory and in
+   parallel, and compare them with the hashes stored when it was
+   converted.
+ */
+int CheckVolume (const std::string &volume, unsigned long long maxMemory)
+{
+  std::vector<unsigned long long> expected, hashes;
+  std::vector<std::string> sources;
+  const std::string filename = itk::GetSliceHashesFileName (volume);
+  if (!itk::ReadSliceHashes (filename, expected, sources))
+  {
+    std::cerr << "Error: cannot read " << filename << std::endl;
+    return -1;
+  }
+
+  try
+  {
+    itk::HashVolumeSlices (volume, itk::MultiThreader::GetGlobalDefaultNumberOfThreads(), maxMemory, hashes);
+  }
+  catch (itk::ExceptionObject &e)
+  {
+    std::cerr << e;
+    return -1;
+  }
+
+  if (hashes.size()!=expected.size())
+  {
+    std::cerr << volume << " has " << hashes.size() << " slices, "
+              << expected.size() << " were converted" << std::endl;
+    return -1;
+  }
+
+  unsigned int mismatches = 0;
+  for (unsigned int i=0; i<hashes.size(); i++)
+  {
+    if (hashes[i]!=expected[i])
+    {
+      std::cout << "slice " << i << " differs";
+      if (!sources[i].empty())
+        std::cout << " (" << sources[i] << ")";
+      std::cout << std::endl;
+      mismatches++;
+    }
+  }
+  std::cout << hashes.size()-mismatches << " of " << hashes.size() << " slices match" << std::endl;
+  return mismatches ? -1 : 0;
+}
+
+
+/**
+   List the slices that were filled instead of decoded in
+   <volume>.failures.txt, if any.
+ */
+template <class TAssembler>
+bool WriteFailureReport (const std::string &volume,
+                         const std::vector<typename TAssembler::SliceFailure> &failures)
+{
+  if (failures.empty())
+    return true;
+
+  const std::string filename = volume + ".failures.txt";
+  std::ofstream report (filename.c_str());
+  for (unsigned int i=0; i<failures.size(); i++)
+  {
+    report << "slice " << failures[i].Slice << " " << failures[i].FileName << ": "
+           << (failures[i].Interpolated ? "interpolated" : "filled") << ", "
+           << failures[i].Description << "\n";
+  }
+  if (!report)
+  {
+    std::cerr << "Error: cannot write " << filename << std::endl;
+    return false;
+  }
+  std::cout << "Warning: " << failures.size() << " slices could not be decoded, see " << filename << std::endl;
+  return true;
+}
+
+
+/**
+   Write a 2D image as an 8-bit png, its range stretched to [0, 255].
+ */
+template <class TImage>
+void WritePreview (const TImage *image, const std::string &filename)
+{
+  typedef itk::Image<unsigned char, 2> PreviewType;
+
+  const typename TImage::PixelType *in = image->GetBufferPointer();
+  const unsigned long n = image->GetBufferedRegion().GetNumberOfPixels();
+  double minimum = n ? in[0] : 0.0, maximum = minimum;
+  for (unsigned long i=1; i<n; i++)
+  {
+    minimum = std::min<double> (minimum, in[i]);
+    maximum = std::max<double> (maximum, in[i]);
+  }
+  const double scale = maximum>minimum ? 255.0 / (maximum-minimum) : 0.0;
+
+  PreviewType::Pointer preview = PreviewType::New();
+  preview->SetRegions (image->GetBufferedRegion());
+  preview->Allocate();
+  unsigned char *out = preview->GetBufferPointer();
+  for (unsigned long i=0; i<n; i++)
+    out[i] = static_cast<unsigned char>((in[i]-minimum) * scale + 0.5);
+
+  typedef itk::ImageFileWriter<PreviewType> WriterType;
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetFileName (filename.c_str());
+  writer->SetInput (preview);
+  writer->Update();
+  std::cout << "Projection: " << filename << std::endl;
+}
+
+
+/**
+   Set up the assembler from the command line options, except its input
+   file names.
+ */
+template <class TAssembler>
+bool ConfigureAssembler (GetPot &cl, TAssembler *assembler, const ConversionOptions &options)
+{
+  typedef typename TAssembler::OutputImageType::PixelType PixelType;
+
+  const unsigned int Dimension = TAssembler::OutputImageType::ImageDimension;
+
+  // the image spacing is kept unless overridden, the stacking dimension
+  // defaults to the slice positions, else 1.0
+  static const char *spacingOptions[4][2] = { {"-sx", "-SX"}, {"-sy", "-SY"}, {"-sz", "-SZ"}, {"-st", "-ST"} };
+  for (unsigned int i=0; i<Dimension; i++)
+  {
+    if (cl.search (2, spacingOptions[i][0], spacingOptions[i][1]))
+      assembler->SetSpacing (i, cl.next (1.0));
+  }
+
+  assembler->SetCropEmptySlices ( options.CropEmpty );
+  assembler->SetResampleNonUniformSpacing ( options.Resample );
+  assembler->SetMaxMemory ( options.MaxMemory );
+  assembler->SetNumaPlacement ( options.Numa );
+  assembler->SetComputeSliceHashes ( options.Verify );
+  assembler->SetComputeProjections ( options.Projections );
+  assembler->SetRawSliceInformation ( options.RawSlice );
+
+  itk::BlockCompressedImageIO::Pointer io = itk::BlockCompressedImageIO::New();
+  if (io->CanWriteFile (options.Output.c_str()))
+  {
+    itk::BlockCompressedImageIO::CodecType codec = io->GetCodec();
+    if (!options.Codec.empty())
+      itk::BlockCompressedImageIO::ParseCodec (options.Codec, codec);
+    io->SetCodec (codec);
+    if (options.BlockSize)
+      io->SetBlockSize (options.BlockSize);
+    assembler->SetImageIO (io);
+  }
+  if (!options.Tolerate.empty())
+  {
+    assembler->SetTolerateFailures ( true );
+    assembler->SetFailureFill ( options.Tolerate=="interpolate" ? TAssembler::InterpolateFill : TAssembler::ConstantFill );
+    assembler->SetFillValue ( options.FillValue );
+  }
+
+  if (options.Rescale=="lut")
+  {
+    std::vector<PixelType> table;
+    if (!ReadLookupTable (options.LookupTable, table))
+    {
+      std::cerr << "Error: cannot read lookup table " << options.LookupTable << std::endl;
+      return false;
+    }
+    assembler->SetLookupTable (table, 0.0);
+    assembler->SetRescaleMode (TAssembler::LookupTableRescale);
+  }
+  else if (options.Rescale=="linear")
+  {
+    assembler->SetInputRange (options.Range[0], options.Range[1]);
+    assembler->SetRescaleMode (TAssembler::LinearRescale);
+  }
+  else if (options.Rescale=="percentile")
+  {
+    assembler->SetPercentiles (options.Percentiles[0], options.Percentiles[1]);
+    assembler->SetRescaleMode (TAssembler::PercentileRescale);
+  }
+
+  return true;
+}
+
+
+/**
+   Append the slices to the output as they are written in the watched
+   directory, until the marker file appears. Each slice goes through the
+   assembler on its own, so that it is decoded, converted and rescaled
+   exactly as in a one-shot conversion.
+ */
+template <class TImage>
+int FollowSeries (itk::SeriesToVolumeAssembler<TImage> *assembler,
+                  const std::vector<std::string> &filenames, const ConversionOptions &options)
+{
+  typedef itk::SeriesToVolumeAssembler<TImage> AssemblerType;
+  typedef itk::GrowingVolumeWriter<TImage>     WriterType;
+
+  typename WriterType::Pointer writer = WriterType::New();
+  std::vector<unsigned long long> hashes;
+  std::vector<std::string> sources;
+  std::vector<typename AssemblerType::SliceFailure> failures;
+  std::set<std::string> appended;
+  std::vector<std::string> pending (filenames);
+  bool finished = false;
+
+  std::cout << "Following into: " << options.Output << std::endl;
+  try
+  {
+    writer->SetFileName (options.Output);
+    for (;;)
+    {
+      for (unsigned int i=0; i<pending.size(); i++)
+      {
+        if (pending[i]==options.Marker || !appended.insert (pending[i]).second)
+          continue;
+
+        assembler->SetFileNames (std::vector<std::string> (1, pending[i]));
+        assembler->Update();
+        writer->Append (assembler->GetOutput());
+        if (!assembler->GetSliceFailures().empty())
+        {
+          failures.push_back (assembler->GetSliceFailures()[0]);
+          failures.back().Slice = writer->GetNumberOfSlices()-1;
+        }
+        if (options.Verify)
+        {
+          hashes.push_back (assembler->GetSliceHashes()[0]);
+          sources.push_back (pending[i]);
+        }
+        std::cout << pending[i] << " (" << writer->GetNumberOfSlices() << ")" << std::endl;
+      }
+      pending.clear();
+
+      if (finished)
+        break;
+      // once the marker is there, the last slices are collected without waiting
+      finished = itksys::SystemTools::FileExists (options.Marker.c_str());
+      options.Watcher->WaitForFiles (finished ? 0.0 : 1.0, pending);
+    }
+    writer->Close();
+  }
+  catch (itk::ExceptionObject &e)
+  {
+    std::cerr << e;
+    return -1;
+  }
+
+  std::cout << "Done: " << writer->GetNumberOfSlices() << " slices." << std::endl;
+  if (!WriteFailureReport<AssemblerType> (options.Output, failures))
+    return -1;
+  if (options.Verify && !WriteHashes (options.Output, hashes, sources))
+    return -1;
+  return 0;
+}
+
+
+template <class TImage>
+int ConvertSeries (GetPot &cl, const std::vector<std::string> &filenames,
+                   const ConversionOptions &options)
+{
+  typedef itk::SeriesToVolumeAssembler<TImage> AssemblerType;
+
+  typename AssemblerType::Pointer assembler = AssemblerType::New();
+  // the scratch buffers of a previous conversion of the process, if any
+  if (options.BufferPool.IsNotNull())
+    assembler->SetBufferPool (options.BufferPool);
+  if (!ConfigureAssembler (cl, assembler.GetPointer(), options))
+    return -1;
+
+  if (options.Follow)
+    return FollowSeries<TImage> (assembler, filenames, options);
+
+  std::cout << "Adding:\n";
+  if (options.Archive)
+    assembler->SetArchive ( options.Archive );
+  for (unsigned int i=0; i<filenames.size(); i++)
+  {
+    std::cout << filenames[i] << std::endl;
+    if (!options.Archive)
+      assembler->AddFileName ( filenames[i] );
+  }
+
+  try
+  {
+    // the plan may change the number of threads: made first, so that
+    // Write does not generate the output information again
+    assembler->PlanWrite ( options.Output );
+    assembler->UpdateOutputInformation();
+
+    if (options.CropEmpty)
+    {
+      std::cout << "Cropping " << assembler->GetFirstSlice() << " leading and "
+                << filenames.size()-1-assembler->GetLastSlice() << " trailing empty slices" << std::endl;
+    }
+    const unsigned int axis = TImage::ImageDimension-1;
+    const double *gaps = assembler->GetSliceGapRange();
+    if (assembler->GetSlicePositionsFound())
+    {
+      std::cout << "Slice spacing " << assembler->GetOutput()->GetSpacing()[axis] << " from the slice positions";
+      if (!assembler->GetUniformSpacing())
+      {
+        std::cout << ", uneven gaps [" << gaps[0] << ", " << gaps[1] << "]"
+                  << (options.Resample ? ", resampled" : ", use --resample to resample them");
+      }
+      std::cout << std::endl;
+    }
+    else if (!cl.search (2, axis==2 ? "-sz" : "-st", axis==2 ? "-SZ" : "-ST"))
+    {
+      std::cout << "Warning: the slice positions are unknown, the slices are 1.0 apart: give their spacing with "
+                << (axis==2 ? "-sz" : "-st") << std::endl;
+    }
+    if (options.Rescale=="linear" || options.Rescale=="percentile")
+    {
+      std::cout << "Rescaling [" << assembler->GetRescaleRange()[0] << ", "
+                << assembler->GetRescaleRange()[1] << "]" << std::endl;
+    }
+
+    std::cout << "Writing: " << options.Output << std::flush;
+    assembler->Write ( options.Output );
+    std::cout << " Done." << std::endl;
+
+    if (!WriteFailureReport<AssemblerType> (options.Output, assembler->GetSliceFailures()))
+      return -1;
+
+    if (options.Verify)
+    {
+      // slices are named after their input, unless resampling changed
+      // their number
+      std::vector<std::string> sources (filenames.begin() + assembler->GetFirstSlice(),
+                                        filenames.begin() + assembler->GetLastSlice() + 1);
+      if (sources.size()!=assembler->GetSliceHashes().size())
+        sources.clear();
+      if (!WriteHashes (options.Output, assembler->GetSliceHashes(), sources))
+        return -1;
+    }
+
+    if (options.Projections)
+    {
+      // base name of the output, without .gz and its image extension
+      std::string base = options.Output;
+      if (itksys::SystemTools::GetFilenameLastExtension (base)==".gz")
+        base = base.substr (0, base.size()-3);
+      base = base.substr (0, base.size() - itksys::SystemTools::GetFilenameLastExtension (base).size());
+
+      static const char *names[3] = { "_mip_yz.png", "_mip_xz.png", "_mip_xy.png" };
+      for (unsigned int axis=0; axis<3; axis++)
+        WritePreview (assembler->GetProjection (axis).GetPointer(), base + names[axis]);
+      WritePreview (assembler->GetMiddleSlice().GetPointer(), base + "_thumbnail.png");
+    }
+  }
+  catch (itk::ExceptionObject &e)
+  {
+    std::cerr << e;
+    return -1;
+  }
+
+  if (options.MaxMemory)
+  {
+    const itk::MemoryPlan &plan = assembler->GetMemoryPlan();
+    std::cout << "Memory budget: " << (options.MaxMemory>>20) << " MB, volume: " << (plan.VolumeBytes>>20)
+              << " MB, slabs: " << plan.NumberOfStreamDivisions
+              << ", threads: " << plan.NumberOfThreads << std::endl;
+    std::cout << "Peak memory: " << (itk::GetPeakMemoryUsage()>>20) << " MB" << std::endl;
+  }
+
+  if (options.Numa)
+  {
+    const std::vector<itk::NumaNodeStatistics> &nodes = assembler->GetNumaNodeStatistics();
+    for (unsigned int n=0; n<nodes.size(); n++)
+    {
+      std::cout << "NUMA node " << n << ": " << (nodes[n].Bytes>>20) << " MB in " << nodes[n].Seconds << " s";
+      if (nodes[n].Seconds > 0.0)
+        std::cout << " (" << static_cast<unsigned long long>((nodes[n].Bytes>>20) / nodes[n].Seconds) << " MB/s)";
+      std::cout << std::endl;
+    }
+  }
+
+  return 0;
+}
+
+
+template <unsigned int VDimension>
+int ConvertSeriesAs (GetPot &cl, const std::vector<std::string> &filenames,
+                     const ConversionOptions &options, const char *defaultType)
+{
+  const std::string type = options.PixelType.empty() ? defaultType : options.PixelType;
+
+  if (type=="uchar")
+    return ConvertSeries< itk::Image<unsigned char, VDimension> > (cl, filenames, options);
+  if (type=="char")
+    return ConvertSeries< itk::Image<char, VDimension> > (cl, filenames, options);
+  if (type=="ushort")
+    return ConvertSeries< itk::Image<unsigned short, VDimension> > (cl, filenames, options);
+  if (type=="short")
+    return ConvertSeries< itk::Image<short, VDimension> > (cl, filenames, options);
+  if (type=="float")
+    return ConvertSeries< itk::Image<float, VDimension> > (cl, filenames, options);
+
+  std::cerr << "Error: unknown output type " << type << std::endl;
+  return -1;
+}
+
+
+/**
+   Dimension of a slice file read with its ImageIO, without its trailing
+   dimensions of size 1, 0 if there is none.
+ */
+unsigned int GetSliceDimension (const std::string &filename)
+{
+  itk::ImageIOBase::Pointer io = itk::ImageIOFactory::CreateImageIO (filename.c_str(), itk::ImageIOFactory::ReadMode);
+  if (io.IsNull())
+    return 0;
+
+  io->SetFileName (filename.c_str());
+  io->ReadImageInformation();
+
+  // a DICOM slice is read as a volume of one slice
+  unsigned int dimension = io->GetNumberOfDimensions();
+  while (dimension>2 && io->GetDimensions (dimension-1)==1)
+    dimension--;
+  return dimension;
+}
+
+
+/**
+   Convert as told by a command line; the assembler takes its scratch
+   buffers from pool if given, else from a pool of its own.
+ */
+int ConvertCommandLine (int argc, char* argv[], itk::SliceBufferPool *pool = 0)
 {
 
   GetPot cl (argc, argv);
-  if( cl.size()==1 || cl.search (2,"-h","--help") )
+
+  ConversionOptions options;
+  options.BufferPool = pool;
+  options.Output = cl.follow ("output.nii.gz", 2, "-o", "-O");
+
+  options.MaxMemory = 0;
+  if (cl.search ("--max-memory"))
   {
-    PrintHelp (cl[0]);
+    options.MaxMemory = itk::ParseMemorySize (cl.next (""));
+    if (!options.MaxMemory)
+    {
+      std::cerr << "Error: invalid --max-memory value" << std::endl;
+      return -1;
+    }
+  }
+
+  options.Codec = cl.follow ("", "--codec");
+  itk::BlockCompressedImageIO::CodecType codec;
+  if (!options.Codec.empty() && !itk::BlockCompressedImageIO::ParseCodec (options.Codec, codec))
+  {
+    std::cerr << "Error: unknown codec " << options.Codec << ", or not built in" << std::endl;
     return -1;
   }
+  options.BlockSize = 0;
+  if (cl.search ("--block-size"))
+  {
+    options.BlockSize = itk::ParseMemorySize (cl.next (""));
+    if (!options.BlockSize)
+    {
+      std::cerr << "Error: invalid --block-size value" << std::endl;
+      return -1;
+    }
+  }
+
+  options.CropEmpty = cl.search ("--crop-empty");
+  options.Resample  = cl.search ("--resample");
+  options.Numa      = cl.search ("--numa");
+  options.Verify    = cl.search ("--verify");
+  options.Projections = cl.search ("--mip");
+  if (cl.search ("--raw"))
+  {
+    options.RawSlice.Size.resize (2);
+    options.RawSlice.Size[0] = cl.next (0);
+    options.RawSlice.Size[1] = cl.next (0);
+    options.RawSlice.ComponentType = itk::ParseComponentType (cl.next ("uchar"));
+    options.RawSlice.Spacing.assign (2, 1.0);
+    options.RawSlice.Origin.assign (2, 0.0);
+    options.RawSlice.Direction.assign (2, std::vector<double> (2, 0.0));
+    options.RawSlice.Direction[0][0] = options.RawSlice.Direction[1][1] = 1.0;
+    if (!options.RawSlice.GetSizeInBytes())
+    {
+      std::cerr << "Error: invalid --raw size or type" << std::endl;
+      return -1;
+    }
+  }
 
-  const char* output = cl.follow ("output.nii.gz", 2, "-o", "-O");
+  options.Tolerate  = cl.follow ("", "--tolerate");
+  options.FillValue = cl.follow (0.0, "--fill");
+  if (options.Tolerate!="" && options.Tolerate!="constant" && options.Tolerate!="interpolate")
+  {
+    std::cerr << "Error: unknown fill " << options.Tolerate << std::endl;
+    return -1;
+  }
+
+  options.PixelType   = cl.follow ("", 2, "-t", "-T");
+  options.LookupTable = cl.follow ("", "--lut");
+  options.Rescale     = cl.follow (options.LookupTable.empty() ? "" : "lut", "--rescale");
+  if (options.Rescale!="" && options.Rescale!="linear" && options.Rescale!="percentile" && options.Rescale!="lut")
+  {
+    std::cerr << "Error: unknown rescaling " << options.Rescale << std::endl;
+    return -1;
+  }
+
+  options.Range[0] = options.Range[1] = 0.0;
+  if (cl.search ("--range"))
+  {
+    options.Range[0] = cl.next (0.0);
+    options.Range[1] = cl.next (0.0);
+  }
+
+  options.Percentiles[0] = 0.5;
+  options.Percentiles[1] = 99.5;
+  if (cl.search ("--percentiles"))
+  {
+    options.Percentiles[0] = cl.next (0.5);
+    options.Percentiles[1] = cl.next (99.5);
+  }
+
+  options.Follow = cl.search ("--follow");
+  options.Marker = cl.follow ("done", "--marker");
 
   std::vector<std::string> filenames;
 
@@ -53,11 +648,59 @@ int main (int argc, char* argv[])
   }
 
   std::string s_directory = cl.follow ("directory", 2, "-d", "-D");
+
+  const std::string archive = cl.follow ("", 2, "-a", "-A");
+  if (!archive.empty())
+  {
+    if (options.Follow || !filenames.empty())
+    {
+      std::cerr << "Error: -a cannot be combined with -i or --follow" << std::endl;
+      return -1;
+    }
+    options.Archive = itk::SliceArchive::New();
+    try
+    {
+      options.Archive->Open (archive);
+    }
+    catch (itk::ExceptionObject &e)
+    {
+      std::cerr << e;
+      return -1;
+    }
+    for (unsigned int i=0; i<options.Archive->GetNumberOfMembers(); i++)
+      filenames.push_back (options.Archive->GetMemberName (i));
+    s_directory.clear();
+  }
+
+  if (options.Follow)
+  {
+    // every slice is converted on its own: nothing may depend on the whole series
+    if (options.CropEmpty || options.Projections || options.Resample || options.Rescale=="percentile"
+        || (options.Rescale=="linear" && options.Range[0]==options.Range[1]))
+    {
+      std::cerr << "Error: --follow cannot crop, project, resample or estimate a rescaling range, use --range or --lut" << std::endl;
+      return -1;
+    }
+    if (itksys::SystemTools::GetFilenameLastExtension (options.Output)!=".mhd")
+    {
+      std::cerr << "Error: --follow writes a MetaImage, the output must end with .mhd" << std::endl;
+      return -1;
+    }
+    // watching starts before listing so that no slice falls in between
+    options.Watcher = itk::DirectoryWatcher::New();
+    if (!options.Watcher->Watch (s_directory))
+    {
+      std::cerr << "Error: cannot watch directory " << s_directory << std::endl;
+      return -1;
+    }
+    options.Marker = s_directory + "/" + options.Marker;
+  }
+
   if ( itksys::SystemTools::FileIsDirectory ( s_directory.c_str() ) )
   {
     itksys::Directory directory;
     directory.Load( s_directory.c_str() );
-        
+
     for( unsigned long i=0; i<directory.GetNumberOfFiles(); i++ )
     {
       std::string name = directory.GetPath();
@@ -74,6 +717,17 @@ int main (int argc, char* argv[])
     }
   }
 
+  if (options.Follow)
+  {
+    std::sort (filenames.begin(), filenames.end());
+    filenames.erase (std::remove (filenames.begin(), filenames.end(), options.Marker), filenames.end());
+
+    // the pixel type of the output is known with the first slice
+    while (filenames.empty() && !itksys::SystemTools::FileExists (options.Marker.c_str()))
+      options.Watcher->WaitForFiles (1.0, filenames);
+    filenames.erase (std::remove (filenames.begin(), filenames.end(), options.Marker), filenames.end());
+  }
+
 
   if (!filenames.size())
   {
@@ -83,127 +737,249 @@ int main (int argc, char* argv[])
 
 
 
-  itk::ImageIOBase::Pointer io = itk::ImageIOFactory::CreateImageIO (filenames[0].c_str(), itk::ImageIOFactory::ReadMode);
-  if (io.IsNull())
-    return -1;
-
-  io->SetFileName (filenames[0].c_str());
-  io->ReadImageInformation();
-
-  if (io->GetNumberOfDimensions()==2) {
-    
-    typedef itk::Image<unsigned char, 3>      ImageType;
-    typedef itk::ImageSeriesReader<ImageType> SeriesReaderType;
-    
-    
-    SeriesReaderType::Pointer reader = SeriesReaderType::New();
-    std::cout << "Adding:\n";
-    for (unsigned int i=0; i<filenames.size(); i++)
-    {
-      std::cout << filenames[i] << std::endl;
-      reader->AddFileName ( filenames[i].c_str() );
-    }
-    
+  // streamed raw and PGM slices are 2D
+  unsigned int dimension = 2;
+  if (!itk::CanReadCompressedSlice (filenames[0]))
+  {
     try
     {
-      reader->Update();
+      if (options.Archive)
+      {
+        itk::SliceArchive::ScopedExtraction first (options.Archive, 0);
+        dimension = GetSliceDimension (first.GetFileName());
+      }
+      else
+        dimension = GetSliceDimension (filenames[0]);
     }
     catch (itk::ExceptionObject &e)
     {
       std::cerr << e;
       return -1;
     }
+    if (!dimension)
+      return -1;
+  }
 
+  if (dimension==2)
+  {
+    return ConvertSeriesAs<3> (cl, filenames, options, "uchar");
+  }
+  else if (dimension==3)
+  {
+    return ConvertSeriesAs<4> (cl, filenames, options, "short");
+  }
 
-    double spacingX = cl.follow (io->GetSpacing (0), 2, "-sx", "-SX");
-    double spacingY = cl.follow (io->GetSpacing (1), 2, "-sy", "-SY");
-    double spacingZ = cl.follow (1.0, 2, "-sz", "-SZ");
-    
-    
-    ImageType::Pointer image = reader->GetOutput();
-    ImageType::SpacingType spacing = image->GetSpacing();
-    spacing[0] = spacingX;
-    spacing[1] = spacingY;
-    spacing[2] = spacingZ;
-    image->SetSpacing (spacing);
-    
-    typedef itk::ImageFileWriter<ImageType> OutputWriterType;
-    {
-      OutputWriterType::Pointer writer = OutputWriterType::New();
-      writer->SetFileName ( output );
-      writer->SetInput ( image );
-      
-      std::cout << "Writing: " << output << std::flush;
-      try
-      {
-      writer->Update();
-      }
-      catch (itk::ExceptionObject &e)
-      {
-	std::cerr << e;
-	return -1;
-      }
-      std::cout << " Done." << std::endl;
-    }
+
+  return 0;
+
+}
+
+
+/** Send std::cout and std::cerr to a stream until leaving the scope. */
+class ScopedOutputRedirection
+{
+public:
+  ScopedOutputRedirection (std::ostream &os)
+    : m_Cout (std::cout.rdbuf (os.rdbuf())),
+      m_Cerr (std::cerr.rdbuf (os.rdbuf()))
+  {}
+  ~ScopedOutputRedirection()
+  {
+    std::cout.rdbuf (m_Cout);
+    std::cerr.rdbuf (m_Cerr);
   }
-  else if (io->GetNumberOfDimensions()==3)
+
+private:
+  ScopedOutputRedirection (const ScopedOutputRedirection&);
+  void operator=(const ScopedOutputRedirection&);
+
+  std::streambuf *m_Cout;
+  std::streambuf *m_Cerr;
+};
+
+
+/**
+   Run one spooled job: name.job is renamed name.running while the
+   conversion runs with its arguments, the conversion output goes to
+   name.log and the exit status and timings to name.done, which appears
+   atomically once the job is over. The scratch buffers come from the
+   pool of the daemon, warm from the previous jobs.
+ */
+void RunSpoolJob (const std::string &job, const char *exec, itk::SliceBufferPool *pool)
+{
+  const std::string base = job.substr (0, job.size()-4);
+  const std::string running = base + ".running";
+
+  const double queued = static_cast<double>(time (0) - itksys::SystemTools::ModifiedTime (job.c_str()));
+  if (!itksys::SystemTools::RenameFile (job.c_str(), running.c_str()))
+    return;
+
+  std::vector<std::string> args (1, exec);
   {
-    
-    typedef itk::Image<short, 4>      ImageType;
-    typedef itk::ImageSeriesReader<ImageType> SeriesReaderType;
-    
-    SeriesReaderType::Pointer reader = SeriesReaderType::New();
-    std::cout << "Adding:\n";
-    for (unsigned int i=0; i<filenames.size(); i++)
+    std::ifstream file (running.c_str());
+    std::string line;
+    while (std::getline (file, line))
     {
-      std::cout << filenames[i] << std::endl;
-      reader->AddFileName ( filenames[i].c_str() );
+      if (!line.empty() && line[0]!='#')
+        args.push_back (line);
     }
-    
+  }
+  std::vector<char*> argv;
+  for (unsigned int i=0; i<args.size(); i++)
+    argv.push_back (const_cast<char*>(args[i].c_str()));
+  argv.push_back (0);
+
+  itk::ResetPeakMemoryUsage();
+  itk::RealTimeClock::Pointer clock = itk::RealTimeClock::New();
+  const double  start = clock->GetTimeStamp();
+  const clock_t cpu   = std::clock();
+
+  int status = -1;
+  {
+    std::ofstream log ((base + ".log").c_str());
+    ScopedOutputRedirection redirection (log);
     try
     {
-      reader->Update();
+      status = ConvertCommandLine (args.size(), &argv[0], pool);
     }
     catch (itk::ExceptionObject &e)
     {
       std::cerr << e;
-      return -1;
     }
+    catch (std::exception &e)
+    {
+      std::cerr << "Error: " << e.what() << std::endl;
+    }
+    catch (...)
+    {
+      std::cerr << "Error: unknown exception" << std::endl;
+    }
+  }
 
-    double spacingX = cl.follow (io->GetSpacing (0), 2, "-sx", "-SX");
-    double spacingY = cl.follow (io->GetSpacing (1), 2, "-sy", "-SY");
-    double spacingZ = cl.follow (io->GetSpacing (2), 2, "-sz", "-SZ");
-    double spacingT = cl.follow (1.0, 2, "-st", "-ST");
-    
-    ImageType::Pointer image = reader->GetOutput();
-    ImageType::SpacingType spacing = image->GetSpacing();
-    spacing[0] = spacingX;
-    spacing[1] = spacingY;
-    spacing[2] = spacingZ;
-    spacing[3] = spacingT;
-    image->SetSpacing (spacing);
-    
-    typedef itk::ImageFileWriter<ImageType> OutputWriterType;
-    {
-      OutputWriterType::Pointer writer = OutputWriterType::New();
-      writer->SetFileName ( output );
-      writer->SetInput ( image );
-      
-      std::cout << "Writing: " << output << std::flush;
-      try
-      {
-	writer->Update();
-      }
-      catch (itk::ExceptionObject &e)
+  const double wall = clock->GetTimeStamp() - start;
+  const double cpuTime = static_cast<double>(std::clock() - cpu) / CLOCKS_PER_SEC;
+
+  {
+    std::ofstream done ((base + ".done.tmp").c_str());
+    done << "status " << status << "\n";
+    done << "queued_seconds " << queued << "\n";
+    done << "wall_seconds " << wall << "\n";
+    done << "cpu_seconds " << cpuTime << "\n";
+    done << "peak_memory_mb " << (itk::GetPeakMemoryUsage()>>20) << "\n";
+  }
+  itksys::SystemTools::RenameFile ((base + ".done.tmp").c_str(), (base + ".done").c_str());
+  itksys::SystemTools::RemoveFile (running.c_str());
+
+  std::cout << job << ": status " << status << ", " << wall << " s" << std::endl;
+}
+
+
+/**
+   Serve conversion jobs dropped in spool/<submitter>/<name>.job, the oldest
+   (by name) job of each submitter in turn, so that one submitter
+   cannot starve the others. The process, and with it the loaded IO
+   factories and the scratch buffers of the conversions, stays up until
+   a file named 'stop' appears in spool.
+ */
+int RunSpool (const std::string &spool, double interval, const char *exec)
+{
+  if (!itksys::SystemTools::FileIsDirectory (spool.c_str()))
+  {
+    std::cerr << "Error: " << spool << " is not a directory" << std::endl;
+    return -1;
+  }
+
+  // registers and loads every ImageIO once for all the jobs, which share
+  // the scratch buffers
+  itk::ImageIOFactory::CreateImageIO ("", itk::ImageIOFactory::ReadMode);
+  itk::SliceBufferPool::Pointer pool = itk::SliceBufferPool::New();
+  std::cout << "Serving " << spool << std::endl;
+
+  std::string lastSubmitter;
+  while (!itksys::SystemTools::FileExists ((spool + "/stop").c_str()))
+  {
+    // oldest pending job of every submitter
+    std::map<std::string, std::string> pending;
+    itksys::Directory submitters;
+    submitters.Load (spool.c_str());
+    for (unsigned long i=0; i<submitters.GetNumberOfFiles(); i++)
+    {
+      const std::string submitter = submitters.GetFile (i);
+      const std::string path = spool + "/" + submitter;
+      if (submitter=="." || submitter==".." || !itksys::SystemTools::FileIsDirectory (path.c_str()))
+        continue;
+
+      itksys::Directory jobs;
+      jobs.Load (path.c_str());
+      for (unsigned long j=0; j<jobs.GetNumberOfFiles(); j++)
       {
-	std::cerr << e;
-	return -1;
+        const std::string name = jobs.GetFile (j);
+        if (name.size()>4 && name.substr (name.size()-4)==".job"
+            && (pending[submitter].empty() || path + "/" + name < pending[submitter]))
+          pending[submitter] = path + "/" + name;
       }
-      std::cout << " Done." << std::endl;
+      if (pending[submitter].empty())
+        pending.erase (submitter);
+    }
+
+    if (pending.empty())
+    {
+      itksys::SystemTools::Delay (static_cast<unsigned int>(interval * 1000));
+      continue;
+    }
+
+    // next submitter after the last one served
+    std::map<std::string, std::string>::iterator next = pending.upper_bound (lastSubmitter);
+    if (next==pending.end())
+      next = pending.begin();
+    lastSubmitter = next->first;
+
+    // a job failing outside its conversion, e.g. out of memory while
+    // reading it, does not stop the daemon
+    try
+    {
+      RunSpoolJob (next->second, exec, pool);
+    }
+    catch (std::exception &e)
+    {
+      std::cerr << next->second << ": " << e.what() << std::endl;
+    }
+  }
+
+  return 0;
+}
+
+
+int main (int argc, char* argv[])
+{
+  // .vbz volumes, written and checked
+  itk::BlockCompressedImageIOFactory::RegisterOneFactory();
+
+  GetPot cl (argc, argv);
+  if( cl.size()==1 || cl.search (2,"-h","--help") )
+  {
+    PrintHelp (cl[0]);
+    return -1;
+  }
+
+  if (cl.search ("--check"))
+  {
+    const std::string volume = cl.next ("");
+    unsigned long long maxMemory = 0;
+    if (cl.search ("--max-memory") && !(maxMemory = itk::ParseMemorySize (cl.next (""))))
+    {
+      std::cerr << "Error: invalid --max-memory value" << std::endl;
+      return -1;
     }
+    return CheckVolume (volume, maxMemory);
   }
-  
-  
-  return 0;  
-  
+
+  if (cl.search ("--spool"))
+  {
+    const std::string spool = cl.next ("");
+    return RunSpool (spool, cl.follow (1.0, "--poll"), cl[0]);
+  }
+
+  return ConvertCommandLine (argc, argv);
+
 }
@@ -0,0 +1,752 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkBlockCompressedImageIO.h"
+#include "itkMultiThreader.h"
+#include "itk_zlib.h"
+
+#include <itksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#ifdef ITK_SERIES_TO_VOLUME_USE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef ITK_SERIES_TO_VOLUME_USE_LZ4
+#include <lz4.h>
+#endif
+
+namespace itk
+{
+
+  namespace
+  {
+    const char Magic[8] = { 'I', 'T', 'K', 'V', 'B', 'Z', '1', '\n' };
+    const size_t FixedHeaderSize = 40;
+
+    /** Component types by their code in the header. */
+    const ImageIOBase::IOComponentType ComponentTypes[] = {
+      ImageIOBase::UCHAR, ImageIOBase::CHAR, ImageIOBase::USHORT, ImageIOBase::SHORT,
+      ImageIOBase::UINT, ImageIOBase::INT, ImageIOBase::FLOAT, ImageIOBase::DOUBLE };
+    const unsigned int NumberOfComponentTypes = sizeof(ComponentTypes) / sizeof(ComponentTypes[0]);
+
+    /** Codecs by their code in the header. */
+    const char *CodecNames[] = { "none", "deflate", "zstd", "lz4" };
+
+    bool IsBigEndian (void)
+    {
+      const short one = 1;
+      return !*reinterpret_cast<const char*>(&one);
+    }
+
+    /** Reverse the bytes of each component of size bytes. */
+    void SwapComponents (char *data, size_t size, unsigned int componentSize)
+    {
+      if (componentSize<2)
+        return;
+      for (char *p=data; p+componentSize<=data+size; p+=componentSize)
+        std::reverse (p, p+componentSize);
+    }
+
+    void Put32 (std::vector<char> &header, unsigned long value)
+    {
+      for (unsigned int i=0; i<4; i++)
+        header.push_back (static_cast<char>((value >> (8*i)) & 0xff));
+    }
+
+    void Put64 (std::vector<char> &header, unsigned long long value)
+    {
+      for (unsigned int i=0; i<8; i++)
+        header.push_back (static_cast<char>((value >> (8*i)) & 0xff));
+    }
+
+    void PutDouble (std::vector<char> &header, double value)
+    {
+      unsigned long long bits;
+      memcpy (&bits, &value, sizeof(bits));
+      Put64 (header, bits);
+    }
+
+    unsigned long Get32 (const char *p)
+    {
+      unsigned long value = 0;
+      for (unsigned int i=0; i<4; i++)
+        value |= static_cast<unsigned long>(static_cast<unsigned char>(p[i])) << (8*i);
+      return value;
+    }
+
+    unsigned long long Get64 (const char *p)
+    {
+      unsigned long long value = 0;
+      for (unsigned int i=0; i<8; i++)
+        value |= static_cast<unsigned long long>(static_cast<unsigned char>(p[i])) << (8*i);
+      return value;
+    }
+
+    double GetDouble (const char *p)
+    {
+      const unsigned long long bits = Get64 (p);
+      double value;
+      memcpy (&value, &bits, sizeof(value));
+      return value;
+    }
+
+
+    size_t GetCompressBound (BlockCompressedImageIO::CodecType codec, size_t size)
+    {
+      switch (codec)
+      {
+        case BlockCompressedImageIO::Deflate:
+          return compressBound (static_cast<uLong>(size));
+#ifdef ITK_SERIES_TO_VOLUME_USE_ZSTD
+        case BlockCompressedImageIO::Zstd:
+          return ZSTD_compressBound (size);
+#endif
+#ifdef ITK_SERIES_TO_VOLUME_USE_LZ4
+        case BlockCompressedImageIO::Lz4:
+          return LZ4_compressBound (static_cast<int>(size));
+#endif
+        default:
+          return size;
+      }
+    }
+
+    /** Compress size bytes, returns the compressed size, size or more
+        if the block does not compress. */
+    size_t CompressBlock (BlockCompressedImageIO::CodecType codec, int level,
+                          const char *in, size_t size, char *out, size_t capacity)
+    {
+      switch (codec)
+      {
+        case BlockCompressedImageIO::Deflate:
+        {
+          uLongf length = static_cast<uLongf>(capacity);
+          if (compress2 (reinterpret_cast<Bytef*>(out), &length, reinterpret_cast<const Bytef*>(in),
+                         static_cast<uLong>(size), level ? level : Z_DEFAULT_COMPRESSION)!=Z_OK)
+          {
+            itkGenericExceptionMacro (<< "deflate compression failed");
+          }
+          return length;
+        }
+#ifdef ITK_SERIES_TO_VOLUME_USE_ZSTD
+        case BlockCompressedImageIO::Zstd:
+        {
+          const size_t length = ZSTD_compress (out, capacity, in, size, level);
+          if (ZSTD_isError (length))
+          {
+            itkGenericExceptionMacro (<< "zstd compression failed: " << ZSTD_getErrorName (length));
+          }
+          return length;
+        }
+#endif
+#ifdef ITK_SERIES_TO_VOLUME_USE_LZ4
+        case BlockCompressedImageIO::Lz4:
+        {
+          const int length = LZ4_compress_default (in, out, static_cast<int>(size), static_cast<int>(capacity));
+          if (length<=0)
+          {
+            itkGenericExceptionMacro (<< "LZ4 compression failed");
+          }
+          return length;
+        }
+#endif
+        default:
+          return size;
+      }
+    }
+
+    /** Decompress a block of size bytes, stored as is if not smaller. */
+    void DecompressBlock (BlockCompressedImageIO::CodecType codec, const char *in, size_t storedSize,
+                          char *out, size_t size)
+    {
+      if (storedSize>=size)
+      {
+        memcpy (out, in, size);
+        return;
+      }
+
+      size_t length = 0;
+      switch (codec)
+      {
+        case BlockCompressedImageIO::Deflate:
+        {
+          uLongf inflated = static_cast<uLongf>(size);
+          if (uncompress (reinterpret_cast<Bytef*>(out), &inflated, reinterpret_cast<const Bytef*>(in),
+                          static_cast<uLong>(storedSize))==Z_OK)
+            length = inflated;
+          break;
+        }
+#ifdef ITK_SERIES_TO_VOLUME_USE_ZSTD
+        case BlockCompressedImageIO::Zstd:
+          length = ZSTD_decompress (out, size, in, storedSize);
+          if (ZSTD_isError (length))
+            length = 0;
+          break;
+#endif
+#ifdef ITK_SERIES_TO_VOLUME_USE_LZ4
+        case BlockCompressedImageIO::Lz4:
+        {
+          const int decoded = LZ4_decompress_safe (in, out, static_cast<int>(storedSize), static_cast<int>(size));
+          length = decoded>0 ? decoded : 0;
+          break;
+        }
+#endif
+        default:
+          break;
+      }
+      if (length!=size)
+      {
+        itkGenericExceptionMacro (<< "corrupt compressed block");
+      }
+    }
+
+
+    /** Blocks compressed or decompressed by the threads, each taking
+        every NumberOfThreads-th block. */
+    struct BlockJobs
+    {
+      BlockCompressedImageIO::CodecType Codec;
+      int                        Level;
+      bool                       Compress;
+      unsigned int               ComponentSize;
+      bool                       Swap;
+      std::vector<const char*>   Inputs;
+      std::vector<size_t>        InputSizes;
+      std::vector<char*>         Outputs;
+      std::vector<size_t>        OutputSizes;
+      std::vector<std::string>   Errors;
+    };
+
+    ITK_THREAD_RETURN_TYPE RunBlockJobs (void *arg)
+    {
+      MultiThreader::ThreadInfoStruct *info = static_cast<MultiThreader::ThreadInfoStruct*>(arg);
+      BlockJobs *jobs = static_cast<BlockJobs*>(info->UserData);
+
+      std::vector<char> swapped;
+      for (unsigned int j=info->ThreadID; j<jobs->Inputs.size(); j+=info->NumberOfThreads)
+      {
+        try
+        {
+          if (jobs->Compress)
+          {
+            const char *in = jobs->Inputs[j];
+            if (jobs->Swap)
+            {
+              swapped.assign (in, in + jobs->InputSizes[j]);
+              SwapComponents (&swapped[0], swapped.size(), jobs->ComponentSize);
+              in = &swapped[0];
+            }
+            jobs->OutputSizes[j] = CompressBlock (jobs->Codec, jobs->Level, in, jobs->InputSizes[j],
+                                                  jobs->Outputs[j], jobs->OutputSizes[j]);
+          }
+          else
+          {
+            DecompressBlock (jobs->Codec, jobs->Inputs[j], jobs->InputSizes[j], jobs->Outputs[j], jobs->OutputSizes[j]);
+            if (jobs->Swap)
+              SwapComponents (jobs->Outputs[j], jobs->OutputSizes[j], jobs->ComponentSize);
+          }
+        }
+        catch (ExceptionObject &e)
+        {
+          jobs->Errors[j] = e.GetDescription();
+        }
+      }
+
+      return ITK_THREAD_RETURN_VALUE;
+    }
+
+    void RunBlockJobs (BlockJobs &jobs)
+    {
+      jobs.Errors.assign (jobs.Inputs.size(), std::string());
+      MultiThreader::Pointer threader = MultiThreader::New();
+      threader->SetNumberOfThreads (std::min<int> (MultiThreader::GetGlobalDefaultNumberOfThreads(), jobs.Inputs.size()));
+      threader->SetSingleMethod (RunBlockJobs, &jobs);
+      threader->SingleMethodExecute();
+
+      for (unsigned int j=0; j<jobs.Errors.size(); j++)
+        if (!jobs.Errors[j].empty())
+        {
+          itkGenericExceptionMacro (<< jobs.Errors[j]);
+        }
+    }
+  }
+
+
+  BlockCompressedImageIO::BlockCompressedImageIO()
+  {
+    m_Codec = IsCodecAvailable (Zstd) ? Zstd : IsCodecAvailable (Lz4) ? Lz4 : Deflate;
+    m_CompressionLevel = 0;
+    m_BlockSize = 4 << 20;
+
+    m_FileCodec = Uncompressed;
+    m_SlicesPerBlock = 1;
+    m_NextSlice = 0;
+    m_NextBlock = 0;
+  }
+
+
+  bool BlockCompressedImageIO::ParseCodec (const std::string &name, CodecType &codec)
+  {
+    for (unsigned int i=0; i<sizeof(CodecNames)/sizeof(CodecNames[0]); i++)
+    {
+      if (name==CodecNames[i])
+      {
+        codec = static_cast<CodecType>(i);
+        return IsCodecAvailable (codec);
+      }
+    }
+    return false;
+  }
+
+
+  bool BlockCompressedImageIO::IsCodecAvailable (CodecType codec)
+  {
+    switch (codec)
+    {
+      case Uncompressed:
+      case Deflate:
+        return true;
+#ifdef ITK_SERIES_TO_VOLUME_USE_ZSTD
+      case Zstd:
+        return true;
+#endif
+#ifdef ITK_SERIES_TO_VOLUME_USE_LZ4
+      case Lz4:
+        return true;
+#endif
+      default:
+        return false;
+    }
+  }
+
+
+  size_t BlockCompressedImageIO::GetSliceBytes (void) const
+  {
+    size_t bytes = this->GetComponentSize() * this->GetNumberOfComponents();
+    for (unsigned int i=0; i+1<m_NumberOfDimensions; i++)
+      bytes *= m_Dimensions[i];
+    return bytes;
+  }
+
+
+  unsigned long BlockCompressedImageIO::GetNumberOfSlices (void) const
+  {
+    return m_Dimensions[m_NumberOfDimensions-1];
+  }
+
+
+  size_t BlockCompressedImageIO::GetHeaderSize (unsigned long long numberOfBlocks) const
+  {
+    return FixedHeaderSize + m_NumberOfDimensions * 3 * 8 + m_NumberOfDimensions * m_NumberOfDimensions * 8
+      + numberOfBlocks * 16;
+  }
+
+
+  bool BlockCompressedImageIO::CanReadFile (const char *filename)
+  {
+    std::ifstream in (filename, std::ios::binary);
+    char magic[sizeof(Magic)];
+    return in.read (magic, sizeof(magic)) && memcmp (magic, Magic, sizeof(Magic))==0;
+  }
+
+
+  void BlockCompressedImageIO::ReadImageInformation (void)
+  {
+    std::ifstream in (m_FileName.c_str(), std::ios::binary);
+    std::vector<char> header (FixedHeaderSize);
+    if (!in.read (&header[0], FixedHeaderSize) || memcmp (&header[0], Magic, sizeof(Magic)))
+    {
+      itkExceptionMacro (<< m_FileName << " is not a block compressed volume");
+    }
+
+    const unsigned long headerSize       = Get32 (&header[8]);
+    const unsigned long dimension        = Get32 (&header[12]);
+    const unsigned long componentType    = Get32 (&header[16]);
+    const unsigned long components       = Get32 (&header[20]);
+    const unsigned long codec            = Get32 (&header[24]);
+    const unsigned long long blocks      = Get64 (&header[32]);
+    m_SlicesPerBlock                     = Get32 (&header[28]);
+    if (dimension<1 || dimension>8 || componentType>=NumberOfComponentTypes || !components
+        || !m_SlicesPerBlock || codec>Lz4)
+    {
+      itkExceptionMacro (<< "invalid header in " << m_FileName);
+    }
+    m_FileCodec = static_cast<CodecType>(codec);
+    if (!IsCodecAvailable (m_FileCodec))
+    {
+      itkExceptionMacro (<< m_FileName << " needs the " << CodecNames[m_FileCodec] << " codec, which is not built in");
+    }
+
+    this->SetNumberOfDimensions (dimension);
+    this->SetComponentType (ComponentTypes[componentType]);
+    this->SetNumberOfComponents (components);
+    this->SetPixelType (components==1 ? SCALAR : VECTOR);
+    if (headerSize!=this->GetHeaderSize (blocks))
+    {
+      itkExceptionMacro (<< "invalid header in " << m_FileName);
+    }
+
+    header.resize (headerSize);
+    if (!in.read (&header[FixedHeaderSize], headerSize - FixedHeaderSize))
+    {
+      itkExceptionMacro (<< "truncated header in " << m_FileName);
+    }
+
+    const char *p = &header[FixedHeaderSize];
+    for (unsigned int i=0; i<dimension; i++, p+=24)
+    {
+      this->SetDimensions (i, static_cast<unsigned int>(Get64 (p)));
+      this->SetSpacing (i, GetDouble (p + 8));
+      this->SetOrigin (i, GetDouble (p + 16));
+    }
+    for (unsigned int i=0; i<dimension; i++)
+    {
+      std::vector<double> direction (dimension);
+      for (unsigned int j=0; j<dimension; j++, p+=8)
+        direction[j] = GetDouble (p);
+      this->SetDirection (i, direction);
+    }
+
+    if (blocks!=(this->GetNumberOfSlices() + m_SlicesPerBlock - 1) / m_SlicesPerBlock)
+    {
+      itkExceptionMacro (<< "invalid block index in " << m_FileName);
+    }
+
+    // blocks follow the index and each other, within the file: Read
+    // relies on it to read them in batches
+    in.seekg (0, std::ios::end);
+    const unsigned long long fileSize = static_cast<unsigned long long>(in.tellg());
+    unsigned long long previousEnd = headerSize;
+    m_Blocks.resize (blocks);
+    for (unsigned long long b=0; b<blocks; b++, p+=16)
+    {
+      m_Blocks[b].Offset         = Get64 (p);
+      m_Blocks[b].CompressedSize = Get64 (p + 8);
+      if (m_Blocks[b].Offset<previousEnd || m_Blocks[b].Offset>fileSize
+          || m_Blocks[b].CompressedSize>fileSize - m_Blocks[b].Offset)
+      {
+        itkExceptionMacro (<< "block " << b << " of " << m_FileName << " lies outside the data: the file is truncated or corrupt");
+      }
+      previousEnd = m_Blocks[b].Offset + m_Blocks[b].CompressedSize;
+    }
+  }
+
+
+  ImageIORegion
+  BlockCompressedImageIO::GenerateStreamableReadRegionFromRequestedRegion (const ImageIORegion &requested) const
+  {
+    ImageIORegion region = requested;
+    for (unsigned int i=0; i+1<m_NumberOfDimensions && i<region.GetImageDimension(); i++)
+    {
+      region.SetIndex (i, 0);
+      region.SetSize (i, m_Dimensions[i]);
+    }
+    return region;
+  }
+
+
+  void BlockCompressedImageIO::Read (void *buffer)
+  {
+    // slices of the region, which spans whole slices
+    const ImageIORegion &region = this->GetIORegion();
+    const unsigned int last = m_NumberOfDimensions-1;
+    unsigned long first = 0, count = this->GetNumberOfSlices();
+    if (region.GetImageDimension()==m_NumberOfDimensions)
+    {
+      for (unsigned int i=0; i<last; i++)
+        if (region.GetIndex (i)!=0 || region.GetSize (i)!=m_Dimensions[i])
+        {
+          itkExceptionMacro (<< "block compressed volumes are read by whole slices");
+        }
+      first = region.GetIndex (last);
+      count = region.GetSize (last);
+    }
+    if (!count)
+      return;
+
+    const size_t sliceBytes = this->GetSliceBytes();
+    std::ifstream in (m_FileName.c_str(), std::ios::binary);
+    char *out = static_cast<char*>(buffer);
+
+    // each batch of blocks is read at once, then decompressed in parallel;
+    // the blocks partly outside the region go through scratch buffers
+    const unsigned long firstBlock = first / m_SlicesPerBlock;
+    const unsigned long lastBlock  = (first + count - 1) / m_SlicesPerBlock;
+    const unsigned long batch = MultiThreader::GetGlobalDefaultNumberOfThreads();
+    std::vector<char> stored;
+    std::vector<std::vector<char> > scratch (2);
+    for (unsigned long b0=firstBlock; b0<=lastBlock; b0+=batch)
+    {
+      const unsigned long b1 = std::min (b0 + batch - 1, lastBlock);
+      const unsigned long long begin = m_Blocks[b0].Offset;
+      const unsigned long long end   = m_Blocks[b1].Offset + m_Blocks[b1].CompressedSize;
+      stored.resize (end - begin + 1);
+      in.seekg (begin);
+      if (!in.read (&stored[0], end - begin))
+      {
+        itkExceptionMacro (<< "truncated data in " << m_FileName);
+      }
+
+      BlockJobs jobs;
+      jobs.Codec         = m_FileCodec;
+      jobs.Compress      = false;
+      jobs.ComponentSize = this->GetComponentSize();
+      jobs.Swap          = IsBigEndian();
+      for (unsigned long b=b0; b<=b1; b++)
+      {
+        const unsigned long blockFirst  = b * m_SlicesPerBlock;
+        const unsigned long blockSlices = std::min (m_SlicesPerBlock, this->GetNumberOfSlices() - blockFirst);
+        const size_t blockBytes = blockSlices * sliceBytes;
+        char *target;
+        if (blockFirst>=first && blockFirst + blockSlices<=first + count)
+          target = out + (blockFirst - first) * sliceBytes;
+        else
+        {
+          std::vector<char> &partial = scratch[b==firstBlock ? 0 : 1];
+          partial.resize (blockBytes);
+          target = &partial[0];
+        }
+        jobs.Inputs.push_back (&stored[m_Blocks[b].Offset - begin]);
+        jobs.InputSizes.push_back (m_Blocks[b].CompressedSize);
+        jobs.Outputs.push_back (target);
+        jobs.OutputSizes.push_back (blockBytes);
+      }
+      RunBlockJobs (jobs);
+
+      // the slices of the region in the partial blocks at both ends
+      for (unsigned long b=b0; b<=b1; b++)
+      {
+        const unsigned long blockFirst  = b * m_SlicesPerBlock;
+        const unsigned long blockSlices = std::min (m_SlicesPerBlock, this->GetNumberOfSlices() - blockFirst);
+        if (blockFirst>=first && blockFirst + blockSlices<=first + count)
+          continue;
+        const unsigned long from = std::max (first, blockFirst);
+        const unsigned long to   = std::min (first + count, blockFirst + blockSlices);
+        memcpy (out + (from - first) * sliceBytes, &scratch[b==firstBlock ? 0 : 1][(from - blockFirst) * sliceBytes],
+                (to - from) * sliceBytes);
+      }
+    }
+  }
+
+
+  bool BlockCompressedImageIO::CanWriteFile (const char *filename)
+  {
+    return itksys::SystemTools::LowerCase (itksys::SystemTools::GetFilenameLastExtension (filename))==".vbz";
+  }
+
+
+  void BlockCompressedImageIO::WriteHeader (std::ostream &out) const
+  {
+    unsigned int componentType = 0;
+    while (componentType<NumberOfComponentTypes && ComponentTypes[componentType]!=this->GetComponentType())
+      componentType++;
+    if (componentType==NumberOfComponentTypes)
+    {
+      itkExceptionMacro (<< "unsupported component type for " << m_FileName);
+    }
+
+    std::vector<char> header (Magic, Magic + sizeof(Magic));
+    Put32 (header, this->GetHeaderSize (m_Blocks.size()));
+    Put32 (header, m_NumberOfDimensions);
+    Put32 (header, componentType);
+    Put32 (header, this->GetNumberOfComponents());
+    Put32 (header, m_FileCodec);
+    Put32 (header, m_SlicesPerBlock);
+    Put64 (header, m_Blocks.size());
+    for (unsigned int i=0; i<m_NumberOfDimensions; i++)
+    {
+      Put64 (header, m_Dimensions[i]);
+      PutDouble (header, m_Spacing[i]);
+      PutDouble (header, m_Origin[i]);
+    }
+    for (unsigned int i=0; i<m_NumberOfDimensions; i++)
+      for (unsigned int j=0; j<m_NumberOfDimensions; j++)
+        PutDouble (header, m_Direction[i][j]);
+    for (unsigned int b=0; b<m_Blocks.size(); b++)
+    {
+      Put64 (header, m_Blocks[b].Offset);
+      Put64 (header, m_Blocks[b].CompressedSize);
+    }
+    out.write (&header[0], header.size());
+  }
+
+
+  void BlockCompressedImageIO::CompressBlocks (std::ostream &out, const std::vector<const char*> &blocks,
+                                               const std::vector<size_t> &sizes)
+  {
+    // batches of one block per thread bound the compressed data held at once
+    const unsigned int batch = MultiThreader::GetGlobalDefaultNumberOfThreads();
+    std::vector<std::vector<char> > compressed (std::min<size_t> (batch, blocks.size()));
+    for (unsigned int b0=0; b0<blocks.size(); b0+=batch)
+    {
+      BlockJobs jobs;
+      jobs.Codec         = m_FileCodec;
+      jobs.Level         = m_CompressionLevel;
+      jobs.Compress      = true;
+      jobs.ComponentSize = this->GetComponentSize();
+      jobs.Swap          = IsBigEndian();
+      for (unsigned int b=b0; b<blocks.size() && b<b0+batch; b++)
+      {
+        std::vector<char> &target = compressed[b-b0];
+        target.resize (GetCompressBound (m_FileCodec, sizes[b]) + 1);
+        jobs.Inputs.push_back (blocks[b]);
+        jobs.InputSizes.push_back (sizes[b]);
+        jobs.Outputs.push_back (&target[0]);
+        jobs.OutputSizes.push_back (target.size() - 1);
+      }
+      RunBlockJobs (jobs);
+
+      for (unsigned int j=0; j<jobs.Inputs.size(); j++)
+      {
+        Block &block = m_Blocks[m_NextBlock++];
+        block.Offset = out.tellp();
+        if (m_FileCodec==Uncompressed || jobs.OutputSizes[j]>=sizes[b0+j])
+        {
+          // stored as is, swapped if need be
+          std::vector<char> swapped;
+          const char *data = blocks[b0+j];
+          if (IsBigEndian())
+          {
+            swapped.assign (data, data + sizes[b0+j]);
+            SwapComponents (&swapped[0], swapped.size(), this->GetComponentSize());
+            data = &swapped[0];
+          }
+          out.write (data, sizes[b0+j]);
+          block.CompressedSize = sizes[b0+j];
+        }
+        else
+        {
+          out.write (jobs.Outputs[j], jobs.OutputSizes[j]);
+          block.CompressedSize = jobs.OutputSizes[j];
+        }
+      }
+    }
+  }
+
+
+  void BlockCompressedImageIO::Write (const void *buffer)
+  {
+    // slices of the region, which spans whole slices
+    const ImageIORegion &region = this->GetIORegion();
+    const unsigned int last = m_NumberOfDimensions-1;
+    unsigned long first = 0, count = this->GetNumberOfSlices();
+    if (region.GetImageDimension()==m_NumberOfDimensions)
+    {
+      for (unsigned int i=0; i<last; i++)
+        if (region.GetIndex (i)!=0 || region.GetSize (i)!=m_Dimensions[i])
+        {
+          itkExceptionMacro (<< "block compressed volumes are written by whole slices");
+        }
+      first = region.GetIndex (last);
+      count = region.GetSize (last);
+    }
+
+    const size_t sliceBytes = this->GetSliceBytes();
+    const unsigned long numberOfSlices = this->GetNumberOfSlices();
+    if (first==0)
+    {
+      // first slab: the header is written with an empty index
+      m_FileCodec = m_Codec;
+      if (!IsCodecAvailable (m_FileCodec))
+      {
+        itkExceptionMacro (<< "the " << CodecNames[m_FileCodec] << " codec is not built in");
+      }
+      m_SlicesPerBlock = std::max<unsigned long> (1, std::min<size_t> (m_BlockSize / sliceBytes, numberOfSlices));
+      Block empty = { 0, 0 };
+      m_Blocks.assign ((numberOfSlices + m_SlicesPerBlock - 1) / m_SlicesPerBlock, empty);
+      m_NextSlice = 0;
+      m_NextBlock = 0;
+      m_Pending.clear();
+
+      std::ofstream header (m_FileName.c_str(), std::ios::binary | std::ios::trunc);
+      this->WriteHeader (header);
+      if (!header)
+      {
+        itkExceptionMacro (<< "cannot write " << m_FileName);
+      }
+    }
+    if (first!=m_NextSlice || first + count > numberOfSlices)
+    {
+      itkExceptionMacro (<< "the slabs of " << m_FileName << " must be written in order");
+    }
+
+    std::fstream out (m_FileName.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+    out.seekp (0, std::ios::end);
+
+    // whole blocks: the pending slices completed first, then straight
+    // from the slab; the last block of the volume may be shorter
+    const size_t blockBytes = m_SlicesPerBlock * sliceBytes;
+    const bool   lastSlab   = first + count==numberOfSlices;
+    const char  *data       = static_cast<const char*>(buffer);
+    size_t       remaining  = count * sliceBytes;
+    std::vector<const char*> blocks;
+    std::vector<size_t>      sizes;
+    bool                     pendingBlock = false;
+
+    if (!m_Pending.empty())
+    {
+      const size_t taken = std::min (blockBytes - m_Pending.size(), remaining);
+      m_Pending.insert (m_Pending.end(), data, data + taken);
+      data += taken;
+      remaining -= taken;
+      pendingBlock = m_Pending.size()==blockBytes || (lastSlab && !remaining);
+      if (pendingBlock)
+      {
+        blocks.push_back (&m_Pending[0]);
+        sizes.push_back (m_Pending.size());
+      }
+    }
+    while (remaining>=blockBytes || (lastSlab && remaining))
+    {
+      const size_t size = std::min (remaining, blockBytes);
+      blocks.push_back (data);
+      sizes.push_back (size);
+      data += size;
+      remaining -= size;
+    }
+    this->CompressBlocks (out, blocks, sizes);
+
+    if (pendingBlock)
+      m_Pending.clear();
+    m_Pending.insert (m_Pending.end(), data, data + remaining);
+    m_NextSlice += count;
+
+    if (lastSlab)
+    {
+      out.seekp (0);
+      this->WriteHeader (out);
+      m_Pending.clear();
+    }
+    if (!out)
+    {
+      itkExceptionMacro (<< "cannot write " << m_FileName);
+    }
+  }
+
+
+  void BlockCompressedImageIO::PrintSelf (std::ostream &os, Indent indent) const
+  {
+    Superclass::PrintSelf (os, indent);
+    os << indent << "Codec: " << CodecNames[m_Codec] << std::endl;
+    os << indent << "CompressionLevel: " << m_CompressionLevel << std::endl;
+    os << indent << "BlockSize: " << m_BlockSize << std::endl;
+    os << indent << "SlicesPerBlock: " << m_SlicesPerBlock << std::endl;
+    os << indent << "NumberOfBlocks: " << m_Blocks.size() << std::endl;
+  }
+
+} // end of namespace
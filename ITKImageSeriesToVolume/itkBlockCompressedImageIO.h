@@ -0,0 +1,142 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_BlockCompressedImageIO_h_
+#define _itk_BlockCompressedImageIO_h_
+
+#include "itkImageIOBase.h"
+
+#include <vector>
+
+/**
+   Block compressed volumes (.vbz): the image is cut along its last
+   dimension into blocks of whole slices, compressed independently with
+   zstd, LZ4 or deflate, and a header indexes the blocks. Any range of
+   slices is read by decompressing only its blocks, and the blocks are
+   compressed and decompressed by several threads.
+
+   Layout, little endian:
+     "ITKVBZ1\n", header size (uint32), dimension, component type,
+     number of components, codec, slices per block (uint32), number of
+     blocks (uint64), then for each dimension its size (uint64),
+     spacing and origin (double), the direction of each dimension
+     (double), and for each block its file offset and compressed size
+     (uint64). A block whose compressed size equals its size is stored
+     as is. The blocks follow the header, in order.
+
+   The volume may be written in slabs (streamed writing) provided they
+   come in order: a partial block is kept until the next slab completes
+   it, and the index is written with the last slab.
+ */
+
+namespace itk
+{
+
+  class BlockCompressedImageIO : public ImageIOBase
+  {
+  public:
+    typedef BlockCompressedImageIO   Self;
+    typedef ImageIOBase              Superclass;
+    typedef SmartPointer<Self>       Pointer;
+
+    itkNewMacro (Self);
+    itkTypeMacro (BlockCompressedImageIO, ImageIOBase);
+
+    typedef enum
+    {
+      Uncompressed,
+      Deflate,
+      Zstd,
+      Lz4
+    } CodecType;
+
+    /** Codec of the blocks written, whatever UseCompression; defaults to
+        the fastest to decompress among those built in: zstd, LZ4, then
+        deflate. */
+    itkSetMacro (Codec, CodecType);
+    itkGetConstMacro (Codec, CodecType);
+
+    /** Codec level, 0 for the codec default. */
+    itkSetMacro (CompressionLevel, int);
+    itkGetConstMacro (CompressionLevel, int);
+
+    /** Uncompressed size aimed at for a block, rounded to whole slices. */
+    itkSetMacro (BlockSize, unsigned long);
+    itkGetConstMacro (BlockSize, unsigned long);
+
+    /** Codec of a name (zstd, lz4, deflate or none); false if unknown or
+        not built in. */
+    static bool ParseCodec (const std::string &name, CodecType &codec);
+    static bool IsCodecAvailable (CodecType codec);
+
+    virtual bool CanReadFile (const char *filename);
+    virtual bool CanStreamRead (void)
+    { return true; }
+    virtual void ReadImageInformation (void);
+    virtual void Read (void *buffer);
+
+    /** Whole slices of the requested region. */
+    virtual ImageIORegion GenerateStreamableReadRegionFromRequestedRegion (const ImageIORegion &requested) const;
+
+    virtual bool CanWriteFile (const char *filename);
+    virtual bool CanStreamWrite (void)
+    { return true; }
+    virtual void WriteImageInformation (void) {}
+    virtual void Write (const void *buffer);
+
+  protected:
+    BlockCompressedImageIO();
+    ~BlockCompressedImageIO() {}
+
+    void PrintSelf (std::ostream &os, Indent indent) const;
+
+  private:
+    BlockCompressedImageIO (const Self&);
+    void operator=(const Self&);
+
+    struct Block
+    {
+      unsigned long long Offset;
+      unsigned long long CompressedSize;
+    };
+
+    size_t GetSliceBytes (void) const;
+    unsigned long GetNumberOfSlices (void) const;
+    size_t GetHeaderSize (unsigned long long numberOfBlocks) const;
+    void WriteHeader (std::ostream &out) const;
+    void CompressBlocks (std::ostream &out, const std::vector<const char*> &blocks, const std::vector<size_t> &sizes);
+
+    CodecType                m_Codec;
+    int                      m_CompressionLevel;
+    unsigned long            m_BlockSize;
+
+    /** Layout of the file read or being written. */
+    CodecType                m_FileCodec;
+    unsigned long            m_SlicesPerBlock;
+    std::vector<Block>       m_Blocks;
+
+    /** Streamed writing state: next slice expected, and the slices of
+        the incomplete block. */
+    unsigned long            m_NextSlice;
+    unsigned long            m_NextBlock;
+    std::vector<char>        m_Pending;
+
+  };
+
+} // end of namespace
+
+
+#endif
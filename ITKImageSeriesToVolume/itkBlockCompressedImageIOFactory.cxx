@@ -0,0 +1,48 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkBlockCompressedImageIOFactory.h"
+#include "itkBlockCompressedImageIO.h"
+#include "itkCreateObjectFunction.h"
+#include "itkVersion.h"
+
+namespace itk
+{
+
+  BlockCompressedImageIOFactory::BlockCompressedImageIOFactory()
+  {
+    this->RegisterOverride ("itkImageIOBase",
+                            "itkBlockCompressedImageIO",
+                            "Block Compressed Image IO",
+                            1,
+                            CreateObjectFunction<BlockCompressedImageIO>::New());
+  }
+
+
+  const char*
+  BlockCompressedImageIOFactory::GetITKSourceVersion (void) const
+  {
+    return ITK_SOURCE_VERSION;
+  }
+
+
+  const char*
+  BlockCompressedImageIOFactory::GetDescription (void) const
+  {
+    return "Block compressed volume (.vbz) ImageIO";
+  }
+
+} // end of namespace
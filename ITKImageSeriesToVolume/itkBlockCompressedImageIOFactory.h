@@ -0,0 +1,63 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_BlockCompressedImageIOFactory_h_
+#define _itk_BlockCompressedImageIOFactory_h_
+
+#include "itkObjectFactoryBase.h"
+
+namespace itk
+{
+
+  /**
+     Create a BlockCompressedImageIO for the .vbz files, once registered.
+   */
+  class BlockCompressedImageIOFactory : public ObjectFactoryBase
+  {
+  public:
+    typedef BlockCompressedImageIOFactory Self;
+    typedef ObjectFactoryBase             Superclass;
+    typedef SmartPointer<Self>            Pointer;
+    typedef SmartPointer<const Self>      ConstPointer;
+
+    virtual const char* GetITKSourceVersion (void) const;
+    virtual const char* GetDescription (void) const;
+
+    itkFactorylessNewMacro (Self);
+    static BlockCompressedImageIOFactory* FactoryNew() { return new BlockCompressedImageIOFactory; }
+
+    itkTypeMacro (BlockCompressedImageIOFactory, ObjectFactoryBase);
+
+    static void RegisterOneFactory (void)
+    {
+      BlockCompressedImageIOFactory::Pointer factory = BlockCompressedImageIOFactory::New();
+      ObjectFactoryBase::RegisterFactory (factory);
+    }
+
+  protected:
+    BlockCompressedImageIOFactory();
+    ~BlockCompressedImageIOFactory() {}
+
+  private:
+    BlockCompressedImageIOFactory (const Self&);
+    void operator=(const Self&);
+
+  };
+
+} // end of namespace
+
+
+#endif
@@ -0,0 +1,410 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkCompressedSliceIO.h"
+#include "itkMacro.h"
+#include "itk_zlib.h"
+
+#include <itksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <vector>
+
+#ifdef ITK_SERIES_TO_VOLUME_USE_ZSTD
+#include <cstdio>
+#include <zstd.h>
+#endif
+
+namespace itk
+{
+
+  namespace
+  {
+    /** File name without its compression extension, lower case. */
+    std::string GetUncompressedName (const std::string &filename)
+    {
+      std::string name = itksys::SystemTools::LowerCase (filename);
+      const std::string extension = itksys::SystemTools::GetFilenameLastExtension (name);
+      if (extension==".gz" || extension==".zst")
+        name = name.substr (0, name.size() - extension.size());
+      return name;
+    }
+
+    bool IsZstdFile (const std::string &filename)
+    {
+      return itksys::SystemTools::LowerCase (
+        itksys::SystemTools::GetFilenameLastExtension (filename))==".zst";
+    }
+
+
+    /**
+       Sequential reader of a file or of a file loaded in memory,
+       decompressed on the fly. Plain and gzip files go through zlib,
+       which passes uncompressed data as is.
+     */
+    class SliceStream
+    {
+    public:
+      explicit SliceStream (const std::string &filename)
+        : m_FileName (filename), m_File (0), m_Memory (0), m_MemorySize (0), m_MemoryPosition (0), m_Inflating (false)
+#ifdef ITK_SERIES_TO_VOLUME_USE_ZSTD
+        , m_Zstd (0), m_ZstdStream (0), m_InputPosition (0), m_InputSize (0)
+#endif
+      {
+        if (IsZstdFile (filename))
+        {
+          this->OpenZstd (true);
+          return;
+        }
+        m_File = gzopen (filename.c_str(), "rb");
+        if (!m_File)
+          this->Fail ("cannot open");
+#if ZLIB_VERNUM >= 0x1240
+        gzbuffer (m_File, 128 * 1024);
+#endif
+      }
+
+      /** Stream over the size bytes of a file named name held in memory. */
+      SliceStream (const std::string &name, const void *data, size_t size)
+        : m_FileName (name), m_File (0), m_Memory (static_cast<const char*>(data)),
+          m_MemorySize (size), m_MemoryPosition (0), m_Inflating (false)
+#ifdef ITK_SERIES_TO_VOLUME_USE_ZSTD
+        , m_Zstd (0), m_ZstdStream (0), m_InputPosition (0), m_InputSize (0)
+#endif
+      {
+        if (IsZstdFile (name))
+        {
+          this->OpenZstd (false);
+          return;
+        }
+        if (itksys::SystemTools::LowerCase (itksys::SystemTools::GetFilenameLastExtension (name))==".gz")
+        {
+          memset (&m_Inflate, 0, sizeof(m_Inflate));
+          m_Inflate.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(m_Memory));
+          m_Inflate.avail_in = static_cast<uInt>(m_MemorySize);
+          // 32: detect the gzip or zlib header
+          if (inflateInit2 (&m_Inflate, 15 + 32)!=Z_OK)
+            this->Fail ("cannot decompress");
+          m_Inflating = true;
+        }
+      }
+
+      ~SliceStream()
+      {
+        this->Close();
+      }
+
+      /** Read up to size bytes, returns the number read. */
+      size_t Read (void *data, size_t size)
+      {
+        size_t done = 0;
+        char *p = static_cast<char*>(data);
+#ifdef ITK_SERIES_TO_VOLUME_USE_ZSTD
+        if (m_ZstdStream)
+        {
+          ZSTD_outBuffer output = { data, size, 0 };
+          while (output.pos < output.size)
+          {
+            if (m_InputPosition==m_InputSize)
+            {
+              if (!m_Zstd)
+                break;
+              m_InputSize = fread (&m_Input[0], 1, m_Input.size(), m_Zstd);
+              m_InputPosition = 0;
+              if (!m_InputSize)
+                break;
+            }
+            ZSTD_inBuffer input = { m_Zstd ? &m_Input[0] : m_Memory, m_InputSize, m_InputPosition };
+            if (ZSTD_isError (ZSTD_decompressStream (m_ZstdStream, &output, &input)))
+              this->Fail ("corrupt zstd data in");
+            m_InputPosition = input.pos;
+          }
+          return output.pos;
+        }
+#endif
+        if (m_Inflating)
+        {
+          m_Inflate.next_out  = reinterpret_cast<Bytef*>(p);
+          m_Inflate.avail_out = static_cast<uInt>(size);
+          while (m_Inflate.avail_out)
+          {
+            const int status = inflate (&m_Inflate, Z_NO_FLUSH);
+            if (status==Z_STREAM_END)
+              break;
+            if (status!=Z_OK)
+              this->Fail ("corrupt gzip data in");
+          }
+          return size - m_Inflate.avail_out;
+        }
+        if (m_Memory)
+        {
+          done = std::min (size, m_MemorySize - m_MemoryPosition);
+          memcpy (p, m_Memory + m_MemoryPosition, done);
+          m_MemoryPosition += done;
+          return done;
+        }
+
+        // gzread takes an unsigned int count
+        while (done < size)
+        {
+          const unsigned int chunk = static_cast<unsigned int>(std::min<size_t> (size - done, 1u << 30));
+          const int n = gzread (m_File, p + done, chunk);
+          if (n < 0)
+            this->Fail ("corrupt gzip data in");
+          if (n==0)
+            break;
+          done += n;
+        }
+        return done;
+      }
+
+      /** Next character, or -1 at the end. */
+      int GetChar (void)
+      {
+        unsigned char c;
+        return this->Read (&c, 1)==1 ? c : -1;
+      }
+
+      /** Read exactly size bytes. */
+      void ReadAll (void *data, size_t size)
+      {
+        if (this->Read (data, size)!=size)
+          this->Fail ("truncated data in");
+      }
+
+      /** True if nothing is left to read. */
+      bool AtEnd (void)
+      {
+        char c;
+        return this->Read (&c, 1)==0;
+      }
+
+      /** Next unsigned decimal number of a PGM header, skipping blanks and comments. */
+      unsigned long ReadHeaderNumber (void)
+      {
+        int c = this->GetChar();
+        while (c=='#' || isspace (c))
+        {
+          if (c=='#')
+            while (c!='\n' && c!=-1)
+              c = this->GetChar();
+          c = this->GetChar();
+        }
+        if (!isdigit (c))
+          this->Fail ("invalid PGM header in");
+        unsigned long value = 0;
+        while (isdigit (c))
+        {
+          value = value * 10 + (c - '0');
+          c = this->GetChar();
+        }
+        // c is the single blank ending the field
+        return value;
+      }
+
+      void Fail (const char *what)
+      {
+        itkGenericExceptionMacro (<< what << " " << m_FileName);
+      }
+
+    private:
+      SliceStream (const SliceStream&);
+      void operator=(const SliceStream&);
+
+      /** Release the file and the decompression state; also called before
+          failing in a constructor, where the destructor would not run. */
+      void Close (void)
+      {
+        if (m_File)
+          gzclose (m_File);
+        m_File = 0;
+        if (m_Inflating)
+          inflateEnd (&m_Inflate);
+        m_Inflating = false;
+#ifdef ITK_SERIES_TO_VOLUME_USE_ZSTD
+        if (m_Zstd)
+          fclose (m_Zstd);
+        m_Zstd = 0;
+        if (m_ZstdStream)
+          ZSTD_freeDStream (m_ZstdStream);
+        m_ZstdStream = 0;
+#endif
+      }
+
+      /** Set up zstd decompression of the file, or of the memory if fromFile is false. */
+      void OpenZstd (bool fromFile)
+      {
+#ifdef ITK_SERIES_TO_VOLUME_USE_ZSTD
+        m_ZstdStream = ZSTD_createDStream();
+        if (fromFile)
+        {
+          m_Zstd = fopen (m_FileName.c_str(), "rb");
+          m_Input.resize (ZSTD_DStreamInSize());
+        }
+        else
+          m_InputSize = m_MemorySize;
+        if ((fromFile && !m_Zstd) || !m_ZstdStream)
+        {
+          this->Close();
+          this->Fail ("cannot open");
+        }
+        ZSTD_initDStream (m_ZstdStream);
+#else
+        (void)fromFile;
+        itkGenericExceptionMacro (<< m_FileName << ": built without zstd support");
+#endif
+      }
+
+      std::string  m_FileName;
+      gzFile       m_File;
+      const char  *m_Memory;
+      size_t       m_MemorySize;
+      size_t       m_MemoryPosition;
+      z_stream     m_Inflate;
+      bool         m_Inflating;
+#ifdef ITK_SERIES_TO_VOLUME_USE_ZSTD
+      FILE              *m_Zstd;
+      ZSTD_DStream      *m_ZstdStream;
+      std::vector<char>  m_Input;
+      size_t             m_InputPosition;
+      size_t             m_InputSize;
+#endif
+    };
+
+
+    /** Read a binary PGM header, leaving the stream on the first pixel. */
+    void ReadPGMHeader (SliceStream &stream, SliceInformation &information)
+    {
+      if (stream.GetChar()!='P' || stream.GetChar()!='5')
+        stream.Fail ("not a binary PGM (P5) file:");
+
+      const unsigned long width  = stream.ReadHeaderNumber();
+      const unsigned long height = stream.ReadHeaderNumber();
+      const unsigned long maxval = stream.ReadHeaderNumber();
+      if (!width || !height || !maxval || maxval > 65535)
+        stream.Fail ("invalid PGM header in");
+
+      information.ComponentType      = maxval < 256 ? ImageIOBase::UCHAR : ImageIOBase::USHORT;
+      information.NumberOfComponents = 1;
+      information.Size.resize (2);
+      information.Size[0] = width;
+      information.Size[1] = height;
+      information.Spacing.assign (2, 1.0);
+      information.Origin.assign (2, 0.0);
+      information.Direction.assign (2, std::vector<double> (2, 0.0));
+      information.Direction[0][0] = information.Direction[1][1] = 1.0;
+    }
+  }
+
+
+  bool CanReadCompressedSlice (const std::string &filename)
+  {
+    const std::string extension = itksys::SystemTools::GetFilenameLastExtension (GetUncompressedName (filename));
+    return extension==".raw" || extension==".pgm";
+  }
+
+
+  bool IsRawSlice (const std::string &filename)
+  {
+    return itksys::SystemTools::GetFilenameLastExtension (GetUncompressedName (filename))==".raw";
+  }
+
+
+  namespace
+  {
+    void CheckHasHeader (const std::string &filename)
+    {
+      if (IsRawSlice (filename))
+      {
+        itkGenericExceptionMacro (<< filename << " is a raw slice: its size and pixel type must be given");
+      }
+    }
+
+
+    void ReadSlice (const std::string &filename, SliceStream &stream, const SliceInformation &information, void *buffer)
+    {
+      bool bigEndian = false;
+      if (!IsRawSlice (filename))
+      {
+        SliceInformation header;
+        ReadPGMHeader (stream, header);
+        if (!header.IsCompatibleWith (information))
+          stream.Fail ("the size or pixel type of the first slice differs in");
+        const short one = 1;
+        bigEndian = header.ComponentType==ImageIOBase::USHORT && *reinterpret_cast<const char*>(&one);
+      }
+
+      stream.ReadAll (buffer, information.GetSizeInBytes());
+      if (IsRawSlice (filename) && !stream.AtEnd())
+        stream.Fail ("the size or pixel type given for the raw slices does not match");
+
+      if (bigEndian)
+      {
+        unsigned char *p = static_cast<unsigned char*>(buffer);
+        for (unsigned long i=0; i<information.GetNumberOfPixels(); i++, p+=2)
+          std::swap (p[0], p[1]);
+      }
+    }
+  }
+
+
+  void ReadCompressedSliceInformation (const std::string &filename, SliceInformation &information)
+  {
+    CheckHasHeader (filename);
+    SliceStream stream (filename);
+    ReadPGMHeader (stream, information);
+  }
+
+
+  void ReadCompressedSliceInformation (const std::string &name, const void *data, size_t size,
+                                       SliceInformation &information)
+  {
+    CheckHasHeader (name);
+    SliceStream stream (name, data, size);
+    ReadPGMHeader (stream, information);
+  }
+
+
+  void ReadCompressedSlice (const std::string &filename, const SliceInformation &information, void *buffer)
+  {
+    SliceStream stream (filename);
+    ReadSlice (filename, stream, information, buffer);
+  }
+
+
+  void ReadCompressedSlice (const std::string &name, const void *data, size_t size,
+                            const SliceInformation &information, void *buffer)
+  {
+    SliceStream stream (name, data, size);
+    ReadSlice (name, stream, information, buffer);
+  }
+
+
+  ImageIOBase::IOComponentType ParseComponentType (const std::string &name)
+  {
+    static const char *names[] = { "uchar", "char", "ushort", "short", "uint", "int", "float", "double" };
+    static const ImageIOBase::IOComponentType types[] = {
+      ImageIOBase::UCHAR, ImageIOBase::CHAR, ImageIOBase::USHORT, ImageIOBase::SHORT,
+      ImageIOBase::UINT, ImageIOBase::INT, ImageIOBase::FLOAT, ImageIOBase::DOUBLE };
+    for (unsigned int i=0; i<sizeof(types)/sizeof(types[0]); i++)
+      if (name==names[i])
+        return types[i];
+    return ImageIOBase::UNKNOWNCOMPONENTTYPE;
+  }
+
+} // end of namespace
@@ -0,0 +1,67 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_CompressedSliceIO_h_
+#define _itk_CompressedSliceIO_h_
+
+#include "itkSeriesToVolumeUtilities.h"
+
+#include <cstddef>
+#include <string>
+
+/**
+   Read raw and binary PGM slices, gzip compressed (.gz) or not, and
+   zstd compressed (.zst) when built with zstd, streaming the
+   decompressed bytes straight into the slice buffer: no temporary file
+   and no intermediate copy. Raw slices carry no header, their size and
+   pixel type come from the caller; raw pixels are in the byte order of
+   the machine, 16-bit PGM pixels big endian as the format requires.
+   Slices already in memory, such as archive members, are decoded from
+   their bytes with the overloads taking a name, a pointer and a size.
+ */
+
+namespace itk
+{
+
+  /** True for .raw and .pgm files, possibly followed by .gz or .zst. */
+  bool CanReadCompressedSlice (const std::string &filename);
+
+  /** True if the slice is raw and needs its information from the caller. */
+  bool IsRawSlice (const std::string &filename);
+
+  /** Read the header of a PGM slice. Throws for raw slices. */
+  void ReadCompressedSliceInformation (const std::string &filename, SliceInformation &information);
+
+  /** Same, from the size bytes of the file named name held in data. */
+  void ReadCompressedSliceInformation (const std::string &name, const void *data, size_t size,
+                                       SliceInformation &information);
+
+  /** Decode a slice described by information into buffer, which holds
+      information.GetSizeInBytes(). Throws if the file does not match. */
+  void ReadCompressedSlice (const std::string &filename, const SliceInformation &information, void *buffer);
+
+  /** Same, from the size bytes of the file named name held in data. */
+  void ReadCompressedSlice (const std::string &name, const void *data, size_t size,
+                            const SliceInformation &information, void *buffer);
+
+  /** Component type named uchar, char, ushort, short, uint, int, float
+      or double (UNKNOWNCOMPONENTTYPE otherwise). */
+  ImageIOBase::IOComponentType ParseComponentType (const std::string &name);
+
+} // end of namespace
+
+
+#endif
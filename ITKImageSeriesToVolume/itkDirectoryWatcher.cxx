@@ -0,0 +1,149 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkDirectoryWatcher.h"
+
+#include <itksys/Directory.hxx>
+#include <itksys/SystemTools.hxx>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace itk
+{
+
+  DirectoryWatcher::DirectoryWatcher()
+  {
+    m_Descriptor = -1;
+  }
+
+
+  DirectoryWatcher::~DirectoryWatcher()
+  {
+#ifdef __linux__
+    if (m_Descriptor>=0)
+      close (m_Descriptor);
+#endif
+  }
+
+
+  bool DirectoryWatcher::Watch (const std::string &directory)
+  {
+    if (!itksys::SystemTools::FileIsDirectory (directory.c_str()))
+      return false;
+    m_Directory = directory;
+
+#ifdef __linux__
+    m_Descriptor = inotify_init1 (IN_NONBLOCK);
+    if (m_Descriptor>=0 && inotify_add_watch (m_Descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO)<0)
+    {
+      close (m_Descriptor);
+      m_Descriptor = -1;
+    }
+#endif
+
+    // what is already there is the caller's business
+    itksys::Directory content;
+    content.Load (directory.c_str());
+    for (unsigned long i=0; i<content.GetNumberOfFiles(); i++)
+      m_Reported.insert (content.GetFile (i));
+
+    return true;
+  }
+
+
+  void DirectoryWatcher::PollFiles (std::vector<std::string> &names)
+  {
+    itksys::Directory content;
+    content.Load (m_Directory.c_str());
+    for (unsigned long i=0; i<content.GetNumberOfFiles(); i++)
+    {
+      const std::string name = content.GetFile (i);
+      if (m_Reported.count (name))
+        continue;
+
+      const std::string path = m_Directory + "/" + name;
+      const unsigned long size = itksys::SystemTools::FileLength (path.c_str());
+      std::map<std::string, unsigned long>::iterator previous = m_PolledSizes.find (name);
+      if (previous!=m_PolledSizes.end() && previous->second==size)
+      {
+        names.push_back (name);
+        m_PolledSizes.erase (previous);
+      }
+      else
+        m_PolledSizes[name] = size;
+    }
+  }
+
+
+  void DirectoryWatcher::WaitForFiles (double timeout, std::vector<std::string> &files)
+  {
+    std::vector<std::string> names;
+
+#ifdef __linux__
+    if (m_Descriptor>=0)
+    {
+      struct pollfd descriptor;
+      descriptor.fd = m_Descriptor;
+      descriptor.events = POLLIN;
+      if (poll (&descriptor, 1, static_cast<int>(timeout * 1000)) > 0)
+      {
+        // drain the queue: a burst of slices may not fit in one read
+        char buffer[16384] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+        ssize_t length;
+        while ((length = read (m_Descriptor, buffer, sizeof(buffer))) > 0)
+        {
+          for (ssize_t offset=0; offset<length; )
+          {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+            if (event->len>0)
+              names.push_back (event->name);
+            offset += sizeof(struct inotify_event) + event->len;
+          }
+        }
+      }
+    }
+    else
+#endif
+    {
+      itksys::SystemTools::Delay (static_cast<unsigned int>(timeout * 1000));
+      this->PollFiles (names);
+    }
+
+    std::sort (names.begin(), names.end());
+    for (unsigned int i=0; i<names.size(); i++)
+    {
+      if (names[i].empty() || names[i][0]=='.' || !m_Reported.insert (names[i]).second)
+        continue;
+      files.push_back (m_Directory + "/" + names[i]);
+    }
+  }
+
+
+  void DirectoryWatcher::PrintSelf (std::ostream &os, Indent indent) const
+  {
+    Superclass::PrintSelf (os, indent);
+    os << indent << "Directory: " << m_Directory << std::endl;
+    os << indent << "Inotify: " << (m_Descriptor>=0) << std::endl;
+    os << indent << "Reported files: " << m_Reported.size() << std::endl;
+  }
+
+} // end of namespace
@@ -0,0 +1,79 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_DirectoryWatcher_h_
+#define _itk_DirectoryWatcher_h_
+
+#include "itkObject.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+   Report the files that are completely written in a directory. On
+   Linux inotify reports the files closed after writing or moved into
+   the directory; elsewhere the directory is polled and a file is
+   reported once its size did not change between two polls.
+
+   Files present when Watch is called are not reported.
+ */
+
+namespace itk
+{
+
+  class DirectoryWatcher : public Object
+  {
+  public:
+    typedef DirectoryWatcher         Self;
+    typedef Object                   Superclass;
+    typedef SmartPointer<Self>       Pointer;
+    typedef SmartPointer<const Self> ConstPointer;
+
+    itkNewMacro (Self);
+    itkTypeMacro (DirectoryWatcher, Object);
+
+    /** Start watching directory. Returns false if it cannot be watched. */
+    bool Watch (const std::string &directory);
+
+    /** Wait up to timeout seconds for new files and append their full
+        paths, sorted by name, to files. Hidden files are ignored. */
+    void WaitForFiles (double timeout, std::vector<std::string> &files);
+
+  protected:
+    DirectoryWatcher();
+    ~DirectoryWatcher();
+
+    void PrintSelf (std::ostream &os, Indent indent) const;
+
+  private:
+    DirectoryWatcher (const Self&);
+    void operator=(const Self&);
+
+    void PollFiles (std::vector<std::string> &names);
+
+    std::string                           m_Directory;
+    int                                   m_Descriptor;
+    std::set<std::string>                 m_Reported;
+    std::map<std::string, unsigned long>  m_PolledSizes;
+
+  };
+
+} // end of namespace
+
+
+#endif
@@ -0,0 +1,88 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_GrowingVolumeWriter_h_
+#define _itk_GrowingVolumeWriter_h_
+
+#include "itkObject.h"
+
+#include <fstream>
+#include <string>
+
+/**
+   Write a volume whose slices arrive one after the other as a MetaImage:
+   the pixels of each appended image are written at the end of the raw
+   data file and the .mhd header is rewritten with the new number of
+   slices, so the volume can be opened while it grows. The geometry is
+   taken from the first appended image.
+ */
+
+namespace itk
+{
+
+  template <class TImage>
+  class GrowingVolumeWriter : public Object
+  {
+  public:
+    typedef GrowingVolumeWriter      Self;
+    typedef Object                   Superclass;
+    typedef SmartPointer<Self>       Pointer;
+    typedef SmartPointer<const Self> ConstPointer;
+
+    itkNewMacro (Self);
+    itkTypeMacro (GrowingVolumeWriter, Object);
+
+    typedef TImage                          ImageType;
+    typedef typename ImageType::PixelType   PixelType;
+
+    /** Header file name, ending with .mhd; the data goes to the same
+        name ending with .raw. */
+    void SetFileName (const std::string &filename);
+
+    /** Append the slices of image, along its last dimension. */
+    void Append (const ImageType *image);
+
+    /** Write the final header and close the data file. */
+    void Close (void);
+
+    itkGetConstMacro (NumberOfSlices, unsigned long);
+
+  protected:
+    GrowingVolumeWriter();
+    ~GrowingVolumeWriter();
+
+    void WriteHeader (void);
+    void PrintSelf (std::ostream &os, Indent indent) const;
+
+  private:
+    GrowingVolumeWriter (const Self&);
+    void operator=(const Self&);
+
+    std::string                   m_FileName;
+    std::string                   m_DataFileName;
+    std::ofstream                 m_Data;
+    typename ImageType::Pointer   m_Geometry;
+    unsigned long                 m_NumberOfSlices;
+
+  };
+
+} // end of namespace
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkGrowingVolumeWriter.txx"
+#endif
+
+#endif
@@ -0,0 +1,177 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_GrowingVolumeWriter_txx_
+#define _itk_GrowingVolumeWriter_txx_
+
+#include "itkGrowingVolumeWriter.h"
+
+#include <itksys/SystemTools.hxx>
+
+namespace itk
+{
+
+  /** MetaImage name of a pixel type. */
+  template <class TPixel> const char *GetMetaElementType (void)   { return "MET_OTHER"; }
+  template <> inline const char *GetMetaElementType<unsigned char> (void)  { return "MET_UCHAR"; }
+  template <> inline const char *GetMetaElementType<char> (void)           { return "MET_CHAR"; }
+  template <> inline const char *GetMetaElementType<unsigned short> (void) { return "MET_USHORT"; }
+  template <> inline const char *GetMetaElementType<short> (void)          { return "MET_SHORT"; }
+  template <> inline const char *GetMetaElementType<unsigned int> (void)   { return "MET_UINT"; }
+  template <> inline const char *GetMetaElementType<int> (void)            { return "MET_INT"; }
+  template <> inline const char *GetMetaElementType<float> (void)          { return "MET_FLOAT"; }
+  template <> inline const char *GetMetaElementType<double> (void)         { return "MET_DOUBLE"; }
+
+
+  template <class TImage>
+  GrowingVolumeWriter<TImage>::GrowingVolumeWriter()
+  {
+    m_NumberOfSlices = 0;
+  }
+
+
+  template <class TImage>
+  GrowingVolumeWriter<TImage>::~GrowingVolumeWriter()
+  {
+    if (m_Data.is_open())
+      this->Close();
+  }
+
+
+  template <class TImage>
+  void
+  GrowingVolumeWriter<TImage>::SetFileName (const std::string &filename)
+  {
+    if (itksys::SystemTools::GetFilenameLastExtension (filename)!=".mhd")
+    {
+      itkExceptionMacro (<< filename << " is not a MetaImage header (.mhd)");
+    }
+    m_FileName = filename;
+    m_DataFileName = itksys::SystemTools::GetFilenameWithoutLastExtension (filename) + ".raw";
+  }
+
+
+  template <class TImage>
+  void
+  GrowingVolumeWriter<TImage>::Append (const ImageType *image)
+  {
+    const unsigned int axis = ImageType::ImageDimension-1;
+    const typename ImageType::RegionType &region = image->GetBufferedRegion();
+
+    if (m_Geometry.IsNull())
+    {
+      const std::string path = itksys::SystemTools::GetFilenamePath (m_FileName);
+      m_Data.open ((path.empty() ? m_DataFileName : path + "/" + m_DataFileName).c_str(),
+                   std::ios::out | std::ios::binary | std::ios::trunc);
+      if (!m_Data)
+      {
+        itkExceptionMacro (<< "cannot write " << m_DataFileName);
+      }
+      m_Geometry = ImageType::New();
+      m_Geometry->SetRegions (region);
+      m_Geometry->SetSpacing (image->GetSpacing());
+      m_Geometry->SetOrigin (image->GetOrigin());
+      m_Geometry->SetDirection (image->GetDirection());
+    }
+
+    for (unsigned int i=0; i<axis; i++)
+    {
+      if (region.GetSize (i)!=m_Geometry->GetLargestPossibleRegion().GetSize (i))
+      {
+        itkExceptionMacro (<< "the slices to append do not have the size of the first ones");
+      }
+    }
+
+    m_Data.write (reinterpret_cast<const char*>(image->GetBufferPointer()),
+                  region.GetNumberOfPixels() * sizeof(PixelType));
+    m_Data.flush();
+    if (!m_Data)
+    {
+      itkExceptionMacro (<< "cannot write " << m_DataFileName);
+    }
+    m_NumberOfSlices += region.GetSize (axis);
+
+    this->WriteHeader();
+  }
+
+
+  template <class TImage>
+  void
+  GrowingVolumeWriter<TImage>::WriteHeader (void)
+  {
+    const unsigned int dimension = ImageType::ImageDimension;
+    const typename ImageType::RegionType &region = m_Geometry->GetLargestPossibleRegion();
+
+    // written aside and renamed, readers never see half a header
+    const std::string temporary = m_FileName + ".tmp";
+    {
+      std::ofstream header (temporary.c_str());
+      const short one = 1;
+      header << "ObjectType = Image\n";
+      header << "NDims = " << dimension << "\n";
+      header << "BinaryData = True\n";
+      header << "BinaryDataByteOrderMSB = "
+             << (*reinterpret_cast<const char*>(&one) ? "False" : "True") << "\n";
+      header << "CompressedData = False\n";
+      header << "TransformMatrix =";
+      for (unsigned int i=0; i<dimension; i++)
+        for (unsigned int j=0; j<dimension; j++)
+          header << " " << m_Geometry->GetDirection()[j][i];
+      header << "\nOffset =";
+      for (unsigned int i=0; i<dimension; i++)
+        header << " " << m_Geometry->GetOrigin()[i];
+      header << "\nElementSpacing =";
+      for (unsigned int i=0; i<dimension; i++)
+        header << " " << m_Geometry->GetSpacing()[i];
+      header << "\nDimSize =";
+      for (unsigned int i=0; i<dimension-1; i++)
+        header << " " << region.GetSize (i);
+      header << " " << m_NumberOfSlices << "\n";
+      header << "ElementType = " << GetMetaElementType<PixelType>() << "\n";
+      header << "ElementDataFile = " << m_DataFileName << "\n";
+    }
+    // rename replaces the header atomically on POSIX; Windows cannot
+    // rename onto an existing file
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    itksys::SystemTools::RemoveFile (m_FileName.c_str());
+#endif
+    itksys::SystemTools::RenameFile (temporary.c_str(), m_FileName.c_str());
+  }
+
+
+  template <class TImage>
+  void
+  GrowingVolumeWriter<TImage>::Close (void)
+  {
+    if (m_Geometry.IsNotNull())
+      this->WriteHeader();
+    m_Data.close();
+  }
+
+
+  template <class TImage>
+  void
+  GrowingVolumeWriter<TImage>::PrintSelf (std::ostream &os, Indent indent) const
+  {
+    Superclass::PrintSelf (os, indent);
+    os << indent << "FileName: " << m_FileName << std::endl;
+    os << indent << "DataFileName: " << m_DataFileName << std::endl;
+    os << indent << "NumberOfSlices: " << m_NumberOfSlices << std::endl;
+  }
+
+} // end of namespace
+
+#endif
@@ -0,0 +1,428 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_SeriesToVolumeAssembler_h_
+#define _itk_SeriesToVolumeAssembler_h_
+
+#include "itkImage.h"
+#include "itkImageSource.h"
+#include "itkImageIOBase.h"
+#include "itkFixedArray.h"
+#include "itkMultiThreader.h"
+
+#include "itkSeriesToVolumeUtilities.h"
+#include "itkSliceBufferPool.h"
+#include "itkSliceArchive.h"
+
+#include <string>
+#include <vector>
+
+/**
+   Stack a series of N-1 dimensional slices into an N dimensional image.
+
+   The slices are either files, decoded with the ImageIO matching each
+   of them (raw and PGM slices, possibly compressed, are streamed by
+   itkCompressedSliceIO.h instead), the members of a tar or zip archive,
+   read in memory by the threads without extracting the archive, or
+   buffers already decoded in memory and described by one
+   SliceInformation. Slices are decoded by the threads of the filter,
+   each thread filling whole slices of its slab of the output, so the
+   assembler streams: connect it to a writer (or call Write) to produce
+   the volume slab by slab, or Update it and take GetOutput().
+
+   Optionally the constant slices at both ends of the series are dropped
+   (CropEmptySlices) and the intensities are mapped to the output type
+   linearly, between percentiles of a sample of the slices, or through a
+   lookup table. Progress is reported with the usual ProgressEvent.
+
+   Scratch buffers come from a SliceBufferPool, which may be shared
+   between assemblers, and slices whose component type is the output
+   pixel type are decoded straight into the output, so that the decode
+   and conversion buffers are not allocated per slice. The readers still
+   allocate their own state per slice: the ImageIO reading the header,
+   the gzip stream and the zstd input buffer of compressed slices, and
+   the temporary file of archive members read by an ImageIO.
+
+   With NumaPlacement on, the threads are spread over the NUMA nodes in
+   order, so that each node gets a contiguous part of the volume, and
+   bound to the CPUs of their node: the output pages, first touched by
+   the thread decoding into them, then live on the node that writes them.
+
+   With ComputeProjections on, a 3D output also gets its maximum intensity
+   projections along each axis and its middle slice, accumulated as the
+   slices are decoded.
+
+   With TolerateFailures on, a slice that cannot be decoded no longer
+   aborts the assembly: it is recorded in GetSliceFailures() and filled,
+   by the thread that failed on it, with FillValue or with a linear
+   interpolation of the nearest readable slices on both sides.
+
+   The spacing of the stacking dimension is derived from the positions of
+   the slices when their headers have one (the origin of a DICOM slice
+   read in 3D), scanned by the threads before the first slice is decoded.
+   Unevenly spaced slices are reported by GetUniformSpacing() and, with
+   ResampleNonUniformSpacing on, resampled to the mean spacing as they are
+   streamed, each output slice being interpolated between the two input
+   slices around its position.
+ */
+
+namespace itk
+{
+
+  template <class TOutputImage>
+  class SeriesToVolumeAssembler : public ImageSource<TOutputImage>
+  {
+  public:
+    typedef SeriesToVolumeAssembler      Self;
+    typedef ImageSource<TOutputImage>    Superclass;
+    typedef SmartPointer<Self>           Pointer;
+    typedef SmartPointer<const Self>     ConstPointer;
+
+    itkNewMacro (Self);
+    itkTypeMacro (SeriesToVolumeAssembler, ImageSource);
+
+    itkStaticConstMacro (OutputImageDimension, unsigned int, TOutputImage::ImageDimension);
+
+    typedef TOutputImage                              OutputImageType;
+    typedef typename OutputImageType::PixelType       PixelType;
+    typedef typename OutputImageType::RegionType      OutputImageRegionType;
+    typedef typename OutputImageType::SpacingType     SpacingType;
+    typedef typename OutputImageType::PointType       PointType;
+    typedef typename OutputImageType::DirectionType   DirectionType;
+    typedef std::vector<PixelType>                    LookupTableType;
+    typedef Image<PixelType, 2>                       ProjectionImageType;
+
+    typedef enum
+    {
+      ConstantFill,
+      InterpolateFill
+    } FailureFillType;
+
+    /** A slice that could not be decoded. */
+    struct SliceFailure
+    {
+      unsigned int Slice;
+      std::string  FileName;
+      std::string  Description;
+      bool         Interpolated;
+    };
+
+    typedef enum
+    {
+      NoRescale,
+      LinearRescale,
+      PercentileRescale,
+      LookupTableRescale
+    } RescaleModeType;
+
+    /** Slices read from files. */
+    void SetFileNames (const std::vector<std::string> &filenames);
+    void AddFileName (const std::string &filename);
+
+    /** Slices decoded in memory, all described by the slice information.
+        The buffers must stay valid until the output is generated. */
+    void SetSliceInformation (const SliceInformation &information);
+    void AddSliceBuffer (const void *buffer);
+
+    /** Slices read from the members of an opened archive, in name order.
+        Members that are neither raw nor PGM slices are extracted one at a
+        time to a temporary file, for their ImageIO. */
+    void SetArchive (SliceArchive *archive);
+    const SliceArchive *GetArchive (void) const
+    { return m_Archive.GetPointer(); }
+
+    /** Size and pixel type of the .raw slice files, which have no header. */
+    void SetRawSliceInformation (const SliceInformation &information);
+
+    void ClearSlices (void);
+    unsigned int GetNumberOfSlices (void) const
+    { return m_Slices.size(); }
+
+    /** Override the spacing read from the slices along one dimension.
+        Without override the stacking dimension has the spacing of the
+        slice positions, or 1.0 when they are unknown. */
+    void SetSpacing (unsigned int dimension, double spacing);
+
+    /** Derive the spacing, origin and direction of the stacking dimension
+        from the positions of the slices. */
+    itkSetMacro (SpacingFromPositions, bool);
+    itkGetConstMacro (SpacingFromPositions, bool);
+    itkBooleanMacro (SpacingFromPositions);
+
+    /** Resample unevenly spaced slices to their mean spacing. */
+    itkSetMacro (ResampleNonUniformSpacing, bool);
+    itkGetConstMacro (ResampleNonUniformSpacing, bool);
+    itkBooleanMacro (ResampleNonUniformSpacing);
+
+    /** Whether the stacking spacing comes from the slice positions, and
+        whether the gaps between the kept slices, in [min, max], are all
+        within 1% of it; valid after UpdateOutputInformation(). */
+    itkGetConstMacro (SlicePositionsFound, bool);
+    itkGetConstMacro (UniformSpacing, bool);
+    const double *GetSliceGapRange (void) const
+    { return m_SliceGapRange; }
+
+    /** Drop the constant slices at both ends of the series. */
+    itkSetMacro (CropEmptySlices, bool);
+    itkGetConstMacro (CropEmptySlices, bool);
+    itkBooleanMacro (CropEmptySlices);
+
+    /** Range of slices kept in the output, valid after UpdateOutputInformation(). */
+    itkGetConstMacro (FirstSlice, unsigned int);
+    itkGetConstMacro (LastSlice, unsigned int);
+
+    itkSetMacro (RescaleMode, RescaleModeType);
+    itkGetConstMacro (RescaleMode, RescaleModeType);
+
+    /** Input range of the linear mapping; when empty it is sampled from the series. */
+    void SetInputRange (double minimum, double maximum);
+
+    /** Input range mapped to the output range, valid after UpdateOutputInformation(). */
+    const double *GetRescaleRange (void) const
+    { return m_RescaleRange; }
+
+    /** Percentiles of the sampled intensities mapped to the output range. */
+    void SetPercentiles (double low, double high);
+
+    /** Output value of input value offset + k at position k. */
+    void SetLookupTable (const LookupTableType &table, double offset);
+
+    /** Memory budget of Write, in bytes (0: unlimited). */
+    itkSetMacro (MaxMemory, unsigned long long);
+    itkGetConstMacro (MaxMemory, unsigned long long);
+
+    /** Stream the volume to a file in as many slabs as MaxMemory requires. */
+    void Write (const std::string &filename);
+
+    /** Make the memory plan of Write to filename, which may change the
+        number of threads, and so modify the filter: call it before
+        UpdateOutputInformation() for the output information (cropping,
+        rescaling samples, slice positions) not to be generated again by
+        Write, which otherwise makes the plan itself. */
+    void PlanWrite (const std::string &filename);
+
+    /** ImageIO of Write, to configure it; by default the writer picks
+        one from the file name. */
+    itkSetObjectMacro (ImageIO, ImageIOBase);
+    itkGetObjectMacro (ImageIO, ImageIOBase);
+
+    /** Pool the decoding buffers are taken from. */
+    itkSetObjectMacro (BufferPool, SliceBufferPool);
+    itkGetObjectMacro (BufferPool, SliceBufferPool);
+
+    /** Bind the decoding threads to NUMA nodes. */
+    itkSetMacro (NumaPlacement, bool);
+    itkGetConstMacro (NumaPlacement, bool);
+    itkBooleanMacro (NumaPlacement);
+
+    /** Hash every output slice as it is produced (see itkSliceHashes.h). */
+    itkSetMacro (ComputeSliceHashes, bool);
+    itkGetConstMacro (ComputeSliceHashes, bool);
+    itkBooleanMacro (ComputeSliceHashes);
+
+    /** Hashes of the output slices, valid once they were all generated. */
+    const std::vector<unsigned long long> &GetSliceHashes (void) const
+    { return m_SliceHashes; }
+
+    /** Accumulate the maximum intensity projections of a 3D output. */
+    itkSetMacro (ComputeProjections, bool);
+    itkGetConstMacro (ComputeProjections, bool);
+    itkBooleanMacro (ComputeProjections);
+
+    /** Maximum intensity projection along axis (2: XY, 1: XZ, 0: YZ; the
+        stacking axis is the second one of XZ and YZ), valid once every
+        slice was generated. */
+    typename ProjectionImageType::Pointer GetProjection (unsigned int axis) const;
+
+    /** Middle slice of the output, for thumbnails. */
+    typename ProjectionImageType::Pointer GetMiddleSlice (void) const;
+
+    /** Fill the slices that cannot be decoded instead of failing. */
+    itkSetMacro (TolerateFailures, bool);
+    itkGetConstMacro (TolerateFailures, bool);
+    itkBooleanMacro (TolerateFailures);
+
+    itkSetMacro (FailureFill, FailureFillType);
+    itkGetConstMacro (FailureFill, FailureFillType);
+
+    /** Value of the slices that cannot be decoded, nor interpolated. */
+    itkSetMacro (FillValue, double);
+    itkGetConstMacro (FillValue, double);
+
+    /** Slices filled in the last update (or write), by slice number. */
+    const std::vector<SliceFailure> &GetSliceFailures (void) const
+    { return m_SliceFailures; }
+
+    /** Output bytes decoded and time spent by the threads of each NUMA
+        node since the last call to Write, or since the first update. */
+    const std::vector<NumaNodeStatistics> &GetNumaNodeStatistics (void) const
+    { return m_NumaNodeStatistics; }
+
+    /** Layout chosen by the last call to Write. */
+    const MemoryPlan &GetMemoryPlan (void) const
+    { return m_MemoryPlan; }
+
+  protected:
+    SeriesToVolumeAssembler();
+    ~SeriesToVolumeAssembler();
+
+    void GenerateOutputInformation (void);
+    void EnlargeOutputRequestedRegion (DataObject *output);
+    void BeforeThreadedGenerateData (void);
+    void AfterThreadedGenerateData (void);
+    void ThreadedGenerateData (const OutputImageRegionType &outputRegionForThread, int threadId);
+    int  SplitRequestedRegion (int i, int num, OutputImageRegionType &splitRegion);
+    void PrintSelf (std::ostream &os, Indent indent) const;
+
+    /** Decode one slice of the series in its own component type. Memory
+        slices are returned as is, file slices are read with io, which is
+        kept from one call to the next, into buffer, which must hold
+        GetSizeInBytes() of the slice information. */
+    const void *ReadSlice (unsigned int slice, ImageIOBase::Pointer &io, void *buffer) const;
+
+    /** Decode a slice file with io, created for it if it cannot read it. */
+    void ReadSliceFile (const std::string &filename, ImageIOBase::Pointer &io, void *buffer) const;
+
+    /** Decode one slice into out, in the output pixel type, with the
+        thread buffers of ThreadedGenerateData. */
+    void DecodeSlice (unsigned int slice, ImageIOBase::Pointer &io, void *buffer,
+                      float *floats, PixelType *out) const;
+
+  private:
+    SeriesToVolumeAssembler (const Self&);
+    void operator=(const Self&);
+
+    void ReadFirstSliceInformation (void);
+    void ReadSliceFileInformation (const std::string &filename);
+    void FindNonEmptySlices (void);
+    void EstimateRescaling (void);
+    void ReleaseThreadBuffers (void);
+    bool IsEmptySlice (unsigned int slice, ImageIOBase::Pointer &io, void *buffer) const;
+    void FillFailedSlice (unsigned int slice, const char *description, ImageIOBase::Pointer &io,
+                          void *buffer, float *floats, PixelType *out, int threadId);
+    bool InterpolateSlice (unsigned int slice, ImageIOBase::Pointer &io, void *buffer,
+                           float *floats, PixelType *out) const;
+    void DecodeOrFillSlice (unsigned int slice, ImageIOBase::Pointer &io, void *buffer,
+                            float *floats, PixelType *out, int threadId);
+    void ResampleSlice (long z, ImageIOBase::Pointer &io, void *buffer, float *floats,
+                        PixelType *out, long cached[2], int threadId);
+    void ScanSlicePositions (void);
+    static ITK_THREAD_RETURN_TYPE ScanSlicePositionsThread (void *arg);
+    bool PlaceSlices (double &spacing, PointType &origin, DirectionType &direction);
+    void AccumulateProjections (const PixelType *slice, long z, int threadId);
+    typename ProjectionImageType::Pointer MakeProjectionImage (const std::vector<PixelType> &pixels,
+                                                               unsigned int width) const;
+
+    struct SliceFailureLess
+    {
+      bool operator() (const SliceFailure &a, const SliceFailure &b) const
+      { return a.Slice < b.Slice; }
+    };
+    struct SliceFailureEqual
+    {
+      bool operator() (const SliceFailure &a, const SliceFailure &b) const
+      { return a.Slice == b.Slice; }
+    };
+
+    struct SliceEntry
+    {
+      std::string  FileName;
+      const void  *Buffer;
+      unsigned int Member;
+    };
+
+    std::vector<SliceEntry>         m_Slices;
+    SliceArchive::Pointer           m_Archive;
+    SliceInformation                m_SliceInformation;
+    SliceInformation                m_RawSliceInformation;
+    bool                            m_HasSliceBuffers;
+
+    SpacingType                     m_Spacing;
+    FixedArray<bool, OutputImageDimension> m_OverrideSpacing;
+
+    /** Positions of the slices, empty when unknown, and the input slices
+        around each output slice when resampling: slice m_ResampleLower[z]
+        with weight 1 - m_ResampleWeight[z], and the next one. */
+    bool                            m_SpacingFromPositions;
+    bool                            m_ResampleNonUniformSpacing;
+    bool                            m_SlicePositionsFound;
+    bool                            m_UniformSpacing;
+    double                          m_SliceGapRange[2];
+    std::vector< std::vector<double> > m_SlicePositions;
+    std::vector<unsigned int>       m_ResampleLower;
+    std::vector<double>             m_ResampleWeight;
+
+    bool                            m_CropEmptySlices;
+    unsigned int                    m_FirstSlice;
+    unsigned int                    m_LastSlice;
+
+    RescaleModeType                 m_RescaleMode;
+    double                          m_InputRange[2];
+    double                          m_RescaleRange[2];
+    double                          m_Percentiles[2];
+    LookupTableType                 m_LookupTable;
+    double                          m_LookupTableOffset;
+    float                           m_Scale;
+    float                           m_Shift;
+
+    unsigned long long              m_MaxMemory;
+    MemoryPlan                      m_MemoryPlan;
+    std::string                     m_PlannedFileName;
+    ImageIOBase::Pointer            m_ImageIO;
+
+    /** Per thread decoding state; no buffer is needed when decoding
+        directly into the output. */
+    SliceBufferPool::Pointer            m_BufferPool;
+    bool                                m_DecodeIntoOutput;
+    std::vector<ImageIOBase::Pointer>   m_ThreadImageIOs;
+    std::vector<void*>                  m_ThreadBuffers;
+    std::vector<float*>                 m_ThreadFloatBuffers;
+    std::vector<PixelType*>             m_ThreadResampleBuffers;
+
+    bool                                m_NumaPlacement;
+    unsigned int                        m_NumberOfNumaNodes;
+    std::vector<NumaNodeStatistics>     m_NumaNodeStatistics;
+    std::vector<double>                 m_ThreadSeconds;
+    std::vector<unsigned long long>     m_ThreadBytes;
+
+    bool                                m_ComputeSliceHashes;
+    std::vector<unsigned long long>     m_SliceHashes;
+
+    /** Projections along x, y and z, the last one being accumulated per
+        thread and merged after each pass. */
+    bool                                m_ComputeProjections;
+    std::vector<PixelType>              m_Projections[3];
+    std::vector<PixelType>              m_MiddleSlice;
+    std::vector<PixelType*>             m_ThreadProjections;
+
+    /** Failures recorded per thread, without locking, and merged after
+        each pass. */
+    bool                                m_TolerateFailures;
+    FailureFillType                     m_FailureFill;
+    double                              m_FillValue;
+    std::vector<SliceFailure>           m_SliceFailures;
+    std::vector< std::vector<SliceFailure> > m_ThreadFailures;
+
+  };
+
+
+} // end of namespace
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkSeriesToVolumeAssembler.txx"
+#endif
+
+#endif
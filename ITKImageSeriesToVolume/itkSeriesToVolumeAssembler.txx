@@ -0,0 +1,1302 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_SeriesToVolumeAssembler_txx_
+#define _itk_SeriesToVolumeAssembler_txx_
+
+#include "itkSeriesToVolumeAssembler.h"
+#include "itkConvertPixelBuffer.h"
+#include "itkDefaultConvertPixelTraits.h"
+#include "itkImageFileWriter.h"
+#include "itkImageIOFactory.h"
+#include "itkNumericTraits.h"
+#include "itkProgressReporter.h"
+
+#include "itkSliceKernels.h"
+#include "itkSliceHashes.h"
+#include "itkCompressedSliceIO.h"
+
+#include <itksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cmath>
+
+namespace itk
+{
+
+  /**
+     Convert numberOfPixels pixels of a decoded slice to TPixel, the same
+     way ImageFileReader converts what its ImageIO reads.
+   */
+  template <class TPixel>
+  void ConvertSliceComponents (const void *in, ImageIOBase::IOComponentType type,
+                               unsigned int numberOfComponents, TPixel *out, size_t numberOfPixels)
+  {
+#define ITK_CONVERT_SLICE_CASE(ioType, componentType)                   \
+    case ImageIOBase::ioType:                                           \
+      ConvertPixelBuffer<componentType, TPixel, DefaultConvertPixelTraits<TPixel> >::Convert ( \
+        const_cast<componentType*>(static_cast<const componentType*>(in)), \
+        numberOfComponents, out, numberOfPixels);                       \
+      break
+
+    switch (type)
+    {
+        ITK_CONVERT_SLICE_CASE (UCHAR,  unsigned char);
+        ITK_CONVERT_SLICE_CASE (CHAR,   char);
+        ITK_CONVERT_SLICE_CASE (USHORT, unsigned short);
+        ITK_CONVERT_SLICE_CASE (SHORT,  short);
+        ITK_CONVERT_SLICE_CASE (UINT,   unsigned int);
+        ITK_CONVERT_SLICE_CASE (INT,    int);
+        ITK_CONVERT_SLICE_CASE (ULONG,  unsigned long);
+        ITK_CONVERT_SLICE_CASE (LONG,   long);
+        ITK_CONVERT_SLICE_CASE (FLOAT,  float);
+        ITK_CONVERT_SLICE_CASE (DOUBLE, double);
+        default:
+          itkGenericExceptionMacro (<< "unsupported component type " << type);
+    }
+
+#undef ITK_CONVERT_SLICE_CASE
+  }
+
+
+  /** out = (1 - w) a + w b, rounded to the nearest for integer pixels; out may be a. */
+  template <class TPixel>
+  void BlendSlices (const TPixel *a, const TPixel *b, double w, TPixel *out, size_t numberOfPixels)
+  {
+    const double rounding = NumericTraits<TPixel>::is_integer ? 0.5 : 0.0;
+    for (size_t i=0; i<numberOfPixels; i++)
+    {
+      const double v = a[i] * (1.0 - w) + b[i] * w;
+      out[i] = static_cast<TPixel>(v < 0.0 ? v - rounding : v + rounding);
+    }
+  }
+
+
+  template <class TOutputImage>
+  SeriesToVolumeAssembler<TOutputImage>::SeriesToVolumeAssembler()
+  {
+    m_HasSliceBuffers = false;
+    m_Spacing.Fill (1.0);
+    m_OverrideSpacing.Fill (false);
+    m_SpacingFromPositions = true;
+    m_ResampleNonUniformSpacing = false;
+    m_SlicePositionsFound = false;
+    m_UniformSpacing = true;
+    m_SliceGapRange[0] = m_SliceGapRange[1] = 1.0;
+
+    m_CropEmptySlices = false;
+    m_FirstSlice = 0;
+    m_LastSlice  = 0;
+
+    m_RescaleMode = NoRescale;
+    m_InputRange[0] = m_InputRange[1] = 0.0;
+    m_RescaleRange[0] = m_RescaleRange[1] = 0.0;
+    m_Percentiles[0] = 0.5;
+    m_Percentiles[1] = 99.5;
+    m_LookupTableOffset = 0.0;
+    m_Scale = 1.0f;
+    m_Shift = 0.0f;
+
+    m_MaxMemory = 0;
+    m_MemoryPlan.VolumeBytes = 0;
+    m_MemoryPlan.SliceBytes  = 0;
+    m_MemoryPlan.NumberOfStreamDivisions = 1;
+    m_MemoryPlan.NumberOfThreads = this->GetNumberOfThreads();
+    m_MemoryPlan.UseCompression = true;
+
+    m_BufferPool = SliceBufferPool::New();
+    m_DecodeIntoOutput = false;
+
+    m_NumaPlacement = false;
+    m_NumberOfNumaNodes = 1;
+
+    m_ComputeSliceHashes = false;
+    m_ComputeProjections = false;
+
+    m_TolerateFailures = false;
+    m_FailureFill = ConstantFill;
+    m_FillValue = 0.0;
+  }
+
+
+  template <class TOutputImage>
+  SeriesToVolumeAssembler<TOutputImage>::~SeriesToVolumeAssembler()
+  {
+    this->ReleaseThreadBuffers();
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::SetFileNames (const std::vector<std::string> &filenames)
+  {
+    this->ClearSlices();
+    for (unsigned int i=0; i<filenames.size(); i++)
+      this->AddFileName (filenames[i]);
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::AddFileName (const std::string &filename)
+  {
+    if (m_HasSliceBuffers || m_Archive)
+    {
+      itkExceptionMacro (<< "file slices cannot be mixed with memory or archive slices");
+    }
+    SliceEntry entry;
+    entry.FileName = filename;
+    entry.Buffer   = 0;
+    entry.Member   = 0;
+    m_Slices.push_back (entry);
+    this->Modified();
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::SetSliceInformation (const SliceInformation &information)
+  {
+    m_SliceInformation = information;
+    this->Modified();
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::AddSliceBuffer (const void *buffer)
+  {
+    if (!m_HasSliceBuffers && !m_Slices.empty())
+    {
+      itkExceptionMacro (<< "memory slices cannot be mixed with file slices");
+    }
+    m_HasSliceBuffers = true;
+    SliceEntry entry;
+    entry.Buffer = buffer;
+    entry.Member = 0;
+    m_Slices.push_back (entry);
+    this->Modified();
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::SetArchive (SliceArchive *archive)
+  {
+    this->ClearSlices();
+    m_Archive = archive;
+    for (unsigned int i=0; i<archive->GetNumberOfMembers(); i++)
+    {
+      SliceEntry entry;
+      entry.FileName = archive->GetMemberName (i);
+      entry.Buffer   = 0;
+      entry.Member   = i;
+      m_Slices.push_back (entry);
+    }
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::SetRawSliceInformation (const SliceInformation &information)
+  {
+    m_RawSliceInformation = information;
+    this->Modified();
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::ClearSlices (void)
+  {
+    m_Slices.clear();
+    m_Archive = 0;
+    m_HasSliceBuffers = false;
+    this->Modified();
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::SetSpacing (unsigned int dimension, double spacing)
+  {
+    m_Spacing[dimension] = spacing;
+    m_OverrideSpacing[dimension] = true;
+    this->Modified();
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::SetInputRange (double minimum, double maximum)
+  {
+    m_InputRange[0] = minimum;
+    m_InputRange[1] = maximum;
+    this->Modified();
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::SetPercentiles (double low, double high)
+  {
+    m_Percentiles[0] = low;
+    m_Percentiles[1] = high;
+    this->Modified();
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::SetLookupTable (const LookupTableType &table, double offset)
+  {
+    m_LookupTable = table;
+    m_LookupTableOffset = offset;
+    this->Modified();
+  }
+
+
+  template <class TOutputImage>
+  const void *
+  SeriesToVolumeAssembler<TOutputImage>::ReadSlice (unsigned int slice, ImageIOBase::Pointer &io,
+                                                    void *buffer) const
+  {
+    const SliceEntry &entry = m_Slices[slice];
+    if (entry.Buffer)
+      return entry.Buffer;
+
+    // streamed without ImageIO, nor temporary file
+    if (CanReadCompressedSlice (entry.FileName))
+    {
+      if (m_Archive)
+      {
+        const size_t size = m_Archive->GetMemberSize (entry.Member);
+        SliceBufferPool::ScopedBuffer data (m_BufferPool, std::max<size_t> (size, 1));
+        m_Archive->ReadMember (entry.Member, data.GetPointer());
+        ReadCompressedSlice (entry.FileName, data.GetPointer(), size, m_SliceInformation, buffer);
+      }
+      else
+        ReadCompressedSlice (entry.FileName, m_SliceInformation, buffer);
+      return buffer;
+    }
+
+    if (m_Archive)
+    {
+      SliceArchive::ScopedExtraction extraction (m_Archive, entry.Member);
+      this->ReadSliceFile (extraction.GetFileName(), io, buffer);
+    }
+    else
+      this->ReadSliceFile (entry.FileName, io, buffer);
+    return buffer;
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::ReadSliceFile (const std::string &name, ImageIOBase::Pointer &io,
+                                                        void *buffer) const
+  {
+    const char *filename = name.c_str();
+    if (io.IsNull() || !io->CanReadFile (filename))
+    {
+      io = ImageIOFactory::CreateImageIO (filename, ImageIOFactory::ReadMode);
+      if (io.IsNull())
+      {
+        itkExceptionMacro (<< "cannot find an ImageIO to read " << filename);
+      }
+    }
+    io->SetFileName (filename);
+    io->ReadImageInformation();
+
+    if (!m_SliceInformation.IsCompatibleWith (io.GetPointer()))
+    {
+      itkExceptionMacro (<< filename << " does not have the size and pixel type of the first slice");
+    }
+
+    io->Read (buffer);
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::ReadFirstSliceInformation (void)
+  {
+    if (m_Slices.empty())
+    {
+      itkExceptionMacro (<< "no slice to assemble");
+    }
+    if (m_HasSliceBuffers)
+      return;
+
+    // when tolerating failures, the first slice whose header can be read
+    for (unsigned int i=0; i<m_Slices.size(); i++)
+    {
+      const char *filename = m_Slices[i].FileName.c_str();
+      try
+      {
+        if (CanReadCompressedSlice (filename))
+        {
+          if (!IsRawSlice (filename) && m_Archive)
+          {
+            const size_t size = m_Archive->GetMemberSize (m_Slices[i].Member);
+            std::vector<char> data (size + 1);
+            m_Archive->ReadMember (m_Slices[i].Member, &data[0]);
+            ReadCompressedSliceInformation (filename, &data[0], size, m_SliceInformation);
+          }
+          else if (!IsRawSlice (filename))
+            ReadCompressedSliceInformation (filename, m_SliceInformation);
+          else if (m_RawSliceInformation.GetNumberOfPixels())
+            m_SliceInformation = m_RawSliceInformation;
+          else
+          {
+            itkExceptionMacro (<< filename << " is a raw slice: its size and pixel type must be given");
+          }
+          return;
+        }
+
+        if (m_Archive)
+        {
+          SliceArchive::ScopedExtraction extraction (m_Archive, m_Slices[i].Member);
+          this->ReadSliceFileInformation (extraction.GetFileName());
+        }
+        else
+          this->ReadSliceFileInformation (filename);
+        return;
+      }
+      catch (ExceptionObject &)
+      {
+        if (!m_TolerateFailures || i+1==m_Slices.size())
+          throw;
+      }
+    }
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::ReadSliceFileInformation (const std::string &filename)
+  {
+    ImageIOBase::Pointer io = ImageIOFactory::CreateImageIO (filename.c_str(), ImageIOFactory::ReadMode);
+    if (io.IsNull())
+    {
+      itkExceptionMacro (<< "cannot find an ImageIO to read " << filename);
+    }
+    io->SetFileName (filename.c_str());
+    io->ReadImageInformation();
+    ReadSliceInformation (io, m_SliceInformation);
+    m_SliceInformation.DropSingletonDimensions (OutputImageDimension-1);
+  }
+
+
+  template <class TOutputImage>
+  bool
+  SeriesToVolumeAssembler<TOutputImage>::IsEmptySlice (unsigned int slice, ImageIOBase::Pointer &io,
+                                                       void *buffer) const
+  {
+    // unreadable slices at the ends are cropped like empty ones
+    try
+    {
+      return IsConstantBuffer (this->ReadSlice (slice, io, buffer), m_SliceInformation.GetSizeInBytes(),
+                               m_SliceInformation.GetPixelSize());
+    }
+    catch (ExceptionObject &)
+    {
+      if (!m_TolerateFailures)
+        throw;
+      io = 0;
+      return true;
+    }
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::FindNonEmptySlices (void)
+  {
+    // only the empty borders and the first non-empty slices are decoded
+    ImageIOBase::Pointer io;
+    const unsigned int   numberOfSlices = m_Slices.size();
+    SliceBufferPool::ScopedBuffer buffer (m_BufferPool, m_SliceInformation.GetSizeInBytes());
+
+    unsigned int first = 0;
+    while (first < numberOfSlices
+           && this->IsEmptySlice (first, io, buffer.GetPointer()))
+      first++;
+    if (first==numberOfSlices)
+    {
+      itkExceptionMacro (<< "every slice of the series is constant");
+    }
+
+    unsigned int last = numberOfSlices-1;
+    while (last > first
+           && this->IsEmptySlice (last, io, buffer.GetPointer()))
+      last--;
+
+    m_FirstSlice = first;
+    m_LastSlice  = last;
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::EstimateRescaling (void)
+  {
+    m_RescaleRange[0] = m_InputRange[0];
+    m_RescaleRange[1] = m_InputRange[1];
+
+    if (m_RescaleMode==PercentileRescale || m_InputRange[0]>=m_InputRange[1])
+    {
+      // up to 32 evenly spaced slices, keeping at most 2^20 values in total
+      ImageIOBase::Pointer io;
+      std::vector<float>   slice (m_SliceInformation.GetNumberOfPixels());
+      std::vector<float>   samples;
+      SliceBufferPool::ScopedBuffer buffer (m_BufferPool, m_SliceInformation.GetSizeInBytes());
+
+      const unsigned int numberOfSlices  = m_LastSlice - m_FirstSlice + 1;
+      const unsigned int numberOfSamples = std::min (32u, numberOfSlices);
+      const size_t stride = std::max<size_t> (1, slice.size() * numberOfSamples >> 20);
+
+      for (unsigned int n=0; n<numberOfSamples; n++)
+      {
+        const unsigned int i = m_FirstSlice +
+          (numberOfSamples>1 ? n * (numberOfSlices-1) / (numberOfSamples-1) : 0);
+        try
+        {
+          ConvertSliceComponents (this->ReadSlice (i, io, buffer.GetPointer()), m_SliceInformation.ComponentType,
+                                  m_SliceInformation.NumberOfComponents, &slice[0], slice.size());
+        }
+        catch (ExceptionObject &)
+        {
+          if (!m_TolerateFailures)
+            throw;
+          io = 0;
+          continue;
+        }
+        for (size_t k=0; k<slice.size(); k+=stride)
+          samples.push_back (slice[k]);
+      }
+      if (samples.empty())
+      {
+        itkExceptionMacro (<< "none of the sampled slices could be decoded");
+      }
+
+      const double percentiles[2] = { m_RescaleMode==PercentileRescale ? m_Percentiles[0] : 0.0,
+                                      m_RescaleMode==PercentileRescale ? m_Percentiles[1] : 100.0 };
+      for (int k=0; k<2; k++)
+      {
+        size_t n = static_cast<size_t>(percentiles[k] / 100.0 * (samples.size()-1) + 0.5);
+        std::nth_element (samples.begin(), samples.begin()+n, samples.end());
+        m_RescaleRange[k] = samples[n];
+      }
+    }
+
+    // integer outputs use their full range, float outputs [0, 1]
+    double outputRange[2] = { 0.0, 1.0 };
+    if (NumericTraits<PixelType>::is_integer)
+    {
+      outputRange[0] = NumericTraits<PixelType>::NonpositiveMin();
+      outputRange[1] = NumericTraits<PixelType>::max();
+    }
+    const double scale = m_RescaleRange[1]>m_RescaleRange[0] ?
+      (outputRange[1]-outputRange[0]) / (m_RescaleRange[1]-m_RescaleRange[0]) : 1.0;
+    m_Scale = static_cast<float>(scale);
+    m_Shift = static_cast<float>(outputRange[0] - m_RescaleRange[0] * scale);
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::GenerateOutputInformation (void)
+  {
+    this->ReadFirstSliceInformation();
+
+    const unsigned int sliceDimension = m_SliceInformation.GetNumberOfDimensions();
+    const unsigned int axis = OutputImageDimension-1;
+    if (sliceDimension > axis)
+    {
+      itkExceptionMacro (<< "slices of dimension " << sliceDimension
+                         << " cannot be stacked in an image of dimension " << OutputImageDimension);
+    }
+    if (m_RescaleMode==LookupTableRescale && m_LookupTable.empty())
+    {
+      itkExceptionMacro (<< "the lookup table is empty");
+    }
+    if (m_ComputeProjections && (OutputImageDimension!=3 || m_SliceInformation.NumberOfComponents!=1))
+    {
+      itkExceptionMacro (<< "projections are only computed for 3D scalar outputs");
+    }
+
+    m_FirstSlice = 0;
+    m_LastSlice  = m_Slices.size()-1;
+    if (m_CropEmptySlices)
+      this->FindNonEmptySlices();
+
+    if (m_RescaleMode==LinearRescale || m_RescaleMode==PercentileRescale)
+      this->EstimateRescaling();
+
+    typename OutputImageType::SizeType  size;
+    typename OutputImageType::IndexType index;
+    SpacingType   spacing;
+    PointType     origin;
+    DirectionType direction;
+    index.Fill (0);
+    direction.SetIdentity();
+
+    for (unsigned int i=0; i<OutputImageDimension; i++)
+    {
+      if (i<sliceDimension)
+      {
+        size[i]    = m_SliceInformation.Size[i];
+        spacing[i] = m_SliceInformation.Spacing[i];
+        origin[i]  = m_SliceInformation.Origin[i];
+        for (unsigned int j=0; j<m_SliceInformation.Direction[i].size() && j<OutputImageDimension; j++)
+          direction[j][i] = m_SliceInformation.Direction[i][j];
+      }
+      else
+      {
+        size[i]    = 1;
+        spacing[i] = 1.0;
+        origin[i]  = 0.0;
+      }
+      if (m_OverrideSpacing[i])
+        spacing[i] = m_Spacing[i];
+    }
+
+    // the first kept slice sits m_FirstSlice slices away from the first
+    // one, unless the slice positions place it
+    size[axis] = m_LastSlice - m_FirstSlice + 1;
+    if (!this->PlaceSlices (spacing[axis], origin, direction))
+      origin[axis] += m_FirstSlice * spacing[axis];
+
+    OutputImageRegionType region;
+    region.SetSize (size);
+    region.SetIndex (index);
+
+    OutputImageType *output = this->GetOutput();
+    output->SetLargestPossibleRegion (region);
+    output->SetSpacing (spacing);
+    output->SetOrigin (origin);
+    output->SetDirection (direction);
+
+    m_SliceFailures.clear();
+
+    // a regenerated output restarts the projections
+    if (m_ComputeProjections)
+    {
+      const PixelType lowest = NumericTraits<PixelType>::NonpositiveMin();
+      m_Projections[0].assign (size[1] * size[axis], lowest);
+      m_Projections[1].assign (size[0] * size[axis], lowest);
+      m_Projections[2].assign (size[0] * size[1], lowest);
+      m_MiddleSlice.assign (size[0] * size[1], lowest);
+    }
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::EnlargeOutputRequestedRegion (DataObject *data)
+  {
+    // slices are decoded whole: only the stacking dimension may be cropped
+    OutputImageType *output = dynamic_cast<OutputImageType*>(data);
+    if (!output)
+      return;
+
+    const OutputImageRegionType &largest = output->GetLargestPossibleRegion();
+    OutputImageRegionType region = output->GetRequestedRegion();
+    typename OutputImageType::SizeType  size  = region.GetSize();
+    typename OutputImageType::IndexType index = region.GetIndex();
+    for (unsigned int i=0; i<OutputImageDimension-1; i++)
+    {
+      size[i]  = largest.GetSize (i);
+      index[i] = largest.GetIndex (i);
+    }
+    region.SetSize (size);
+    region.SetIndex (index);
+    output->SetRequestedRegion (region);
+  }
+
+
+  template <class TOutputImage>
+  int
+  SeriesToVolumeAssembler<TOutputImage>::SplitRequestedRegion (int i, int num, OutputImageRegionType &splitRegion)
+  {
+    // threads get slabs of whole slices
+    const unsigned int axis = OutputImageDimension-1;
+    const OutputImageRegionType &requested = this->GetOutput()->GetRequestedRegion();
+    const long range = requested.GetSize (axis);
+    const long chunk = (range + num - 1) / num;
+    const int  used  = static_cast<int>((range + chunk - 1) / chunk);
+
+    typename OutputImageType::SizeType  size  = requested.GetSize();
+    typename OutputImageType::IndexType index = requested.GetIndex();
+    if (i < used)
+    {
+      index[axis] += i * chunk;
+      size[axis]   = std::min (chunk, range - i * chunk);
+    }
+    splitRegion.SetSize (size);
+    splitRegion.SetIndex (index);
+    return used;
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::BeforeThreadedGenerateData (void)
+  {
+    // a previous update may have thrown before giving its buffers back
+    this->ReleaseThreadBuffers();
+
+    // file slices already in the output pixel type need no conversion
+    m_DecodeIntoOutput = !m_HasSliceBuffers && m_RescaleMode==NoRescale
+      && m_SliceInformation.NumberOfComponents==1
+      && m_SliceInformation.ComponentType==GetIOComponentType<PixelType>();
+
+    const unsigned int numberOfThreads = this->GetNumberOfThreads();
+    const size_t sliceBytes = m_SliceInformation.GetSizeInBytes();
+    const size_t floatBytes = m_SliceInformation.GetNumberOfPixels() * sizeof(float);
+    m_ThreadImageIOs.resize (numberOfThreads);
+    m_ThreadSeconds.assign (numberOfThreads, 0.0);
+    m_ThreadBytes.assign (numberOfThreads, 0);
+    m_ThreadBuffers.assign (numberOfThreads, static_cast<void*>(0));
+    m_ThreadFloatBuffers.assign (numberOfThreads, static_cast<float*>(0));
+    m_ThreadResampleBuffers.assign (numberOfThreads, static_cast<PixelType*>(0));
+    m_ThreadProjections.assign (numberOfThreads, static_cast<PixelType*>(0));
+    m_ThreadFailures.resize (numberOfThreads);
+    for (unsigned int i=0; i<numberOfThreads; i++)
+    {
+      if (!m_DecodeIntoOutput && !m_HasSliceBuffers)
+        m_ThreadBuffers[i] = m_BufferPool->Acquire (sliceBytes);
+      if (m_RescaleMode!=NoRescale)
+        m_ThreadFloatBuffers[i] = static_cast<float*>(m_BufferPool->Acquire (floatBytes));
+      if (!m_ResampleLower.empty())
+      {
+        const size_t pixels = m_SliceInformation.GetNumberOfPixels();
+        m_ThreadResampleBuffers[i] = static_cast<PixelType*>(m_BufferPool->Acquire (2 * pixels * sizeof(PixelType)));
+      }
+      if (m_ComputeProjections)
+      {
+        const size_t pixels = m_Projections[2].size();
+        m_ThreadProjections[i] = static_cast<PixelType*>(m_BufferPool->Acquire (pixels * sizeof(PixelType)));
+        std::fill (m_ThreadProjections[i], m_ThreadProjections[i] + pixels, NumericTraits<PixelType>::NonpositiveMin());
+      }
+    }
+
+    // slabs of a streamed write fill their own part of the hashes
+    if (m_ComputeSliceHashes)
+      m_SliceHashes.resize (this->GetOutput()->GetLargestPossibleRegion().GetSize (OutputImageDimension-1));
+
+    m_NumberOfNumaNodes = m_NumaPlacement ? GetNumberOfNumaNodes() : 1;
+    if (m_NumaNodeStatistics.size()!=m_NumberOfNumaNodes)
+    {
+      NumaNodeStatistics zero = { 0, 0.0 };
+      m_NumaNodeStatistics.assign (m_NumberOfNumaNodes, zero);
+    }
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::AfterThreadedGenerateData (void)
+  {
+    for (unsigned int i=0; i<m_ThreadProjections.size(); i++)
+      if (m_ThreadProjections[i])
+        MaxBuffer (m_ThreadProjections[i], &m_Projections[2][0], m_Projections[2].size());
+
+    this->ReleaseThreadBuffers();
+
+    // slabs written again by a later pass fail again: keep one record per slice
+    for (unsigned int i=0; i<m_ThreadFailures.size(); i++)
+    {
+      m_SliceFailures.insert (m_SliceFailures.end(), m_ThreadFailures[i].begin(), m_ThreadFailures[i].end());
+      m_ThreadFailures[i].clear();
+    }
+    std::sort (m_SliceFailures.begin(), m_SliceFailures.end(), SliceFailureLess());
+    m_SliceFailures.erase (std::unique (m_SliceFailures.begin(), m_SliceFailures.end(), SliceFailureEqual()),
+                           m_SliceFailures.end());
+
+    // the nodes work in parallel: a node takes as long as its slowest thread
+    const unsigned int numberOfThreads = m_ThreadSeconds.size();
+    std::vector<double> seconds (m_NumberOfNumaNodes, 0.0);
+    for (unsigned int i=0; i<numberOfThreads; i++)
+    {
+      const unsigned int node = i * m_NumberOfNumaNodes / numberOfThreads;
+      seconds[node] = std::max (seconds[node], m_ThreadSeconds[i]);
+      m_NumaNodeStatistics[node].Bytes += m_ThreadBytes[i];
+    }
+    for (unsigned int n=0; n<m_NumberOfNumaNodes; n++)
+      m_NumaNodeStatistics[n].Seconds += seconds[n];
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::ReleaseThreadBuffers (void)
+  {
+    for (unsigned int i=0; i<m_ThreadBuffers.size(); i++)
+      m_BufferPool->Release (m_ThreadBuffers[i]);
+    for (unsigned int i=0; i<m_ThreadFloatBuffers.size(); i++)
+      m_BufferPool->Release (m_ThreadFloatBuffers[i]);
+    for (unsigned int i=0; i<m_ThreadResampleBuffers.size(); i++)
+      m_BufferPool->Release (m_ThreadResampleBuffers[i]);
+    for (unsigned int i=0; i<m_ThreadProjections.size(); i++)
+      m_BufferPool->Release (m_ThreadProjections[i]);
+    m_ThreadBuffers.clear();
+    m_ThreadFloatBuffers.clear();
+    m_ThreadResampleBuffers.clear();
+    m_ThreadProjections.clear();
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::AccumulateProjections (const PixelType *slice, long z, int threadId)
+  {
+    const typename OutputImageType::SizeType &size = this->GetOutput()->GetLargestPossibleRegion().GetSize();
+    const size_t width  = size[0];
+    const size_t height = size[1];
+
+    // the slice maximum rows of XZ and YZ belong to this slice only
+    PixelType *xz = &m_Projections[1][z * width];
+    PixelType *yz = &m_Projections[0][z * height];
+    MaxBuffer (slice, m_ThreadProjections[threadId], width * height);
+    for (size_t y=0; y<height; y++)
+    {
+      const PixelType *row = slice + y * width;
+      MaxBuffer (row, xz, width);
+      yz[y] = MaxValue (row, width);
+    }
+
+    if (static_cast<unsigned long>(z)==size[OutputImageDimension-1]/2)
+      std::copy (slice, slice + width * height, m_MiddleSlice.begin());
+  }
+
+
+  template <class TOutputImage>
+  typename SeriesToVolumeAssembler<TOutputImage>::ProjectionImageType::Pointer
+  SeriesToVolumeAssembler<TOutputImage>::MakeProjectionImage (const std::vector<PixelType> &pixels,
+                                                              unsigned int width) const
+  {
+    typename ProjectionImageType::RegionType region;
+    typename ProjectionImageType::SizeType size;
+    typename ProjectionImageType::IndexType index;
+    size[0] = width;
+    size[1] = width ? pixels.size() / width : 0;
+    index.Fill (0);
+    region.SetSize (size);
+    region.SetIndex (index);
+
+    typename ProjectionImageType::Pointer image = ProjectionImageType::New();
+    image->SetRegions (region);
+    image->Allocate();
+    std::copy (pixels.begin(), pixels.end(), image->GetBufferPointer());
+    return image;
+  }
+
+
+  template <class TOutputImage>
+  typename SeriesToVolumeAssembler<TOutputImage>::ProjectionImageType::Pointer
+  SeriesToVolumeAssembler<TOutputImage>::GetProjection (unsigned int axis) const
+  {
+    if (!m_ComputeProjections || axis>2)
+    {
+      itkExceptionMacro (<< "no projection along axis " << axis);
+    }
+    const typename OutputImageType::SizeType &size =
+      const_cast<Self*>(this)->GetOutput()->GetLargestPossibleRegion().GetSize();
+    return this->MakeProjectionImage (m_Projections[axis], axis==0 ? size[1] : size[0]);
+  }
+
+
+  template <class TOutputImage>
+  typename SeriesToVolumeAssembler<TOutputImage>::ProjectionImageType::Pointer
+  SeriesToVolumeAssembler<TOutputImage>::GetMiddleSlice (void) const
+  {
+    if (!m_ComputeProjections)
+    {
+      itkExceptionMacro (<< "projections were not computed");
+    }
+    const typename OutputImageType::SizeType &size =
+      const_cast<Self*>(this)->GetOutput()->GetLargestPossibleRegion().GetSize();
+    return this->MakeProjectionImage (m_MiddleSlice, size[0]);
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::DecodeSlice (unsigned int slice, ImageIOBase::Pointer &io,
+                                                      void *buffer, float *floats, PixelType *out) const
+  {
+    const size_t pixelsPerSlice = m_SliceInformation.GetNumberOfPixels();
+
+    if (m_DecodeIntoOutput)
+    {
+      this->ReadSlice (slice, io, out);
+      return;
+    }
+
+    const void *in = this->ReadSlice (slice, io, buffer);
+    if (m_RescaleMode==NoRescale)
+    {
+      ConvertSliceComponents (in, m_SliceInformation.ComponentType,
+                              m_SliceInformation.NumberOfComponents, out, pixelsPerSlice);
+      return;
+    }
+
+    ConvertSliceComponents (in, m_SliceInformation.ComponentType,
+                            m_SliceInformation.NumberOfComponents, floats, pixelsPerSlice);
+    if (m_RescaleMode==LookupTableRescale)
+    {
+      LookupBuffer (floats, out, pixelsPerSlice, &m_LookupTable[0], m_LookupTable.size(),
+                    static_cast<float>(m_LookupTableOffset));
+    }
+    else
+    {
+      const float lo = static_cast<float>(NumericTraits<PixelType>::NonpositiveMin());
+      const float hi = static_cast<float>(NumericTraits<PixelType>::max());
+      RescaleBuffer (floats, out, pixelsPerSlice, m_Scale, m_Shift, lo, hi);
+    }
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::FillFailedSlice (unsigned int slice, const char *description,
+                                                          ImageIOBase::Pointer &io, void *buffer,
+                                                          float *floats, PixelType *out, int threadId)
+  {
+    // the reader may have been left in any state
+    io = 0;
+
+    SliceFailure failure;
+    failure.Slice        = slice;
+    failure.FileName     = m_Slices[slice].FileName;
+    failure.Description  = description;
+    failure.Interpolated = m_FailureFill==InterpolateFill
+      && this->InterpolateSlice (slice, io, buffer, floats, out);
+    if (!failure.Interpolated)
+      std::fill (out, out + m_SliceInformation.GetNumberOfPixels(), static_cast<PixelType>(m_FillValue));
+
+    m_ThreadFailures[threadId].push_back (failure);
+  }
+
+
+  template <class TOutputImage>
+  bool
+  SeriesToVolumeAssembler<TOutputImage>::InterpolateSlice (unsigned int slice, ImageIOBase::Pointer &io,
+                                                           void *buffer, float *floats, PixelType *out) const
+  {
+    // nearest readable slices at most MaxGap away on each side, decoded
+    // again here since they may belong to another slab or thread
+    const long MaxGap = 4;
+    const size_t pixelsPerSlice = m_SliceInformation.GetNumberOfPixels();
+    SliceBufferPool::ScopedBuffer scratch (m_BufferPool, pixelsPerSlice * sizeof(PixelType));
+    PixelType *next = static_cast<PixelType*>(scratch.GetPointer());
+
+    long lower = -1, upper = -1;
+    for (long s=static_cast<long>(slice)-1; s>=0 && s>=static_cast<long>(slice)-MaxGap && lower<0; s--)
+    {
+      try
+      {
+        this->DecodeSlice (s, io, buffer, floats, out);
+        lower = s;
+      }
+      catch (ExceptionObject &)
+      {
+        io = 0;
+      }
+    }
+    for (long s=slice+1; s<static_cast<long>(m_Slices.size()) && s<=static_cast<long>(slice)+MaxGap && upper<0; s++)
+    {
+      try
+      {
+        this->DecodeSlice (s, io, buffer, floats, next);
+        upper = s;
+      }
+      catch (ExceptionObject &)
+      {
+        io = 0;
+      }
+    }
+
+    if (lower<0 && upper<0)
+      return false;
+    if (lower<0)
+      std::copy (next, next + pixelsPerSlice, out);
+    if (lower<0 || upper<0)
+      return true;
+
+    BlendSlices (out, next, static_cast<double>(slice - lower) / (upper - lower), out, pixelsPerSlice);
+    return true;
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::DecodeOrFillSlice (unsigned int slice, ImageIOBase::Pointer &io,
+                                                            void *buffer, float *floats, PixelType *out,
+                                                            int threadId)
+  {
+    if (!m_TolerateFailures)
+    {
+      this->DecodeSlice (slice, io, buffer, floats, out);
+      return;
+    }
+    try
+    {
+      this->DecodeSlice (slice, io, buffer, floats, out);
+    }
+    catch (ExceptionObject &e)
+    {
+      this->FillFailedSlice (slice, e.GetDescription(), io, buffer, floats, out, threadId);
+    }
+    catch (std::exception &e)
+    {
+      this->FillFailedSlice (slice, e.what(), io, buffer, floats, out, threadId);
+    }
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::ResampleSlice (long z, ImageIOBase::Pointer &io, void *buffer,
+                                                        float *floats, PixelType *out, long cached[2],
+                                                        int threadId)
+  {
+    const unsigned int lower = m_ResampleLower[z];
+    const double       w     = m_ResampleWeight[z];
+    if (w==0.0)
+    {
+      this->DecodeOrFillSlice (lower, io, buffer, floats, out, threadId);
+      return;
+    }
+
+    // consecutive output slices mostly share their input slices: the
+    // thread keeps the last two decoded
+    const size_t pixelsPerSlice = m_SliceInformation.GetNumberOfPixels();
+    PixelType *slots[2] = { m_ThreadResampleBuffers[threadId],
+                            m_ThreadResampleBuffers[threadId] + pixelsPerSlice };
+    const PixelType *neighbours[2];
+    for (unsigned int k=0; k<2; k++)
+    {
+      const long slice = lower + k;
+      if (cached[0]==slice || cached[1]==slice)
+      {
+        neighbours[k] = slots[cached[0]==slice ? 0 : 1];
+        continue;
+      }
+      // keep the other neighbour if it is cached
+      const long other = lower + 1 - k;
+      const unsigned int slot = cached[0]==other ? 1 : 0;
+      cached[slot] = -1;
+      this->DecodeOrFillSlice (slice, io, buffer, floats, slots[slot], threadId);
+      cached[slot] = slice;
+      neighbours[k] = slots[slot];
+    }
+    BlendSlices (neighbours[0], neighbours[1], w, out, pixelsPerSlice);
+  }
+
+
+  template <class TOutputImage>
+  ITK_THREAD_RETURN_TYPE
+  SeriesToVolumeAssembler<TOutputImage>::ScanSlicePositionsThread (void *arg)
+  {
+    MultiThreader::ThreadInfoStruct *info = static_cast<MultiThreader::ThreadInfoStruct*>(arg);
+    Self *self = static_cast<Self*>(info->UserData);
+
+    const unsigned int numberOfSlices = self->m_Slices.size();
+    const unsigned int chunk = (numberOfSlices + info->NumberOfThreads - 1) / info->NumberOfThreads;
+    const unsigned int first = info->ThreadID * chunk;
+    const unsigned int sliceDimension = self->m_SliceInformation.GetNumberOfDimensions();
+    ImageIOBase::Pointer io;
+    for (unsigned int s=first; s<first+chunk && s<numberOfSlices; s++)
+    {
+      // headers that cannot be read leave the position unknown: decoding
+      // the slice reports the failure
+      const char *filename = self->m_Slices[s].FileName.c_str();
+      try
+      {
+        if (io.IsNull() || !io->CanReadFile (filename))
+          io = ImageIOFactory::CreateImageIO (filename, ImageIOFactory::ReadMode);
+        if (io.IsNull())
+          continue;
+        io->SetFileName (filename);
+        io->ReadImageInformation();
+        ReadSlicePosition (io, sliceDimension, self->m_SlicePositions[s]);
+      }
+      catch (ExceptionObject &)
+      {
+        io = 0;
+      }
+    }
+    return ITK_THREAD_RETURN_VALUE;
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::ScanSlicePositions (void)
+  {
+    // only slice files have headers worth scanning: raw and PGM slices
+    // have no position, and archive members would have to be extracted
+    m_SlicePositions.assign (m_Slices.size(), std::vector<double>());
+    if (m_HasSliceBuffers || m_Archive || CanReadCompressedSlice (m_Slices[0].FileName))
+      return;
+
+    MultiThreader::Pointer threader = MultiThreader::New();
+    threader->SetNumberOfThreads (std::min<int> (this->GetNumberOfThreads(), m_Slices.size()));
+    threader->SetSingleMethod (ScanSlicePositionsThread, this);
+    threader->SingleMethodExecute();
+  }
+
+
+  template <class TOutputImage>
+  bool
+  SeriesToVolumeAssembler<TOutputImage>::PlaceSlices (double &spacing, PointType &origin,
+                                                      DirectionType &direction)
+  {
+    m_SlicePositionsFound = false;
+    m_UniformSpacing = true;
+    m_SliceGapRange[0] = m_SliceGapRange[1] = spacing;
+    m_ResampleLower.clear();
+    m_ResampleWeight.clear();
+
+    const unsigned int axis = OutputImageDimension-1;
+    if (!m_SpacingFromPositions || m_OverrideSpacing[axis] || m_LastSlice==m_FirstSlice)
+      return false;
+    this->ScanSlicePositions();
+
+    // stacking direction from the first to the last known kept positions
+    long f = m_FirstSlice, l = m_LastSlice;
+    while (f<=l && m_SlicePositions[f].empty())
+      f++;
+    while (l>f && m_SlicePositions[l].empty())
+      l--;
+    if (l<=f)
+      return false;
+    const std::vector<double> &pf = m_SlicePositions[f];
+    const std::vector<double> &pl = m_SlicePositions[l];
+    const unsigned int components = std::min (pf.size(), pl.size());
+    std::vector<double> normal (components);
+    double length = 0.0;
+    for (unsigned int i=0; i<components; i++)
+    {
+      normal[i] = pl[i] - pf[i];
+      length += normal[i] * normal[i];
+    }
+    length = std::sqrt (length);
+    if (length < 1e-6)
+      return false;
+    for (unsigned int i=0; i<components; i++)
+      normal[i] /= length;
+
+    // distance of each kept slice along the normal, interpolated between
+    // the known positions and extrapolated at both ends
+    const unsigned int n = m_LastSlice - m_FirstSlice + 1;
+    const double meanKnownGap = length / (l - f);
+    std::vector<double> t (n, 0.0);
+    std::vector<bool> known (n, false);
+    for (unsigned int k=0; k<n; k++)
+    {
+      const std::vector<double> &p = m_SlicePositions[m_FirstSlice + k];
+      if (p.size() < components)
+        continue;
+      for (unsigned int i=0; i<components; i++)
+        t[k] += (p[i] - pf[i]) * normal[i];
+      known[k] = true;
+    }
+    long previous = -1;
+    for (long k=0; k<static_cast<long>(n); k++)
+    {
+      if (!known[k])
+        continue;
+      for (long u=previous+1; u<k; u++)
+        t[u] = previous<0 ? t[k] - (k - u) * meanKnownGap
+                          : t[previous] + (t[k] - t[previous]) * (u - previous) / (k - previous);
+      previous = k;
+    }
+    for (long u=previous+1; u<static_cast<long>(n); u++)
+      t[u] = t[previous] + (u - previous) * meanKnownGap;
+
+    spacing = (t[n-1] - t[0]) / (n - 1);
+    m_SliceGapRange[0] = m_SliceGapRange[1] = t[1] - t[0];
+    for (unsigned int k=1; k+1<n; k++)
+    {
+      m_SliceGapRange[0] = std::min (m_SliceGapRange[0], t[k+1] - t[k]);
+      m_SliceGapRange[1] = std::max (m_SliceGapRange[1], t[k+1] - t[k]);
+    }
+    m_SlicePositionsFound = true;
+    m_UniformSpacing = m_SliceGapRange[1] - m_SliceGapRange[0] <= 0.01 * spacing;
+
+    if (!m_UniformSpacing && m_ResampleNonUniformSpacing)
+    {
+      if (m_SliceGapRange[0] <= 0.0)
+      {
+        itkExceptionMacro (<< "the slices are not sorted by position: they cannot be resampled");
+      }
+      m_ResampleLower.resize (n);
+      m_ResampleWeight.resize (n);
+      unsigned int k = 0;
+      for (unsigned int z=0; z<n; z++)
+      {
+        const double target = t[0] + z * spacing;
+        while (k+2<n && t[k+1]<=target)
+          k++;
+        const double w = std::min (1.0, std::max (0.0, (target - t[k]) / (t[k+1] - t[k])));
+        m_ResampleLower[z]  = m_FirstSlice + (w==1.0 ? k+1 : k);
+        m_ResampleWeight[z] = w==1.0 ? 0.0 : w;
+      }
+    }
+
+    // positions with every output component place the stack in space
+    if (components < OutputImageDimension)
+      return false;
+    for (unsigned int i=0; i<OutputImageDimension; i++)
+    {
+      origin[i] = pf[i] + t[0] * normal[i];
+      direction[i][axis] = normal[i];
+    }
+    return true;
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::ThreadedGenerateData (const OutputImageRegionType &outputRegionForThread,
+                                                               int threadId)
+  {
+    OutputImageType *output = this->GetOutput();
+    const OutputImageRegionType &buffered = output->GetBufferedRegion();
+
+    const unsigned int axis = OutputImageDimension-1;
+    const size_t pixelsPerSlice = m_SliceInformation.GetNumberOfPixels();
+    const long   first = outputRegionForThread.GetIndex (axis);
+    const long   end   = first + static_cast<long>(outputRegionForThread.GetSize (axis));
+
+    ImageIOBase::Pointer &io     = m_ThreadImageIOs[threadId];
+    void                 *buffer = m_ThreadBuffers[threadId];
+    float                *floats = m_ThreadFloatBuffers[threadId];
+
+    // consecutive threads, hence consecutive slabs, share a node
+    const unsigned int node = threadId * m_NumberOfNumaNodes / this->GetNumberOfThreads();
+    std::vector<int> affinity;
+    if (m_NumaPlacement)
+      BindThreadToNumaNode (node, affinity);
+    const double start = itksys::SystemTools::GetTime();
+
+    ProgressReporter progress (this, threadId, end - first);
+    long cached[2] = { -1, -1 };
+
+    try
+    {
+      for (long z=first; z<end; z++)
+      {
+        PixelType *out = output->GetBufferPointer() + (z - buffered.GetIndex (axis)) * pixelsPerSlice;
+
+        if (m_ResampleLower.empty())
+          this->DecodeOrFillSlice (m_FirstSlice + z, io, buffer, floats, out, threadId);
+        else
+          this->ResampleSlice (z, io, buffer, floats, out, cached, threadId);
+
+        // hashed and projected while the slice is still in cache
+        if (m_ComputeSliceHashes)
+          m_SliceHashes[z] = HashBuffer (out, pixelsPerSlice * sizeof(PixelType));
+        if (m_ComputeProjections)
+          this->AccumulateProjections (out, z, threadId);
+
+        progress.CompletedPixel();
+      }
+    }
+    catch (...)
+    {
+      RestoreThreadAffinity (affinity);
+      throw;
+    }
+    RestoreThreadAffinity (affinity);
+
+    m_ThreadSeconds[threadId] = itksys::SystemTools::GetTime() - start;
+    m_ThreadBytes[threadId]   = static_cast<unsigned long long>(end - first) * pixelsPerSlice * sizeof(PixelType);
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::PlanWrite (const std::string &filename)
+  {
+    // the plan is made before cropping, on the whole series
+    this->ReadFirstSliceInformation();
+    const unsigned long long threadBytes = m_RescaleMode==NoRescale ? 0 :
+      static_cast<unsigned long long>(m_SliceInformation.GetNumberOfPixels()) * sizeof(float);
+    PlanMemory (m_SliceInformation, m_Slices.size(), sizeof(PixelType), threadBytes,
+                filename.c_str(), m_MaxMemory, m_MemoryPlan);
+    if (m_MaxMemory && static_cast<unsigned int>(this->GetNumberOfThreads())!=m_MemoryPlan.NumberOfThreads)
+      this->SetNumberOfThreads (m_MemoryPlan.NumberOfThreads);
+    m_PlannedFileName = filename;
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::Write (const std::string &filename)
+  {
+    if (m_PlannedFileName!=filename)
+      this->PlanWrite (filename);
+    m_PlannedFileName.clear();
+
+    typedef ImageFileWriter<OutputImageType> WriterType;
+    typename WriterType::Pointer writer = WriterType::New();
+    writer->SetFileName ( filename.c_str() );
+    writer->SetInput ( this->GetOutput() );
+    writer->SetNumberOfStreamDivisions ( m_MemoryPlan.NumberOfStreamDivisions );
+    if (m_ImageIO)
+      writer->SetImageIO ( m_ImageIO );
+    if (!m_MemoryPlan.UseCompression)
+      writer->UseCompressionOff();
+    m_NumaNodeStatistics.clear();
+    writer->Update();
+  }
+
+
+  template <class TOutputImage>
+  void
+  SeriesToVolumeAssembler<TOutputImage>::PrintSelf (std::ostream &os, Indent indent) const
+  {
+    Superclass::PrintSelf (os, indent);
+    os << indent << "NumberOfSlices: " << m_Slices.size() << std::endl;
+    os << indent << "Archive: " << (m_Archive ? m_Archive->GetFileName() : std::string ("none")) << std::endl;
+    os << indent << "SpacingFromPositions: " << m_SpacingFromPositions << std::endl;
+    os << indent << "ResampleNonUniformSpacing: " << m_ResampleNonUniformSpacing << std::endl;
+    os << indent << "SlicePositionsFound: " << m_SlicePositionsFound << std::endl;
+    os << indent << "UniformSpacing: " << m_UniformSpacing << std::endl;
+    os << indent << "SliceGapRange: " << m_SliceGapRange[0] << " " << m_SliceGapRange[1] << std::endl;
+    os << indent << "CropEmptySlices: " << m_CropEmptySlices << std::endl;
+    os << indent << "FirstSlice: " << m_FirstSlice << std::endl;
+    os << indent << "LastSlice: " << m_LastSlice << std::endl;
+    os << indent << "RescaleMode: " << m_RescaleMode << std::endl;
+    os << indent << "RescaleRange: " << m_RescaleRange[0] << " " << m_RescaleRange[1] << std::endl;
+    os << indent << "LookupTable size: " << m_LookupTable.size() << std::endl;
+    os << indent << "MaxMemory: " << m_MaxMemory << std::endl;
+    os << indent << "NumaPlacement: " << m_NumaPlacement << std::endl;
+    os << indent << "ComputeSliceHashes: " << m_ComputeSliceHashes << std::endl;
+    os << indent << "ComputeProjections: " << m_ComputeProjections << std::endl;
+    os << indent << "TolerateFailures: " << m_TolerateFailures << std::endl;
+    os << indent << "FailureFill: " << m_FailureFill << std::endl;
+    os << indent << "FillValue: " << m_FillValue << std::endl;
+  }
+
+} // end of namespace
+
+#endif
@@ -0,0 +1,363 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkSeriesToVolumeUtilities.h"
+#include "itkImageIOFactory.h"
+#include "itkMacro.h"
+#include "itkMultiThreader.h"
+
+#include <itksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace itk
+{
+
+  SliceInformation::SliceInformation()
+  {
+    ComponentType = ImageIOBase::UNKNOWNCOMPONENTTYPE;
+    NumberOfComponents = 1;
+  }
+
+
+  unsigned int SliceInformation::GetNumberOfDimensions (void) const
+  {
+    return Size.size();
+  }
+
+
+  unsigned long SliceInformation::GetNumberOfPixels (void) const
+  {
+    unsigned long n = Size.empty() ? 0 : 1;
+    for (unsigned int i=0; i<Size.size(); i++)
+      n *= Size[i];
+    return n;
+  }
+
+
+  unsigned int SliceInformation::GetPixelSize (void) const
+  {
+    return GetComponentSize (ComponentType) * NumberOfComponents;
+  }
+
+
+  unsigned long SliceInformation::GetSizeInBytes (void) const
+  {
+    return GetNumberOfPixels() * GetPixelSize();
+  }
+
+
+  bool SliceInformation::IsCompatibleWith (const SliceInformation &other) const
+  {
+    return ComponentType==other.ComponentType
+      && NumberOfComponents==other.NumberOfComponents
+      && Size==other.Size;
+  }
+
+
+  bool SliceInformation::IsCompatibleWith (const ImageIOBase *io) const
+  {
+    if (ComponentType!=io->GetComponentType()
+        || NumberOfComponents!=io->GetNumberOfComponents()
+        || Size.size()>io->GetNumberOfDimensions())
+      return false;
+    for (unsigned int i=0; i<io->GetNumberOfDimensions(); i++)
+      if ((i<Size.size() ? Size[i] : 1)!=io->GetDimensions (i))
+        return false;
+    return true;
+  }
+
+
+  void SliceInformation::DropSingletonDimensions (unsigned int dimension)
+  {
+    unsigned int kept = Size.size();
+    while (kept>dimension && Size[kept-1]==1)
+      kept--;
+    Size.resize (kept);
+    Spacing.resize (kept);
+    Origin.resize (kept);
+    Direction.resize (kept);
+  }
+
+
+  unsigned int GetComponentSize (ImageIOBase::IOComponentType type)
+  {
+    switch (type)
+    {
+        case ImageIOBase::UCHAR:  return sizeof(unsigned char);
+        case ImageIOBase::CHAR:   return sizeof(char);
+        case ImageIOBase::USHORT: return sizeof(unsigned short);
+        case ImageIOBase::SHORT:  return sizeof(short);
+        case ImageIOBase::UINT:   return sizeof(unsigned int);
+        case ImageIOBase::INT:    return sizeof(int);
+        case ImageIOBase::ULONG:  return sizeof(unsigned long);
+        case ImageIOBase::LONG:   return sizeof(long);
+        case ImageIOBase::FLOAT:  return sizeof(float);
+        case ImageIOBase::DOUBLE: return sizeof(double);
+        default:                  return 0;
+    }
+  }
+
+
+  void ReadSliceInformation (const ImageIOBase *io, SliceInformation &information)
+  {
+    const unsigned int dimension = io->GetNumberOfDimensions();
+
+    information.ComponentType      = io->GetComponentType();
+    information.NumberOfComponents = io->GetNumberOfComponents();
+    information.Size.resize (dimension);
+    information.Spacing.resize (dimension);
+    information.Origin.resize (dimension);
+    information.Direction.resize (dimension);
+    for (unsigned int i=0; i<dimension; i++)
+    {
+      information.Size[i]      = io->GetDimensions (i);
+      information.Spacing[i]   = io->GetSpacing (i);
+      information.Origin[i]    = io->GetOrigin (i);
+      information.Direction[i] = io->GetDirection (i);
+    }
+  }
+
+
+  bool ReadSlicePosition (const ImageIOBase *io, unsigned int dimension, std::vector<double> &position)
+  {
+    const unsigned int n = io->GetNumberOfDimensions();
+    if (n<=dimension)
+      return false;
+    position.resize (n);
+    for (unsigned int i=0; i<n; i++)
+      position[i] = io->GetOrigin (i);
+    return true;
+  }
+
+
+  unsigned long long ParseMemorySize (const std::string &s)
+  {
+    char *end = 0;
+    double value = strtod (s.c_str(), &end);
+    if (end==s.c_str() || value<=0.0)
+      return 0;
+
+    switch (*end)
+    {
+        case 'k': case 'K': value *= 1024.0; break;
+        case 'm': case 'M': value *= 1024.0*1024.0; break;
+        case 'g': case 'G': value *= 1024.0*1024.0*1024.0; break;
+        case '\0': break;
+        default: return 0;
+    }
+    return static_cast<unsigned long long>(value);
+  }
+
+
+  unsigned long long GetPeakMemoryUsage (void)
+  {
+#ifdef __linux__
+    // VmHWM, unlike ru_maxrss, follows ResetPeakMemoryUsage
+    std::ifstream status ("/proc/self/status");
+    std::string key;
+    while (status >> key)
+    {
+      if (key=="VmHWM:")
+      {
+        unsigned long long kilobytes = 0;
+        status >> kilobytes;
+        return kilobytes * 1024;
+      }
+    }
+#endif
+#ifndef WIN32
+    struct rusage usage;
+    if (getrusage (RUSAGE_SELF, &usage)!=0)
+      return 0;
+#ifdef __APPLE__
+    return static_cast<unsigned long long>(usage.ru_maxrss);
+#else
+    return static_cast<unsigned long long>(usage.ru_maxrss) * 1024;
+#endif
+#else
+    return 0;
+#endif
+  }
+
+
+  void ResetPeakMemoryUsage (void)
+  {
+#ifdef __linux__
+    std::ofstream clearRefs ("/proc/self/clear_refs");
+    clearRefs << "5";
+#endif
+  }
+
+
+  namespace
+  {
+    std::string GetNumaNodePath (unsigned int node)
+    {
+      std::ostringstream path;
+      path << "/sys/devices/system/node/node" << node;
+      return path.str();
+    }
+
+    /** Parse a kernel CPU list such as 0-7,16-23. */
+    void ParseCPUList (const std::string &list, std::vector<int> &cpus)
+    {
+      std::istringstream stream (list);
+      std::string range;
+      while (std::getline (stream, range, ','))
+      {
+        int first = 0, last = 0;
+        char dash = 0;
+        std::istringstream bounds (range);
+        if (!(bounds >> first))
+          continue;
+        if (!(bounds >> dash >> last) || dash!='-')
+          last = first;
+        for (int cpu=first; cpu<=last; cpu++)
+          cpus.push_back (cpu);
+      }
+    }
+  }
+
+
+  unsigned int GetNumberOfNumaNodes (void)
+  {
+    unsigned int nodes = 0;
+#ifdef __linux__
+    while (itksys::SystemTools::FileIsDirectory (GetNumaNodePath (nodes).c_str()))
+      nodes++;
+#endif
+    return nodes ? nodes : 1;
+  }
+
+
+  bool BindThreadToNumaNode (unsigned int node, std::vector<int> &previous)
+  {
+    previous.clear();
+#ifdef __linux__
+    std::ifstream file ((GetNumaNodePath (node) + "/cpulist").c_str());
+    std::string list;
+    std::vector<int> cpus;
+    if (!std::getline (file, list))
+      return false;
+    ParseCPUList (list, cpus);
+
+    cpu_set_t set;
+    if (sched_getaffinity (0, sizeof(set), &set)!=0)
+      return false;
+    for (int cpu=0; cpu<CPU_SETSIZE; cpu++)
+      if (CPU_ISSET (cpu, &set))
+        previous.push_back (cpu);
+
+    // stay within the CPUs we were allowed to run on
+    cpu_set_t bound;
+    CPU_ZERO (&bound);
+    bool empty = true;
+    for (unsigned int i=0; i<cpus.size(); i++)
+    {
+      if (cpus[i] < CPU_SETSIZE && CPU_ISSET (cpus[i], &set))
+      {
+        CPU_SET (cpus[i], &bound);
+        empty = false;
+      }
+    }
+    return !empty && sched_setaffinity (0, sizeof(bound), &bound)==0;
+#else
+    (void)node;
+    return false;
+#endif
+  }
+
+
+  void RestoreThreadAffinity (const std::vector<int> &cpus)
+  {
+#ifdef __linux__
+    if (cpus.empty())
+      return;
+    cpu_set_t set;
+    CPU_ZERO (&set);
+    for (unsigned int i=0; i<cpus.size(); i++)
+      CPU_SET (cpus[i], &set);
+    sched_setaffinity (0, sizeof(set), &set);
+#else
+    (void)cpus;
+#endif
+  }
+
+
+  void PlanMemory (const SliceInformation &information, unsigned int numberOfSlices,
+                   unsigned int pixelSize, unsigned long long threadBytes,
+                   const char *output, unsigned long long maxMemory, MemoryPlan &plan)
+  {
+    const unsigned long long pixelsPerSlice =
+      static_cast<unsigned long long>(information.GetNumberOfPixels());
+
+    // one decoded slice in its own type plus the thread scratch memory
+    plan.SliceBytes  = information.GetSizeInBytes() + threadBytes;
+    plan.VolumeBytes = pixelsPerSlice * pixelSize * numberOfSlices;
+    plan.NumberOfStreamDivisions = 1;
+    plan.NumberOfThreads = static_cast<unsigned int>(MultiThreader::GetGlobalDefaultNumberOfThreads());
+    plan.UseCompression = true;
+
+    if (maxMemory==0)
+      return;
+
+    const unsigned long long baseline = GetPeakMemoryUsage();
+    if (maxMemory <= baseline + plan.SliceBytes)
+    {
+      itkGenericExceptionMacro (<< "the memory budget is too small to decode a single slice");
+    }
+
+    // each thread works on its own slice
+    const unsigned long long available = maxMemory - baseline;
+    unsigned long long threads = (available / 2) / plan.SliceBytes;
+    if (threads < 1)
+      threads = 1;
+    if (threads < plan.NumberOfThreads)
+      plan.NumberOfThreads = static_cast<unsigned int>(threads);
+
+    const unsigned long long slabBudget = available - plan.NumberOfThreads * plan.SliceBytes;
+    if (plan.VolumeBytes <= slabBudget)
+      return;
+
+    unsigned long long divisions = (plan.VolumeBytes + slabBudget - 1) / slabBudget;
+    if (divisions > numberOfSlices)
+    {
+      itkGenericExceptionMacro (<< "the memory budget is too small to hold a single slab of the output");
+    }
+
+    ImageIOBase::Pointer outputIO = ImageIOFactory::CreateImageIO (output, ImageIOFactory::WriteMode);
+    if (outputIO.IsNull() || !outputIO->CanStreamWrite())
+    {
+      itkGenericExceptionMacro (<< "the output volume needs " << (plan.VolumeBytes>>20)
+                                << " MB but " << output << " cannot be written in pieces; "
+                                << "raise the memory budget or use a .vbz, or an uncompressed .mha or .nrrd output");
+    }
+
+    plan.NumberOfStreamDivisions = static_cast<unsigned int>(divisions);
+    plan.UseCompression = false;
+  }
+
+} // end of namespace
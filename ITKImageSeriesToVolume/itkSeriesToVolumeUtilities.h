@@ -0,0 +1,153 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_SeriesToVolumeUtilities_h_
+#define _itk_SeriesToVolumeUtilities_h_
+
+#include "itkImageIOBase.h"
+
+#include <string>
+#include <vector>
+
+/**
+   Non-templated helpers of the series to volume assembly: slice headers,
+   memory budget planning and memory size accounting.
+ */
+
+namespace itk
+{
+
+  /**
+     Header of one slice of a series, read from a file or given along
+     with slices decoded in memory.
+   */
+  struct SliceInformation
+  {
+    ImageIOBase::IOComponentType        ComponentType;
+    unsigned int                        NumberOfComponents;
+    std::vector<unsigned long>          Size;
+    std::vector<double>                 Spacing;
+    std::vector<double>                 Origin;
+    std::vector< std::vector<double> >  Direction;
+
+    SliceInformation();
+
+    unsigned int  GetNumberOfDimensions (void) const;
+    unsigned long GetNumberOfPixels (void) const;
+    unsigned int  GetPixelSize (void) const;
+    unsigned long GetSizeInBytes (void) const;
+
+    /** True if both slices can be stacked in the same volume. */
+    bool IsCompatibleWith (const SliceInformation &other) const;
+
+    /** Same check against the image information read by io, without
+        filling a SliceInformation. The trailing dimensions of size 1 of
+        io beyond those of the slice are ignored. */
+    bool IsCompatibleWith (const ImageIOBase *io) const;
+
+    /** Drop the trailing dimensions of size 1 beyond the first
+        dimension ones, such as the third dimension of a DICOM slice. */
+    void DropSingletonDimensions (unsigned int dimension);
+  };
+
+  /** Size in bytes of one component of the given type (0 if unknown). */
+  unsigned int GetComponentSize (ImageIOBase::IOComponentType type);
+
+  /** Component type of a scalar pixel type (UNKNOWNCOMPONENTTYPE for others). */
+  template <class TPixel> inline ImageIOBase::IOComponentType GetIOComponentType (void)
+  { return ImageIOBase::UNKNOWNCOMPONENTTYPE; }
+  template <> inline ImageIOBase::IOComponentType GetIOComponentType<unsigned char> (void)  { return ImageIOBase::UCHAR; }
+  template <> inline ImageIOBase::IOComponentType GetIOComponentType<char> (void)           { return ImageIOBase::CHAR; }
+  template <> inline ImageIOBase::IOComponentType GetIOComponentType<unsigned short> (void) { return ImageIOBase::USHORT; }
+  template <> inline ImageIOBase::IOComponentType GetIOComponentType<short> (void)          { return ImageIOBase::SHORT; }
+  template <> inline ImageIOBase::IOComponentType GetIOComponentType<unsigned int> (void)   { return ImageIOBase::UINT; }
+  template <> inline ImageIOBase::IOComponentType GetIOComponentType<int> (void)            { return ImageIOBase::INT; }
+  template <> inline ImageIOBase::IOComponentType GetIOComponentType<unsigned long> (void)  { return ImageIOBase::ULONG; }
+  template <> inline ImageIOBase::IOComponentType GetIOComponentType<long> (void)           { return ImageIOBase::LONG; }
+  template <> inline ImageIOBase::IOComponentType GetIOComponentType<float> (void)          { return ImageIOBase::FLOAT; }
+  template <> inline ImageIOBase::IOComponentType GetIOComponentType<double> (void)         { return ImageIOBase::DOUBLE; }
+
+  /** Fill information from an ImageIO whose image information was read. */
+  void ReadSliceInformation (const ImageIOBase *io, SliceInformation &information);
+
+  /** Physical position of a slice of the given dimension, known only if
+      io has more dimensions than the slice (the origin of a DICOM slice
+      read in 3D, for instance). Returns false if it is unknown. */
+  bool ReadSlicePosition (const ImageIOBase *io, unsigned int dimension, std::vector<double> &position);
+
+
+  /**
+     Parse a memory size given as a number of bytes with an optional
+     K, M or G (binary) suffix. Returns 0 if the string cannot be parsed.
+   */
+  unsigned long long ParseMemorySize (const std::string &s);
+
+  /** Peak resident set size of the process, in bytes (0 if unknown). */
+  unsigned long long GetPeakMemoryUsage (void);
+
+  /** Restart the peak resident set size from the current one, where the
+      system allows it (Linux), so that jobs run one after the other in
+      one process get their own peak. */
+  void ResetPeakMemoryUsage (void);
+
+
+  /** Number of NUMA nodes of the machine (1 where unknown). */
+  unsigned int GetNumberOfNumaNodes (void);
+
+  /** Restrict the calling thread to the CPUs of one NUMA node, so that
+      the pages it touches first are allocated on that node. The CPUs it
+      could run on are stored in previous, for RestoreThreadAffinity.
+      Returns false where thread affinity is not supported. */
+  bool BindThreadToNumaNode (unsigned int node, std::vector<int> &previous);
+  void RestoreThreadAffinity (const std::vector<int> &cpus);
+
+  /** Output written by the threads bound to one NUMA node. */
+  struct NumaNodeStatistics
+  {
+    unsigned long long Bytes;
+    double             Seconds;
+  };
+
+
+  /**
+     How a conversion is laid out to stay under the memory budget.
+   */
+  struct MemoryPlan
+  {
+    unsigned long long VolumeBytes;
+    unsigned long long SliceBytes;
+    unsigned int       NumberOfStreamDivisions;
+    unsigned int       NumberOfThreads;
+    bool               UseCompression;
+  };
+
+  /**
+     Estimate the footprint of writing numberOfSlices slices of pixelSize
+     bytes per pixel to output, each thread needing threadBytes of scratch
+     memory on top of a decoded slice, and choose the number of slabs
+     written at once, the number of threads and whether the writer may
+     compress (compressed output is always written in one piece). A
+     maxMemory of 0 means no budget. Throws if the budget cannot be
+     honoured.
+   */
+  void PlanMemory (const SliceInformation &information, unsigned int numberOfSlices,
+                   unsigned int pixelSize, unsigned long long threadBytes,
+                   const char *output, unsigned long long maxMemory, MemoryPlan &plan);
+
+} // end of namespace
+
+
+#endif
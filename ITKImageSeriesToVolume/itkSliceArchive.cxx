@@ -0,0 +1,507 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkSliceArchive.h"
+#include "itkMacro.h"
+#include "itk_zlib.h"
+
+#include <itksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef WIN32
+#include <direct.h>
+#include <io.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW 0
+#endif
+
+namespace itk
+{
+
+  namespace
+  {
+    bool WriteFully (int fd, const char *data, size_t size)
+    {
+      while (size)
+      {
+        const int n = write (fd, data, static_cast<unsigned int>(std::min<size_t> (size, 1 << 30)));
+        if (n<0 && errno==EINTR)
+          continue;
+        if (n<=0)
+          return false;
+        data += n;
+        size -= n;
+      }
+      return true;
+    }
+
+    const unsigned int TarBlockSize = 512;
+
+    /** Zip compression methods. */
+    const unsigned int Stored   = 0;
+    const unsigned int Deflated = 8;
+
+    unsigned int GetLittleEndian16 (const unsigned char *p)
+    {
+      return p[0] | (p[1] << 8);
+    }
+
+    unsigned long GetLittleEndian32 (const unsigned char *p)
+    {
+      return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<unsigned long>(p[3]) << 24);
+    }
+
+    /** Numeric field of a tar header: octal text, or base 256 when the
+        high bit of the first byte is set (GNU tar, sizes of 8GB or more). */
+    unsigned long long GetTarNumber (const char *field, unsigned int length)
+    {
+      unsigned long long value = 0;
+      if (field[0] & 0x80)
+      {
+        for (unsigned int i=0; i<length; i++)
+          value = (value << 8) | static_cast<unsigned char>(i ? field[i] : field[i] & 0x7f);
+        return value;
+      }
+      for (unsigned int i=0; i<length && field[i]; i++)
+        if (field[i]>='0' && field[i]<='7')
+          value = value * 8 + (field[i] - '0');
+      return value;
+    }
+
+    /** NUL terminated field of a tar header. */
+    std::string GetTarString (const char *field, unsigned int length)
+    {
+      return std::string (field, std::find (field, field + length, '\0'));
+    }
+
+    /** True if the checksum of the header block matches. */
+    bool IsTarHeader (const char *header)
+    {
+      unsigned long sum = 0;
+      for (unsigned int i=0; i<TarBlockSize; i++)
+        sum += i>=148 && i<156 ? ' ' : static_cast<unsigned char>(header[i]);
+      return sum==GetTarNumber (header + 148, 8);
+    }
+
+    /** Path of a pax extended header ("length path=value" records). */
+    std::string GetPaxPath (const std::string &records)
+    {
+      std::string::size_type position = 0;
+      while (position < records.size())
+      {
+        const std::string::size_type space = records.find (' ', position);
+        const unsigned long length = atol (records.c_str() + position);
+        if (space==std::string::npos || !length)
+          break;
+        const std::string record = records.substr (space + 1, position + length - space - 2);
+        if (record.compare (0, 5, "path=")==0)
+          return record.substr (5);
+        position += length;
+      }
+      return "";
+    }
+  }
+
+
+  SliceArchive::SliceArchive()
+  {
+    m_Zip = false;
+  }
+
+
+  bool SliceArchive::IsArchive (const std::string &filename)
+  {
+    const std::string extension = itksys::SystemTools::LowerCase (
+      itksys::SystemTools::GetFilenameLastExtension (filename));
+    return extension==".tar" || extension==".zip";
+  }
+
+
+  void SliceArchive::Open (const std::string &filename)
+  {
+    std::ifstream in (filename.c_str(), std::ios::binary);
+    if (!in)
+    {
+      itkExceptionMacro (<< "cannot open " << filename);
+    }
+
+    m_FileName = filename;
+    m_Members.clear();
+    m_Zip = itksys::SystemTools::LowerCase (itksys::SystemTools::GetFilenameLastExtension (filename))==".zip";
+    if (m_Zip)
+      this->ReadZipMembers (in);
+    else
+      this->ReadTarMembers (in);
+
+    std::sort (m_Members.begin(), m_Members.end());
+    this->Modified();
+  }
+
+
+  void SliceArchive::AddMember (const Member &member)
+  {
+    // directories, hidden files and files of hidden directories
+    const std::string &name = member.Name;
+    if (name.empty() || name[name.size()-1]=='/' || name[0]=='.' || name.find ("/.")!=std::string::npos)
+      return;
+    m_Members.push_back (member);
+  }
+
+
+  void SliceArchive::ReadTarMembers (std::istream &in)
+  {
+    char header[TarBlockSize];
+    std::string longName;
+    unsigned long long offset = 0;
+
+    unsigned char magic[2] = { 0, 0 };
+    in.read (reinterpret_cast<char*>(magic), 2);
+    if (magic[0]==0x1f && magic[1]==0x8b)
+    {
+      itkExceptionMacro (<< m_FileName << " is compressed: only plain tar archives can be read");
+    }
+    in.clear();
+    in.seekg (0);
+
+    while (in.read (header, TarBlockSize))
+    {
+      // the archive ends with empty blocks
+      if (!header[0])
+        return;
+      if (!IsTarHeader (header))
+        break;
+
+      Member member;
+      member.Name       = GetTarString (header, 100);
+      member.Offset     = offset + TarBlockSize;
+      member.Size       = GetTarNumber (header + 124, 12);
+      member.StoredSize = member.Size;
+      member.Method     = Stored;
+      if (std::memcmp (header + 257, "ustar", 5)==0 && header[345])
+        member.Name = GetTarString (header + 345, 155) + "/" + member.Name;
+
+      const char type = header[156];
+      const unsigned long long blocks = (member.Size + TarBlockSize - 1) / TarBlockSize;
+      if (type=='L' || type=='x')
+      {
+        // long name of the next member (GNU tar or pax)
+        std::vector<char> data (blocks * TarBlockSize + 1, '\0');
+        if (!in.read (&data[0], blocks * TarBlockSize))
+          break;
+        const std::string text (&data[0], member.Size);
+        longName = type=='L' ? GetTarString (&data[0], member.Size) : GetPaxPath (text);
+      }
+      else
+      {
+        if (!longName.empty())
+          member.Name = longName;
+        longName.clear();
+        if (type=='0' || type=='\0' || type=='7')
+          this->AddMember (member);
+        in.seekg (blocks * TarBlockSize, std::ios::cur);
+      }
+      offset += (blocks + 1) * TarBlockSize;
+    }
+
+    if (offset==0 || !in.eof())
+    {
+      itkExceptionMacro (<< m_FileName << " is not a valid tar archive");
+    }
+  }
+
+
+  void SliceArchive::ReadZipMembers (std::istream &in)
+  {
+    // the end of central directory record is within the last 64KB, its comment included
+    in.seekg (0, std::ios::end);
+    const unsigned long long length = in.tellg();
+    const unsigned long long tail = std::min<unsigned long long> (length, 65535 + 22);
+    std::vector<unsigned char> end (tail + 1);
+    in.seekg (length - tail);
+    in.read (reinterpret_cast<char*>(&end[0]), tail);
+
+    long record = static_cast<long>(tail) - 22;
+    while (record>=0 && GetLittleEndian32 (&end[record])!=0x06054b50)
+      record--;
+    if (!in || record<0)
+    {
+      itkExceptionMacro (<< m_FileName << " is not a valid zip archive");
+    }
+
+    const unsigned int  entries         = GetLittleEndian16 (&end[record + 10]);
+    const unsigned long directorySize   = GetLittleEndian32 (&end[record + 12]);
+    const unsigned long directoryOffset = GetLittleEndian32 (&end[record + 16]);
+    if (entries==0xffff || directorySize==0xffffffffUL || directoryOffset==0xffffffffUL)
+    {
+      itkExceptionMacro (<< m_FileName << " is a zip64 archive, which is not supported");
+    }
+
+    std::vector<unsigned char> directory (directorySize + 1);
+    in.seekg (directoryOffset);
+    in.read (reinterpret_cast<char*>(&directory[0]), directorySize);
+    if (!in)
+    {
+      itkExceptionMacro (<< "cannot read the central directory of " << m_FileName);
+    }
+
+    unsigned long position = 0;
+    for (unsigned int i=0; i<entries; i++)
+    {
+      const unsigned char *entry = &directory[position];
+      if (position + 46 > directorySize || GetLittleEndian32 (entry)!=0x02014b50)
+      {
+        itkExceptionMacro (<< "corrupt central directory in " << m_FileName);
+      }
+      const unsigned int nameLength    = GetLittleEndian16 (entry + 28);
+      const unsigned int extraLength   = GetLittleEndian16 (entry + 30);
+      const unsigned int commentLength = GetLittleEndian16 (entry + 32);
+      if (position + 46 + nameLength > directorySize)
+      {
+        itkExceptionMacro (<< "corrupt central directory in " << m_FileName);
+      }
+
+      // the offset is the local header's, whose extra field may differ:
+      // the data offset is found when reading the member
+      Member member;
+      member.Name       = std::string (reinterpret_cast<const char*>(entry + 46), nameLength);
+      member.Method     = GetLittleEndian16 (entry + 10);
+      member.StoredSize = GetLittleEndian32 (entry + 20);
+      member.Size       = GetLittleEndian32 (entry + 24);
+      member.Offset     = GetLittleEndian32 (entry + 42);
+      if (GetLittleEndian16 (entry + 8) & 1)
+        member.Method = ~0u;   // encrypted
+      this->AddMember (member);
+
+      position += 46 + nameLength + extraLength + commentLength;
+    }
+  }
+
+
+  void SliceArchive::ReadMember (unsigned int member, void *data) const
+  {
+    this->CopyMember (member, static_cast<char*>(data), 0);
+  }
+
+
+  void SliceArchive::ExtractMember (unsigned int member, const std::string &filename) const
+  {
+    // never through a file or a link planted under that name
+    const int out = open (filename.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_BINARY, 0600);
+    if (out<0)
+    {
+      itkExceptionMacro (<< "cannot create " << filename << ": " << strerror (errno));
+    }
+    try
+    {
+      this->CopyMember (member, 0, out);
+    }
+    catch (...)
+    {
+      close (out);
+      throw;
+    }
+    if (close (out)!=0)
+    {
+      itkExceptionMacro (<< "cannot write " << filename << ": " << strerror (errno));
+    }
+  }
+
+
+  void SliceArchive::CopyMember (unsigned int index, char *data, int out) const
+  {
+    const Member &member = m_Members[index];
+    std::ifstream in (m_FileName.c_str(), std::ios::binary);
+    unsigned long long offset = member.Offset;
+    if (m_Zip)
+    {
+      unsigned char local[30];
+      in.seekg (offset);
+      in.read (reinterpret_cast<char*>(local), sizeof(local));
+      if (!in || GetLittleEndian32 (local)!=0x04034b50)
+      {
+        itkExceptionMacro (<< "corrupt local header for " << member.Name << " in " << m_FileName);
+      }
+      offset += sizeof(local) + GetLittleEndian16 (local + 26) + GetLittleEndian16 (local + 28);
+    }
+    in.seekg (offset);
+
+    if (member.Method!=Stored && member.Method!=Deflated)
+    {
+      itkExceptionMacro (<< member.Name << " in " << m_FileName
+                         << " is encrypted or uses an unsupported compression method");
+    }
+
+    // the stored data and, for a file, the decompressed data go through
+    // chunks on the stack: nothing is allocated per member
+    char input[32768];
+    char output[32768];
+
+    if (member.Method==Stored)
+    {
+      if (data)
+        in.read (data, member.Size);
+      for (size_t left = data ? 0 : member.Size; in && left; )
+      {
+        const size_t chunk = std::min<size_t> (left, sizeof(input));
+        in.read (input, chunk);
+        if (!WriteFully (out, input, static_cast<size_t>(in.gcount())))
+        {
+          itkExceptionMacro (<< "cannot extract " << member.Name << ": " << strerror (errno));
+        }
+        left -= chunk;
+      }
+      if (!in)
+      {
+        itkExceptionMacro (<< "cannot read " << member.Name << " from " << m_FileName);
+      }
+      return;
+    }
+
+    // raw deflate stream, without zlib header
+    z_stream stream;
+    std::memset (&stream, 0, sizeof(stream));
+    if (inflateInit2 (&stream, -MAX_WBITS)!=Z_OK)
+    {
+      itkExceptionMacro (<< "cannot decompress " << member.Name);
+    }
+    if (data)
+    {
+      stream.next_out  = reinterpret_cast<Bytef*>(data);
+      stream.avail_out = static_cast<uInt>(member.Size);
+    }
+
+    int status = Z_OK;
+    bool written = true;
+    size_t stored = member.StoredSize;
+    while (status==Z_OK)
+    {
+      if (!stream.avail_in && stored)
+      {
+        const size_t chunk = std::min<size_t> (stored, sizeof(input));
+        in.read (input, chunk);
+        if (!in)
+          break;
+        stored -= chunk;
+        stream.next_in  = reinterpret_cast<Bytef*>(input);
+        stream.avail_in = static_cast<uInt>(chunk);
+      }
+      if (!data)
+      {
+        stream.next_out  = reinterpret_cast<Bytef*>(output);
+        stream.avail_out = sizeof(output);
+      }
+      status = inflate (&stream, Z_NO_FLUSH);
+      if (!data && !WriteFully (out, output, sizeof(output) - stream.avail_out))
+      {
+        written = false;
+        break;
+      }
+      // no progress for lack of input, which is still to be read
+      if (status==Z_BUF_ERROR && !stream.avail_in && stored)
+        status = Z_OK;
+    }
+    const unsigned long size = stream.total_out;
+    inflateEnd (&stream);
+    if (!written)
+    {
+      itkExceptionMacro (<< "cannot extract " << member.Name << ": " << strerror (errno));
+    }
+    if (status!=Z_STREAM_END || size!=member.Size)
+    {
+      itkExceptionMacro (<< "corrupt data for " << member.Name << " in " << m_FileName);
+    }
+  }
+
+
+  SliceArchive::ScopedExtraction::ScopedExtraction (const SliceArchive *archive, unsigned int member)
+  {
+    // a directory of our own, in memory where the system offers it: no
+    // other user can put or swap files in it
+    std::string parent;
+    if (itksys::SystemTools::FileIsDirectory ("/dev/shm"))
+      parent = "/dev/shm";
+    else if (!itksys::SystemTools::GetEnv ("TMPDIR", parent) && !itksys::SystemTools::GetEnv ("TEMP", parent))
+      parent = "/tmp";
+#ifdef WIN32
+    static long s_Directories = 0;
+    std::ostringstream name;
+    name << parent << "/slice-" << getpid() << "-" << s_Directories++ << "-" << member;
+    m_Directory = name.str();
+    if (_mkdir (m_Directory.c_str())!=0)
+#else
+    std::string pattern = parent + "/slice-XXXXXX";
+    std::vector<char> buffer (pattern.begin(), pattern.end());
+    buffer.push_back ('\0');
+    if (mkdtemp (&buffer[0]))
+      m_Directory = &buffer[0];
+    else
+#endif
+    {
+      itkGenericExceptionMacro (<< "cannot create a temporary directory in " << parent << ": " << strerror (errno));
+    }
+
+    // the base name, so that ImageIO recognizes the format
+    std::string base = itksys::SystemTools::GetFilenameName (archive->GetMemberName (member));
+    if (base.empty() || base=="." || base=="..")
+      base = "member";
+    m_FileName = m_Directory + "/" + base;
+    try
+    {
+      archive->ExtractMember (member, m_FileName);
+    }
+    catch (...)
+    {
+      itksys::SystemTools::RemoveFile (m_FileName.c_str());
+      rmdir (m_Directory.c_str());
+      throw;
+    }
+  }
+
+
+  SliceArchive::ScopedExtraction::~ScopedExtraction()
+  {
+    itksys::SystemTools::RemoveFile (m_FileName.c_str());
+    rmdir (m_Directory.c_str());
+  }
+
+
+  void SliceArchive::PrintSelf (std::ostream &os, Indent indent) const
+  {
+    Superclass::PrintSelf (os, indent);
+    os << indent << "FileName: " << m_FileName << std::endl;
+    os << indent << "Zip: " << m_Zip << std::endl;
+    os << indent << "Members: " << m_Members.size() << std::endl;
+  }
+
+} // end of namespace
@@ -0,0 +1,147 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_SliceArchive_h_
+#define _itk_SliceArchive_h_
+
+#include "itkObject.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+   Members of a tar or zip archive, read without extracting it.
+
+   Raw, PGM and compressed slices are decoded from the member read in
+   memory. The other formats are read by an ImageIO, which only reads
+   files: their members are extracted one at a time to a temporary file,
+   in /dev/shm where it exists so that they stay in memory.
+
+   Open scans the archive once: tar headers are read one after the other,
+   seeking over the data, zip members are listed from the central
+   directory. Members are then sorted by name, directories and hidden
+   files left out, and each one is read from its offset, so that several
+   threads can read different members at the same time. Zip members are
+   either stored or deflated; compressed tar files (.tar.gz) and zip64
+   archives are not supported.
+ */
+
+namespace itk
+{
+
+  class SliceArchive : public Object
+  {
+  public:
+    typedef SliceArchive             Self;
+    typedef Object                   Superclass;
+    typedef SmartPointer<Self>       Pointer;
+    typedef SmartPointer<const Self> ConstPointer;
+
+    itkNewMacro (Self);
+    itkTypeMacro (SliceArchive, Object);
+
+    /** True for names ending in .tar or .zip. */
+    static bool IsArchive (const std::string &filename);
+
+    /** List the members of the archive. Throws if it cannot be read. */
+    void Open (const std::string &filename);
+
+    const std::string &GetFileName (void) const
+    { return m_FileName; }
+
+    unsigned int GetNumberOfMembers (void) const
+    { return m_Members.size(); }
+
+    /** Path of the member in the archive. */
+    const std::string &GetMemberName (unsigned int member) const
+    { return m_Members[member].Name; }
+
+    /** Size of the member once decompressed. */
+    size_t GetMemberSize (unsigned int member) const
+    { return m_Members[member].Size; }
+
+    /** Read the member into data, which holds GetMemberSize(member)
+        bytes, without allocating. Thread safe: each call opens its own
+        stream. */
+    void ReadMember (unsigned int member, void *data) const;
+
+    /** Write the member to a new file, for the formats only read by
+        ImageIO, which reads files only (TIFF, PNG, DICOM...). Throws if
+        filename already exists, even as a link. */
+    void ExtractMember (unsigned int member, const std::string &filename) const;
+
+    /** Member extracted to a temporary file, under its base name so that
+        ImageIO recognizes its format, in a directory only this user can
+        enter (mkdtemp), in /dev/shm where it exists, else in TMPDIR; both
+        are removed when leaving the scope. */
+    class ScopedExtraction
+    {
+    public:
+      ScopedExtraction (const SliceArchive *archive, unsigned int member);
+      ~ScopedExtraction();
+
+      const std::string &GetFileName (void) const
+      { return m_FileName; }
+
+    private:
+      ScopedExtraction (const ScopedExtraction&);
+      void operator=(const ScopedExtraction&);
+
+      std::string  m_Directory;
+      std::string  m_FileName;
+    };
+
+  protected:
+    SliceArchive();
+    ~SliceArchive() {}
+
+    void PrintSelf (std::ostream &os, Indent indent) const;
+
+  private:
+    SliceArchive (const Self&);
+    void operator=(const Self&);
+
+    struct Member
+    {
+      std::string         Name;
+      unsigned long long  Offset;
+      size_t              Size;
+      size_t              StoredSize;
+      unsigned int        Method;
+
+      bool operator< (const Member &other) const
+      { return Name < other.Name; }
+    };
+
+    void ReadTarMembers (std::istream &in);
+    void ReadZipMembers (std::istream &in);
+    void AddMember (const Member &member);
+
+    /** Decompress a member into data, or into the file descriptor out if
+        data is 0. */
+    void CopyMember (unsigned int member, char *data, int out) const;
+
+    std::string          m_FileName;
+    bool                 m_Zip;
+    std::vector<Member>  m_Members;
+
+  };
+
+} // end of namespace
+
+
+#endif
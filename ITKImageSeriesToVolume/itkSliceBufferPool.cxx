@@ -0,0 +1,178 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkSliceBufferPool.h"
+#include "itkMutexLockHolder.h"
+
+#include <cstdlib>
+
+#ifdef WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace itk
+{
+
+  namespace
+  {
+    const size_t CacheLineSize = 64;
+    const size_t HugePageSize  = 2 << 20;
+  }
+
+
+  SliceBufferPool::SliceBufferPool()
+  {
+  }
+
+
+  SliceBufferPool::~SliceBufferPool()
+  {
+    for (unsigned int i=0; i<m_Buffers.size(); i++)
+      Free (m_Buffers[i].Data);
+  }
+
+
+  void *SliceBufferPool::Allocate (size_t size)
+  {
+    const size_t alignment = size >= HugePageSize ? HugePageSize : CacheLineSize;
+    void *data = 0;
+#ifdef WIN32
+    data = _aligned_malloc (size, alignment);
+#else
+    if (posix_memalign (&data, alignment, size)!=0)
+      data = 0;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // only a hint: the kernel may have transparent huge pages disabled
+    if (data && alignment==HugePageSize)
+      madvise (data, size - size % HugePageSize, MADV_HUGEPAGE);
+#endif
+#endif
+    if (!data)
+    {
+      itkGenericExceptionMacro (<< "cannot allocate a slice buffer of " << size << " bytes");
+    }
+    return data;
+  }
+
+
+  void SliceBufferPool::Free (void *data)
+  {
+#ifdef WIN32
+    _aligned_free (data);
+#else
+    free (data);
+#endif
+  }
+
+
+  void *SliceBufferPool::Acquire (size_t size)
+  {
+    MutexLockHolder<SimpleFastMutexLock> holder (m_Lock);
+
+    // smallest free buffer large enough, or else a free one to replace
+    int fit = -1, spare = -1;
+    for (unsigned int i=0; i<m_Buffers.size(); i++)
+    {
+      if (m_Buffers[i].InUse)
+        continue;
+      if (m_Buffers[i].Size >= size)
+      {
+        if (fit<0 || m_Buffers[i].Size < m_Buffers[fit].Size)
+          fit = i;
+      }
+      else
+        spare = i;
+    }
+
+    if (fit<0)
+    {
+      // room for the new buffer first, so that it cannot leak
+      if (spare<0)
+        m_Buffers.reserve (m_Buffers.size()+1);
+      Buffer buffer;
+      buffer.Size  = size;
+      buffer.InUse = false;
+      buffer.Data  = Allocate (size);
+      if (spare>=0)
+      {
+        Free (m_Buffers[spare].Data);
+        m_Buffers[spare] = buffer;
+        fit = spare;
+      }
+      else
+      {
+        m_Buffers.push_back (buffer);
+        fit = m_Buffers.size()-1;
+      }
+    }
+
+    m_Buffers[fit].InUse = true;
+    return m_Buffers[fit].Data;
+  }
+
+
+  void SliceBufferPool::Release (void *buffer)
+  {
+    if (!buffer)
+      return;
+    MutexLockHolder<SimpleFastMutexLock> holder (m_Lock);
+    for (unsigned int i=0; i<m_Buffers.size(); i++)
+    {
+      if (m_Buffers[i].Data==buffer)
+      {
+        m_Buffers[i].InUse = false;
+        break;
+      }
+    }
+  }
+
+
+  void SliceBufferPool::Trim (void)
+  {
+    MutexLockHolder<SimpleFastMutexLock> holder (m_Lock);
+    std::vector<Buffer> used;
+    used.reserve (m_Buffers.size());
+    for (unsigned int i=0; i<m_Buffers.size(); i++)
+    {
+      if (m_Buffers[i].InUse)
+        used.push_back (m_Buffers[i]);
+      else
+        Free (m_Buffers[i].Data);
+    }
+    m_Buffers.swap (used);
+  }
+
+
+  size_t SliceBufferPool::GetAllocatedBytes (void) const
+  {
+    MutexLockHolder<SimpleFastMutexLock> holder (m_Lock);
+    size_t bytes = 0;
+    for (unsigned int i=0; i<m_Buffers.size(); i++)
+      bytes += m_Buffers[i].Size;
+    return bytes;
+  }
+
+
+  void SliceBufferPool::PrintSelf (std::ostream &os, Indent indent) const
+  {
+    Superclass::PrintSelf (os, indent);
+    os << indent << "NumberOfBuffers: " << m_Buffers.size() << std::endl;
+    os << indent << "AllocatedBytes: " << this->GetAllocatedBytes() << std::endl;
+  }
+
+} // end of namespace
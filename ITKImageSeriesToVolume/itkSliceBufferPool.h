@@ -0,0 +1,108 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_SliceBufferPool_h_
+#define _itk_SliceBufferPool_h_
+
+#include "itkObject.h"
+#include "itkSimpleFastMutexLock.h"
+
+#include <vector>
+
+/**
+   Recycle the scratch buffers slices are decoded into, so that once a
+   conversion runs its steady state it no longer allocates its decode
+   buffers per slice.
+   Buffers are aligned on a cache line; those of 2 MB and more are
+   aligned on 2 MB and, on Linux, handed to transparent huge pages.
+   Acquire and Release may be called from several threads.
+ */
+
+namespace itk
+{
+
+  class SliceBufferPool : public Object
+  {
+  public:
+    typedef SliceBufferPool          Self;
+    typedef Object                   Superclass;
+    typedef SmartPointer<Self>       Pointer;
+    typedef SmartPointer<const Self> ConstPointer;
+
+    itkNewMacro (Self);
+    itkTypeMacro (SliceBufferPool, Object);
+
+    /** A free buffer of at least size bytes, allocated if none fits. */
+    void *Acquire (size_t size);
+
+    /** Give back a buffer returned by Acquire. */
+    void Release (void *buffer);
+
+    /** Free the buffers that are not in use. */
+    void Trim (void);
+
+    /** Bytes held by the pool, in use or not. */
+    size_t GetAllocatedBytes (void) const;
+
+    /** Buffer released when leaving the scope. */
+    class ScopedBuffer
+    {
+    public:
+      ScopedBuffer (SliceBufferPool *pool, size_t size)
+        : m_Pool (pool), m_Data (pool->Acquire (size)) {}
+      ~ScopedBuffer()
+      { m_Pool->Release (m_Data); }
+
+      void *GetPointer (void) const
+      { return m_Data; }
+
+    private:
+      ScopedBuffer (const ScopedBuffer&);
+      void operator=(const ScopedBuffer&);
+
+      SliceBufferPool *m_Pool;
+      void            *m_Data;
+    };
+
+  protected:
+    SliceBufferPool();
+    ~SliceBufferPool();
+
+    void PrintSelf (std::ostream &os, Indent indent) const;
+
+  private:
+    SliceBufferPool (const Self&);
+    void operator=(const Self&);
+
+    struct Buffer
+    {
+      void   *Data;
+      size_t  Size;
+      bool    InUse;
+    };
+
+    static void *Allocate (size_t size);
+    static void  Free (void *data);
+
+    std::vector<Buffer>          m_Buffers;
+    mutable SimpleFastMutexLock  m_Lock;
+
+  };
+
+} // end of namespace
+
+
+#endif
@@ -0,0 +1,265 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkSliceHashes.h"
+#include "itkImageIOFactory.h"
+#include "itkMacro.h"
+#include "itkMultiThreader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace itk
+{
+
+  namespace
+  {
+    const unsigned long long Prime1 = 11400714785074694791ULL;
+    const unsigned long long Prime2 = 14029467366897019727ULL;
+    const unsigned long long Prime3 =  1609587929392839161ULL;
+    const unsigned long long Prime4 =  9650029242287828579ULL;
+    const unsigned long long Prime5 =  2870177450012600261ULL;
+
+    /** Slab size of HashVolumeSlices without memory budget. */
+    const unsigned long long DefaultHashingMemory = 256ULL << 20;
+
+    inline unsigned long long Rotate (unsigned long long x, int r)
+    {
+      return (x << r) | (x >> (64 - r));
+    }
+
+    inline unsigned long long Read64 (const unsigned char *p)
+    {
+      unsigned long long v;
+      memcpy (&v, p, sizeof(v));
+      return v;
+    }
+
+    inline unsigned long long Read32 (const unsigned char *p)
+    {
+      unsigned int v;
+      memcpy (&v, p, sizeof(v));
+      return v;
+    }
+
+    inline unsigned long long Round (unsigned long long accumulator, unsigned long long input)
+    {
+      accumulator += input * Prime2;
+      return Rotate (accumulator, 31) * Prime1;
+    }
+
+    inline unsigned long long Merge (unsigned long long accumulator, unsigned long long value)
+    {
+      accumulator ^= Round (0, value);
+      return accumulator * Prime1 + Prime4;
+    }
+
+
+    /** Slab of the volume shared by the threads of HashVolumeSlices. */
+    struct VolumeSlabs
+    {
+      const char                       *Data;
+      size_t                            SliceBytes;
+      unsigned int                      FirstSlice;
+      unsigned int                      NumberOfSlices;
+      std::vector<unsigned long long>  *Hashes;
+    };
+
+    ITK_THREAD_RETURN_TYPE HashSlab (void *arg)
+    {
+      MultiThreader::ThreadInfoStruct *info = static_cast<MultiThreader::ThreadInfoStruct*>(arg);
+      const VolumeSlabs *volume = static_cast<const VolumeSlabs*>(info->UserData);
+
+      const unsigned int chunk = (volume->NumberOfSlices + info->NumberOfThreads - 1) / info->NumberOfThreads;
+      const unsigned int first = info->ThreadID * chunk;
+      for (unsigned int z=first; z<first+chunk && z<volume->NumberOfSlices; z++)
+        (*volume->Hashes)[volume->FirstSlice + z] = HashBuffer (volume->Data + z * volume->SliceBytes, volume->SliceBytes);
+
+      return ITK_THREAD_RETURN_VALUE;
+    }
+  }
+
+
+  unsigned long long HashBuffer (const void *buffer, size_t size, unsigned long long seed)
+  {
+    const unsigned char *p   = static_cast<const unsigned char*>(buffer);
+    const unsigned char *end = p + size;
+    unsigned long long h;
+
+    if (size >= 32)
+    {
+      // four independent lanes over 32-byte stripes
+      unsigned long long v1 = seed + Prime1 + Prime2;
+      unsigned long long v2 = seed + Prime2;
+      unsigned long long v3 = seed;
+      unsigned long long v4 = seed - Prime1;
+      for (; p+32<=end; p+=32)
+      {
+        v1 = Round (v1, Read64 (p));
+        v2 = Round (v2, Read64 (p+8));
+        v3 = Round (v3, Read64 (p+16));
+        v4 = Round (v4, Read64 (p+24));
+      }
+      h = Rotate (v1, 1) + Rotate (v2, 7) + Rotate (v3, 12) + Rotate (v4, 18);
+      h = Merge (h, v1);
+      h = Merge (h, v2);
+      h = Merge (h, v3);
+      h = Merge (h, v4);
+    }
+    else
+      h = seed + Prime5;
+
+    h += size;
+
+    for (; p+8<=end; p+=8)
+    {
+      h ^= Round (0, Read64 (p));
+      h = Rotate (h, 27) * Prime1 + Prime4;
+    }
+    if (p+4<=end)
+    {
+      h ^= Read32 (p) * Prime1;
+      h = Rotate (h, 23) * Prime2 + Prime3;
+      p += 4;
+    }
+    for (; p<end; p++)
+    {
+      h ^= *p * Prime5;
+      h = Rotate (h, 11) * Prime1;
+    }
+
+    h ^= h >> 33;
+    h *= Prime2;
+    h ^= h >> 29;
+    h *= Prime3;
+    h ^= h >> 32;
+    return h;
+  }
+
+
+  std::string GetSliceHashesFileName (const std::string &volume)
+  {
+    return volume + ".xxh64";
+  }
+
+
+  bool WriteSliceHashes (const std::string &filename, const std::vector<unsigned long long> &hashes,
+                         const std::vector<std::string> &sources)
+  {
+    std::ofstream file (filename.c_str());
+    file << "# xxh64 of each slice" << (sources.empty() ? "" : ", and its source") << "\n";
+    for (unsigned int i=0; i<hashes.size(); i++)
+    {
+      file << std::hex << std::setw (16) << std::setfill ('0') << hashes[i];
+      if (i<sources.size())
+        file << " " << sources[i];
+      file << "\n";
+    }
+    return file.good();
+  }
+
+
+  bool ReadSliceHashes (const std::string &filename, std::vector<unsigned long long> &hashes,
+                        std::vector<std::string> &sources)
+  {
+    std::ifstream file (filename.c_str());
+    if (!file)
+      return false;
+
+    hashes.clear();
+    sources.clear();
+    std::string line;
+    while (std::getline (file, line))
+    {
+      if (line.empty() || line[0]=='#')
+        continue;
+      std::istringstream fields (line);
+      unsigned long long hash;
+      if (!(fields >> std::hex >> hash))
+        return false;
+      std::string source;
+      fields >> std::ws;
+      std::getline (fields, source);
+      hashes.push_back (hash);
+      sources.push_back (source);
+    }
+    return true;
+  }
+
+
+  void HashVolumeSlices (const std::string &volume, unsigned int numberOfThreads,
+                         unsigned long long maxMemory, std::vector<unsigned long long> &hashes)
+  {
+    ImageIOBase::Pointer io = ImageIOFactory::CreateImageIO (volume.c_str(), ImageIOFactory::ReadMode);
+    if (io.IsNull())
+    {
+      itkGenericExceptionMacro (<< "cannot find an ImageIO to read " << volume);
+    }
+    io->SetFileName (volume.c_str());
+    io->ReadImageInformation();
+
+    const unsigned int dimension = io->GetNumberOfDimensions();
+    const unsigned int numberOfSlices = dimension ? io->GetDimensions (dimension-1) : 0;
+    size_t sliceBytes = io->GetPixelSize();
+    for (unsigned int i=0; i+1<dimension; i++)
+      sliceBytes *= io->GetDimensions (i);
+    if (!numberOfSlices || !sliceBytes)
+    {
+      itkGenericExceptionMacro (<< volume << " is empty");
+    }
+
+    // slabs of whole slices within the memory budget, the whole volume
+    // for the ImageIOs that cannot read a part of it
+    unsigned int slabSlices = numberOfSlices;
+    if (io->CanStreamRead())
+    {
+      const unsigned long long budget = maxMemory ? maxMemory : DefaultHashingMemory;
+      slabSlices = static_cast<unsigned int>(std::min<unsigned long long> (numberOfSlices,
+                                                                           std::max<unsigned long long> (1, budget / sliceBytes)));
+    }
+    std::vector<char> data (slabSlices * sliceBytes);
+
+    hashes.assign (numberOfSlices, 0);
+    VolumeSlabs slabs;
+    slabs.Data       = &data[0];
+    slabs.SliceBytes = sliceBytes;
+    slabs.Hashes     = &hashes;
+
+    MultiThreader::Pointer threader = MultiThreader::New();
+    for (unsigned int first=0; first<numberOfSlices; first+=slabSlices)
+    {
+      const unsigned int count = std::min (slabSlices, numberOfSlices - first);
+      ImageIORegion region (dimension);
+      for (unsigned int i=0; i<dimension; i++)
+      {
+        region.SetIndex (i, i+1<dimension ? 0 : first);
+        region.SetSize (i, i+1<dimension ? io->GetDimensions (i) : count);
+      }
+      io->SetIORegion (region);
+      io->Read (&data[0]);
+
+      slabs.FirstSlice     = first;
+      slabs.NumberOfSlices = count;
+      threader->SetNumberOfThreads (std::max (1u, std::min (numberOfThreads, count)));
+      threader->SetSingleMethod (HashSlab, &slabs);
+      threader->SingleMethodExecute();
+    }
+  }
+
+} // end of namespace
@@ -0,0 +1,62 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_SliceHashes_h_
+#define _itk_SliceHashes_h_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+   Per-slice checksums of a volume, to check a conversion without
+   comparing it pixel by pixel with its inputs. Slices are hashed with
+   XXH64 as laid out in memory, so hashes only compare between machines
+   of the same byte order.
+ */
+
+namespace itk
+{
+
+  /** XXH64 hash of size bytes. */
+  unsigned long long HashBuffer (const void *buffer, size_t size, unsigned long long seed = 0);
+
+  /** Name of the hashes stored along with a volume. */
+  std::string GetSliceHashesFileName (const std::string &volume);
+
+  /** Store one hash per slice, with the name of the slice source when
+      sources is not empty. Returns false if the file cannot be written. */
+  bool WriteSliceHashes (const std::string &filename, const std::vector<unsigned long long> &hashes,
+                         const std::vector<std::string> &sources);
+
+  /** Read hashes written by WriteSliceHashes. Returns false if the file
+      cannot be read. */
+  bool ReadSliceHashes (const std::string &filename, std::vector<unsigned long long> &hashes,
+                        std::vector<std::string> &sources);
+
+  /** Hash every slice, along the last dimension, of a volume file. The
+      volume is read slab by slab, each slab of at most maxMemory bytes
+      (256 MB if 0) and at least one slice, and its slices are split
+      between numberOfThreads threads. ImageIOs that cannot stream read
+      the whole volume at once. Throws if the volume cannot be read or
+      is empty. */
+  void HashVolumeSlices (const std::string &volume, unsigned int numberOfThreads,
+                         unsigned long long maxMemory, std::vector<unsigned long long> &hashes);
+
+} // end of namespace
+
+
+#endif
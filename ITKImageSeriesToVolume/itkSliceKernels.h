@@ -0,0 +1,310 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_SliceKernels_h_
+#define _itk_SliceKernels_h_
+
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ITK_SLICE_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+/**
+   Kernels working on the raw buffer of one decoded slice. They only see
+   bytes and a pixel size so that they can run on whatever component type
+   the reader produced, before any cast to the output pixel type.
+ */
+
+namespace itk
+{
+
+  /**
+     Return true if every pixel of the buffer holds the same value.
+     Pixels whose size divides 16 bytes are compared 64 bytes at a time
+     against the first pixel repeated; other pixel sizes fall back on
+     comparing the buffer with itself shifted by one pixel.
+   */
+  inline bool IsConstantBuffer (const void *buffer, size_t numberOfBytes, size_t pixelSize)
+  {
+    const unsigned char *p = static_cast<const unsigned char*>(buffer);
+    if (numberOfBytes <= pixelSize)
+      return true;
+
+#ifdef ITK_SLICE_KERNELS_SSE2
+    if (16 % pixelSize == 0)
+    {
+      unsigned char pattern[16];
+      for (size_t i=0; i<16; i+=pixelSize)
+        memcpy (pattern+i, p, pixelSize);
+      const __m128i ref = _mm_loadu_si128 (reinterpret_cast<const __m128i*>(pattern));
+
+      size_t i = 0;
+      for (; i+64<=numberOfBytes; i+=64)
+      {
+        __m128i a = _mm_cmpeq_epi8 (_mm_loadu_si128 (reinterpret_cast<const __m128i*>(p+i)),    ref);
+        __m128i b = _mm_cmpeq_epi8 (_mm_loadu_si128 (reinterpret_cast<const __m128i*>(p+i+16)), ref);
+        __m128i c = _mm_cmpeq_epi8 (_mm_loadu_si128 (reinterpret_cast<const __m128i*>(p+i+32)), ref);
+        __m128i d = _mm_cmpeq_epi8 (_mm_loadu_si128 (reinterpret_cast<const __m128i*>(p+i+48)), ref);
+        __m128i all = _mm_and_si128 (_mm_and_si128 (a, b), _mm_and_si128 (c, d));
+        if (_mm_movemask_epi8 (all) != 0xFFFF)
+          return false;
+      }
+      // the tail starts on a pixel boundary since 64 is a multiple of the pixel size
+      for (; i+pixelSize<=numberOfBytes; i+=pixelSize)
+        if (memcmp (p+i, p, pixelSize)!=0)
+          return false;
+      return true;
+    }
+#endif
+
+    return memcmp (p, p+pixelSize, numberOfBytes-pixelSize)==0;
+  }
+
+
+  /**
+     Convert n floats with out = clamp(in * scale + shift, lo, hi), rounded
+     to the nearest integer for integer outputs. The generic version is
+     written so that the compiler can vectorize it; the 8 and 16-bit
+     outputs have explicit SSE2 versions below.
+   */
+  template <class TOutput>
+  inline void RescaleBuffer (const float *in, TOutput *out, size_t n,
+                             float scale, float shift, float lo, float hi)
+  {
+    const float rounding = std::numeric_limits<TOutput>::is_integer ? 0.5f : 0.0f;
+    for (size_t i=0; i<n; i++)
+    {
+      float v = in[i] * scale + shift;
+      v = v < lo ? lo : (v > hi ? hi : v);
+      out[i] = static_cast<TOutput>(v < 0.0f ? v - rounding : v + rounding);
+    }
+  }
+
+#ifdef ITK_SLICE_KERNELS_SSE2
+  /** Convert 8 floats to clamped 32-bit integers, rounded half away
+      from zero like the scalar conversion, whatever the MXCSR mode. */
+  inline void RescaleBlock8 (const float *in, const __m128 &scale, const __m128 &shift,
+                             const __m128 &lo, const __m128 &hi, __m128i &a, __m128i &b)
+  {
+    const __m128 half = _mm_set1_ps (0.5f);
+    const __m128 sign = _mm_set1_ps (-0.0f);
+    __m128 x = _mm_min_ps (_mm_max_ps (_mm_add_ps (_mm_mul_ps (_mm_loadu_ps (in),   scale), shift), lo), hi);
+    __m128 y = _mm_min_ps (_mm_max_ps (_mm_add_ps (_mm_mul_ps (_mm_loadu_ps (in+4), scale), shift), lo), hi);
+    a = _mm_cvttps_epi32 (_mm_add_ps (x, _mm_or_ps (half, _mm_and_ps (x, sign))));
+    b = _mm_cvttps_epi32 (_mm_add_ps (y, _mm_or_ps (half, _mm_and_ps (y, sign))));
+  }
+
+  template <>
+  inline void RescaleBuffer<unsigned char> (const float *in, unsigned char *out, size_t n,
+                                            float scale, float shift, float lo, float hi)
+  {
+    const __m128 s = _mm_set1_ps (scale), t = _mm_set1_ps (shift);
+    const __m128 l = _mm_set1_ps (lo),    h = _mm_set1_ps (hi);
+    size_t i = 0;
+    for (; i+16<=n; i+=16)
+    {
+      __m128i a, b, c, d;
+      RescaleBlock8 (in+i,   s, t, l, h, a, b);
+      RescaleBlock8 (in+i+8, s, t, l, h, c, d);
+      __m128i v = _mm_packus_epi16 (_mm_packs_epi32 (a, b), _mm_packs_epi32 (c, d));
+      _mm_storeu_si128 (reinterpret_cast<__m128i*>(out+i), v);
+    }
+    for (; i<n; i++)
+    {
+      float v = in[i] * scale + shift;
+      v = v < lo ? lo : (v > hi ? hi : v);
+      out[i] = static_cast<unsigned char>(v < 0.0f ? v - 0.5f : v + 0.5f);
+    }
+  }
+
+  template <>
+  inline void RescaleBuffer<short> (const float *in, short *out, size_t n,
+                                    float scale, float shift, float lo, float hi)
+  {
+    const __m128 s = _mm_set1_ps (scale), t = _mm_set1_ps (shift);
+    const __m128 l = _mm_set1_ps (lo),    h = _mm_set1_ps (hi);
+    size_t i = 0;
+    for (; i+8<=n; i+=8)
+    {
+      __m128i a, b;
+      RescaleBlock8 (in+i, s, t, l, h, a, b);
+      _mm_storeu_si128 (reinterpret_cast<__m128i*>(out+i), _mm_packs_epi32 (a, b));
+    }
+    for (; i<n; i++)
+    {
+      float v = in[i] * scale + shift;
+      v = v < lo ? lo : (v > hi ? hi : v);
+      out[i] = static_cast<short>(v < 0.0f ? v - 0.5f : v + 0.5f);
+    }
+  }
+
+  template <>
+  inline void RescaleBuffer<unsigned short> (const float *in, unsigned short *out, size_t n,
+                                             float scale, float shift, float lo, float hi)
+  {
+    // SSE2 has no unsigned 32 to 16-bit pack: pack the rounded values
+    // shifted into the signed range and flip the sign bit back
+    const __m128 s = _mm_set1_ps (scale), t = _mm_set1_ps (shift);
+    const __m128 l = _mm_set1_ps (lo),    h = _mm_set1_ps (hi);
+    const __m128i offset = _mm_set1_epi32 (32768);
+    const __m128i flip = _mm_set1_epi16 (static_cast<short>(0x8000));
+    size_t i = 0;
+    for (; i+8<=n; i+=8)
+    {
+      __m128i a, b;
+      RescaleBlock8 (in+i, s, t, l, h, a, b);
+      a = _mm_sub_epi32 (a, offset);
+      b = _mm_sub_epi32 (b, offset);
+      _mm_storeu_si128 (reinterpret_cast<__m128i*>(out+i), _mm_xor_si128 (_mm_packs_epi32 (a, b), flip));
+    }
+    for (; i<n; i++)
+    {
+      float v = in[i] * scale + shift;
+      v = v < lo ? lo : (v > hi ? hi : v);
+      out[i] = static_cast<unsigned short>(v < 0.0f ? v - 0.5f : v + 0.5f);
+    }
+  }
+#endif
+
+
+  /**
+     Convert n floats with out = table[in - offset], the index being
+     clamped to the table bounds.
+   */
+  template <class TOutput>
+  inline void LookupBuffer (const float *in, TOutput *out, size_t n,
+                            const TOutput *table, size_t tableSize, float offset)
+  {
+    const float last = static_cast<float>(tableSize - 1);
+    for (size_t i=0; i<n; i++)
+    {
+      float v = in[i] - offset + 0.5f;
+      v = v < 0.0f ? 0.0f : (v > last ? last : v);
+      out[i] = table[static_cast<size_t>(v)];
+    }
+  }
+
+
+
+  /**
+     Accumulate n pixels with acc = max(acc, in), for maximum intensity
+     projections. The 8, 16-bit and float versions use SSE2 below.
+   */
+  template <class TPixel>
+  inline void MaxBuffer (const TPixel *in, TPixel *acc, size_t n)
+  {
+    for (size_t i=0; i<n; i++)
+      acc[i] = in[i] > acc[i] ? in[i] : acc[i];
+  }
+
+  /** Largest of n pixels, n > 0. */
+  template <class TPixel>
+  inline TPixel MaxValue (const TPixel *in, size_t n)
+  {
+    // four partial maxima break the dependency chain
+    TPixel m[4] = { in[0], in[0], in[0], in[0] };
+    size_t i = 0;
+    for (; i+4<=n; i+=4)
+      for (int k=0; k<4; k++)
+        m[k] = in[i+k] > m[k] ? in[i+k] : m[k];
+    for (; i<n; i++)
+      m[0] = in[i] > m[0] ? in[i] : m[0];
+    m[0] = m[1] > m[0] ? m[1] : m[0];
+    m[2] = m[3] > m[2] ? m[3] : m[2];
+    return m[2] > m[0] ? m[2] : m[0];
+  }
+
+#ifdef ITK_SLICE_KERNELS_SSE2
+  template <>
+  inline void MaxBuffer<unsigned char> (const unsigned char *in, unsigned char *acc, size_t n)
+  {
+    size_t i = 0;
+    for (; i+16<=n; i+=16)
+    {
+      __m128i a = _mm_loadu_si128 (reinterpret_cast<const __m128i*>(in+i));
+      __m128i b = _mm_loadu_si128 (reinterpret_cast<const __m128i*>(acc+i));
+      _mm_storeu_si128 (reinterpret_cast<__m128i*>(acc+i), _mm_max_epu8 (a, b));
+    }
+    for (; i<n; i++)
+      acc[i] = in[i] > acc[i] ? in[i] : acc[i];
+  }
+
+  template <>
+  inline void MaxBuffer<short> (const short *in, short *acc, size_t n)
+  {
+    size_t i = 0;
+    for (; i+8<=n; i+=8)
+    {
+      __m128i a = _mm_loadu_si128 (reinterpret_cast<const __m128i*>(in+i));
+      __m128i b = _mm_loadu_si128 (reinterpret_cast<const __m128i*>(acc+i));
+      _mm_storeu_si128 (reinterpret_cast<__m128i*>(acc+i), _mm_max_epi16 (a, b));
+    }
+    for (; i<n; i++)
+      acc[i] = in[i] > acc[i] ? in[i] : acc[i];
+  }
+
+  template <>
+  inline void MaxBuffer<unsigned short> (const unsigned short *in, unsigned short *acc, size_t n)
+  {
+    // SSE2 only has a signed 16-bit max: compare with the sign bit flipped
+    const __m128i flip = _mm_set1_epi16 (static_cast<short>(0x8000));
+    size_t i = 0;
+    for (; i+8<=n; i+=8)
+    {
+      __m128i a = _mm_xor_si128 (_mm_loadu_si128 (reinterpret_cast<const __m128i*>(in+i)), flip);
+      __m128i b = _mm_xor_si128 (_mm_loadu_si128 (reinterpret_cast<const __m128i*>(acc+i)), flip);
+      _mm_storeu_si128 (reinterpret_cast<__m128i*>(acc+i), _mm_xor_si128 (_mm_max_epi16 (a, b), flip));
+    }
+    for (; i<n; i++)
+      acc[i] = in[i] > acc[i] ? in[i] : acc[i];
+  }
+
+  template <>
+  inline void MaxBuffer<char> (const char *in, char *acc, size_t n)
+  {
+    // whether char is signed or not, flipping the top bit when it is
+    // signed maps it on an unsigned byte order
+    const __m128i flip = _mm_set1_epi8 (std::numeric_limits<char>::is_signed ? static_cast<char>(0x80) : 0);
+    size_t i = 0;
+    for (; i+16<=n; i+=16)
+    {
+      __m128i a = _mm_xor_si128 (_mm_loadu_si128 (reinterpret_cast<const __m128i*>(in+i)), flip);
+      __m128i b = _mm_xor_si128 (_mm_loadu_si128 (reinterpret_cast<const __m128i*>(acc+i)), flip);
+      _mm_storeu_si128 (reinterpret_cast<__m128i*>(acc+i), _mm_xor_si128 (_mm_max_epu8 (a, b), flip));
+    }
+    for (; i<n; i++)
+      acc[i] = in[i] > acc[i] ? in[i] : acc[i];
+  }
+
+  template <>
+  inline void MaxBuffer<float> (const float *in, float *acc, size_t n)
+  {
+    size_t i = 0;
+    for (; i+4<=n; i+=4)
+      _mm_storeu_ps (acc+i, _mm_max_ps (_mm_loadu_ps (in+i), _mm_loadu_ps (acc+i)));
+    for (; i<n; i++)
+      acc[i] = in[i] > acc[i] ? in[i] : acc[i];
+  }
+#endif
+
+} // end of namespace
+
+
+#endif
@@ -0,0 +1,139 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkCommandArgumentSchema.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <string>
+
+/**
+   Command lines checked by a CommandArgumentSchema: negative numbers
+   are positional values while unknown options are rejected, options
+   need their value, required arguments must be given, defaults apply
+   to the others, and inputs produced by an earlier command need not
+   exist.
+
+   The test executable itself serves as the existing input file.
+ */
+
+namespace
+{
+  const char *MissingFile = "commandArgumentSchemaTest.missing";
+
+  itk::CommandArgumentSchema::Pointer CreateSchema()
+  {
+    itk::CommandArgumentSchema::Pointer schema = itk::CommandArgumentSchema::New();
+    schema->AddPositional ("input", itk::CommandArgumentSchema::InputFile, "image to read");
+    schema->AddPositional ("offset", itk::CommandArgumentSchema::Real, "value added", false, "0.5");
+    schema->AddOption ("-n", itk::CommandArgumentSchema::Integer, "number of iterations", false, "3");
+    schema->AddOption ("-o", itk::CommandArgumentSchema::OutputFile, "image to write", false, "out.nii");
+    schema->AddOption ("-v", itk::CommandArgumentSchema::Flag, "verbose");
+    return schema;
+  }
+
+
+  /** Parse a command line ended by 0; error is
+      the part of the message expected, empty if it must be accepted. */
+  bool Check (const char *args[], const char *error, itk::CommandArguments &arguments,
+              const std::set<std::string> *produced = 0)
+  {
+    int argc = 0;
+    while (args[argc])
+      argc++;
+
+    std::string message;
+    const bool parsed = CreateSchema()->Parse (argc, args, arguments, message, produced);
+    if (parsed==!*error && message.find (error)!=std::string::npos)
+      return true;
+
+    std::cerr << "[";
+    for (int a=0; a<argc; a++)
+      std::cerr << (a ? " " : "") << args[a];
+    std::cerr << "]: " << (parsed ? "accepted" : "rejected: " + message)
+              << ", expected " << (*error ? std::string ("\"") + error + "\"" : "success") << std::endl;
+    return false;
+  }
+}
+
+
+int main (int, char *argv[])
+{
+  const char *input = argv[0];
+  unsigned int failures = 0, runs = 0;
+  itk::CommandArguments arguments;
+
+  // defaults, and a negative number as positional value
+  {
+    const char *args[] = { input, "-2.5", 0 };
+    runs++;
+    if (!Check (args, "", arguments) || arguments.GetReal ("offset")!=-2.5 || !arguments.IsSet ("offset")
+        || arguments.GetInteger ("-n")!=3 || arguments.IsSet ("-n") || arguments.GetFlag ("-v")
+        || std::string (arguments.GetString ("-o"))!="out.nii" || std::string (arguments.GetString ("input"))!=input)
+    {
+      std::cerr << "negative offset: wrong values" << std::endl;
+      failures++;
+    }
+  }
+
+  // options in any order, between positional values
+  {
+    const char *args[] = { "-v", input, "-n", "-7", "1e3", "-o", "x.nii", 0 };
+    runs++;
+    if (!Check (args, "", arguments) || !arguments.GetFlag ("-v") || arguments.GetInteger ("-n")!=-7
+        || arguments.GetReal ("offset")!=1000.0 || std::string (arguments.GetString ("-o"))!="x.nii")
+    {
+      std::cerr << "options: wrong values" << std::endl;
+      failures++;
+    }
+  }
+
+  // rejected command lines, after the input
+  static const char *rejected[][3] = {
+    { "-x",  0,     "unknown option -x" },
+    { "-n",  0,     "-n needs a value" },
+    { "-n",  "2.5", "-n must be an integer" },
+    { "1x",  0,     "offset must be a number" },
+    { "4",   "5",   "unexpected argument 5" } };
+  for (unsigned int r=0; r<sizeof(rejected)/sizeof(rejected[0]); r++, runs++)
+  {
+    const char *args[] = { input, rejected[r][0], rejected[r][1], 0 };
+    if (!Check (args, rejected[r][2], arguments))
+      failures++;
+  }
+  {
+    const char *args[] = { 0 };
+    runs++;
+    if (!Check (args, "missing input", arguments))
+      failures++;
+  }
+
+  // inputs must exist, unless an earlier command writes them
+  {
+    const char *args[] = { MissingFile, 0 };
+    runs += 2;
+    if (!Check (args, "no file", arguments))
+      failures++;
+    std::set<std::string> produced;
+    produced.insert (MissingFile);
+    if (!Check (args, "", arguments, &produced) || std::string (arguments.GetString ("input"))!=MissingFile)
+      failures++;
+  }
+
+  std::cout << runs - failures << " of " << runs << " command lines passed" << std::endl;
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,186 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkCommandObjectFactory.h"
+#include "itkHelloWorldCommand.h"
+#include "itkHelloWorldCommandFactory.h"
+#include "itkVersion.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+/**
+   Commands registered with their description: looked up by name without
+   constructing the others, and pooled for reuse by Acquire and Release
+   when their Reset succeeds, up to the maximum of the pool. Unregistering
+   a command drops its pool.
+
+   HelloWorld can be reused; Counting, which counts its constructions,
+   cannot.
+ */
+
+namespace
+{
+  class CountingCommand : public itk::CommandObjectBase
+  {
+  public:
+    typedef CountingCommand               Self;
+    typedef itk::CommandObjectBase        Superclass;
+    typedef itk::SmartPointer<Self>       Pointer;
+    typedef itk::SmartPointer<const Self> ConstPointer;
+
+    itkNewMacro (Self);
+    itkTypeMacro (CountingCommand, CommandObjectBase);
+
+    virtual const char *GetCommandName (void)
+    { return "Counting"; }
+
+    virtual int Execute (int, const char *[])
+    { return EXIT_SUCCESS; }
+
+    static itk::CommandDescription GetStaticDescription (void)
+    {
+      itk::CommandDescription description;
+      description.Name = "Counting";
+      description.ShortDescription = "Counts its constructions";
+      description.Category = "Tests";
+      return description;
+    }
+
+    static unsigned int Constructed;
+
+  protected:
+    CountingCommand()
+    { Constructed++; }
+    ~CountingCommand() {}
+
+  private:
+    CountingCommand (const Self&);
+    void operator=(const Self&);
+  };
+
+  unsigned int CountingCommand::Constructed = 0;
+
+
+  class CountingCommandFactory : public itk::ObjectFactoryBase
+  {
+  public:
+    typedef CountingCommandFactory        Self;
+    typedef itk::ObjectFactoryBase        Superclass;
+    typedef itk::SmartPointer<Self>       Pointer;
+    typedef itk::SmartPointer<const Self> ConstPointer;
+
+    itkFactorylessNewMacro (Self);
+    itkTypeMacro (CountingCommandFactory, ObjectFactoryBase);
+
+    virtual const char *GetITKSourceVersion (void) const
+    { return ITK_SOURCE_VERSION; }
+    virtual const char *GetDescription (void) const
+    { return "Counting command"; }
+
+  protected:
+    CountingCommandFactory()
+    {
+      this->RegisterOverride ("itkCommandObjectBase", "itkCountingCommand", "Counting Command", 1,
+                              itk::CreateObjectFunction<CountingCommand>::New());
+      itk::CommandObjectFactory::RegisterCommand (CountingCommand::GetStaticDescription(),
+                                                  itk::CreateObjectFunction<CountingCommand>::New(),
+                                                  "itkCountingCommand");
+    }
+    ~CountingCommandFactory()
+    { itk::CommandObjectFactory::UnRegisterCommand ("Counting"); }
+
+  private:
+    CountingCommandFactory (const Self&);
+    void operator=(const Self&);
+  };
+
+
+  unsigned int s_Checks = 0, s_Failures = 0;
+
+  void Check (bool passed, const char *what)
+  {
+    s_Checks++;
+    if (!passed)
+    {
+      std::cerr << "failed: " << what << std::endl;
+      s_Failures++;
+    }
+  }
+}
+
+
+int main (int, char *[])
+{
+  typedef itk::CommandObjectFactory Factory;
+  itk::HelloWorldCommandFactory::RegisterOneFactory();
+  CountingCommandFactory::Pointer counting = CountingCommandFactory::New();
+  itk::ObjectFactoryBase::RegisterFactory (counting);
+
+  // lookup by name, constructing only the command requested
+  itk::CommandDescription description;
+  Check (Factory::GetCommandDescription ("HelloWorld", description) && description.Category=="Examples"
+         && description.Arguments.IsNotNull(), "description of HelloWorld");
+  Check (!Factory::GetCommandDescription ("NoSuchCommand", description), "description of an unknown command");
+  const std::vector<itk::CommandDescription> descriptions = Factory::GetCommandDescriptions();
+  Check (descriptions.size()==2 && descriptions[0].Name=="HelloWorld" && descriptions[1].Name=="Counting",
+         "descriptions by category");
+
+  itk::CommandObjectBase::Pointer hello = Factory::CreateCommandObject ("HelloWorld");
+  Check (hello.IsNotNull() && std::string (hello->GetCommandName())=="HelloWorld", "creation of HelloWorld");
+  Check (Factory::CreateCommandObject ("NoSuchCommand").IsNull(), "creation of an unknown command");
+  Check (CountingCommand::Constructed==0, "lookups constructing other commands");
+
+  const char *greet[] = { "-n", "Bob" };
+  const char *repeat[] = { "-r", "twice" };
+  itk::CommandArguments arguments;
+  std::string error;
+  Check (Factory::ParseCommandArguments ("HelloWorld", 2, greet, arguments, error)
+         && std::string (arguments.GetString ("-n"))=="Bob" && arguments.GetInteger ("-r")==1,
+         "arguments of HelloWorld");
+  Check (!Factory::ParseCommandArguments ("HelloWorld", 2, repeat, arguments, error), "wrong arguments of HelloWorld");
+
+  // released commands are reused, up to the maximum of the pool
+  Factory::SetMaximumPooledCommands (2);
+  itk::CommandObjectBase::Pointer a = Factory::AcquireCommandObject ("HelloWorld");
+  itk::CommandObjectBase::Pointer b = Factory::AcquireCommandObject ("HelloWorld");
+  itk::CommandObjectBase::Pointer c = Factory::AcquireCommandObject ("HelloWorld");
+  Check (a.IsNotNull() && b.IsNotNull() && c.IsNotNull() && a!=b && b!=c && a!=c, "acquisition from an empty pool");
+  Factory::ReleaseCommandObject (a);
+  Factory::ReleaseCommandObject (b);
+  Factory::ReleaseCommandObject (c);
+  itk::CommandObjectBase::Pointer x = Factory::AcquireCommandObject ("HelloWorld");
+  itk::CommandObjectBase::Pointer y = Factory::AcquireCommandObject ("HelloWorld");
+  itk::CommandObjectBase::Pointer z = Factory::AcquireCommandObject ("HelloWorld");
+  Check (((x==a && y==b) || (x==b && y==a)) && z.IsNotNull() && z!=a && z!=b && z!=c, "reuse of released commands");
+
+  // commands that cannot be reset are not kept
+  itk::CommandObjectBase::Pointer first = Factory::AcquireCommandObject ("Counting");
+  Factory::ReleaseCommandObject (first);
+  itk::CommandObjectBase::Pointer second = Factory::AcquireCommandObject ("Counting");
+  Check (first.IsNotNull() && second.IsNotNull() && second!=first && CountingCommand::Constructed==2,
+         "reuse of a command without Reset");
+
+  // unregistering a command drops its pool
+  Factory::ReleaseCommandObject (x);
+  Factory::UnRegisterCommand ("HelloWorld");
+  Check (!Factory::GetCommandDescription ("HelloWorld", description), "description of an unregistered command");
+  Check (Factory::AcquireCommandObject ("HelloWorld")!=x, "pool of an unregistered command");
+
+  std::cout << s_Checks - s_Failures << " of " << s_Checks << " checks passed" << std::endl;
+  return s_Failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
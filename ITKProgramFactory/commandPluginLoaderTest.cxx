@@ -0,0 +1,111 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkCommandObjectFactory.h"
+#include "itkCommandPluginLoader.h"
+
+#include <itksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+   Plugin manifest: two test plugins, PluginCommandA and PluginCommandB,
+   are scanned into the manifest with their commands; a second loader
+   then reads the manifest and loads the plugin of one command only.
+
+   Arguments: the directory of the plugins, and the manifest to write.
+ */
+
+namespace
+{
+  bool HasCommand (const std::vector<itk::CommandDescription> &descriptions, const char *name)
+  {
+    for (unsigned int i=0; i<descriptions.size(); i++)
+      if (descriptions[i].Name==name)
+        return true;
+    return false;
+  }
+
+  bool IsRegistered (const char *name)
+  {
+    itk::CommandDescription description;
+    return itk::CommandObjectFactory::GetCommandDescription (name, description);
+  }
+}
+
+
+int main (int argc, char *argv[])
+{
+  if (argc<3)
+  {
+    std::cerr << "Usage: " << argv[0] << " pluginDirectory manifest" << std::endl;
+    return EXIT_FAILURE;
+  }
+  itksys::SystemTools::RemoveFile (argv[2]);
+  unsigned int failures = 0;
+
+  // scanning lists the commands, and unloads the plugins
+  {
+    itk::CommandPluginLoader::Pointer plugins = itk::CommandPluginLoader::New();
+    plugins->AddSearchPath (argv[1]);
+    plugins->SetManifestFileName (argv[2]);
+    plugins->UpdateManifest();
+    const std::vector<itk::CommandDescription> descriptions = plugins->GetCommandDescriptions();
+    if (!HasCommand (descriptions, "PluginCommandA") || !HasCommand (descriptions, "PluginCommandB"))
+    {
+      std::cerr << "the scan did not list the commands of the plugins" << std::endl;
+      failures++;
+    }
+    if (IsRegistered ("PluginCommandA") || IsRegistered ("PluginCommandB"))
+    {
+      std::cerr << "the scan left a plugin registered" << std::endl;
+      failures++;
+    }
+  }
+
+  std::ifstream manifest (argv[2]);
+  const std::string text ((std::istreambuf_iterator<char>(manifest)), std::istreambuf_iterator<char>());
+  if (text.find ("\tPluginCommandA\t")==std::string::npos || text.find ("\tPluginCommandB\t")==std::string::npos)
+  {
+    std::cerr << "the manifest does not list the commands of the plugins:\n" << text << std::endl;
+    failures++;
+  }
+
+  // the manifest leads to the one plugin providing the command
+  {
+    itk::CommandPluginLoader::Pointer plugins = itk::CommandPluginLoader::New();
+    plugins->AddSearchPath (argv[1]);
+    plugins->SetManifestFileName (argv[2]);
+    if (!plugins->LoadCommand ("PluginCommandA")
+        || itk::CommandObjectFactory::CreateCommandObject ("PluginCommandA").IsNull())
+    {
+      std::cerr << "PluginCommandA cannot be loaded" << std::endl;
+      failures++;
+    }
+    if (IsRegistered ("PluginCommandB"))
+    {
+      std::cerr << "loading PluginCommandA also loaded the plugin of PluginCommandB" << std::endl;
+      failures++;
+    }
+  }
+
+  std::cout << (failures ? "failed" : "passed") << std::endl;
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,125 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+/**
+   Command plugin of the tests: one command, registered by its factory
+   as HelloWorldCommandFactory does, named TEST_PLUGIN_COMMAND so that
+   the plugin is built several times under different names.
+ */
+
+#include "itkCommandObjectBase.h"
+#include "itkCommandObjectFactory.h"
+#include "itkObjectFactoryBase.h"
+#include "itkVersion.h"
+
+#include <cstdlib>
+
+#ifndef TEST_PLUGIN_COMMAND
+#define TEST_PLUGIN_COMMAND "PluginCommand"
+#endif
+
+namespace itk
+{
+
+  class TestPluginCommand : public CommandObjectBase
+  {
+  public:
+    typedef TestPluginCommand        Self;
+    typedef CommandObjectBase        Superclass;
+    typedef SmartPointer<Self>       Pointer;
+    typedef SmartPointer<const Self> ConstPointer;
+
+    itkNewMacro (Self);
+    itkTypeMacro (TestPluginCommand, CommandObjectBase);
+
+    virtual const char *GetCommandName (void)
+    { return TEST_PLUGIN_COMMAND; }
+
+    virtual int Execute (int, const char *[])
+    { return EXIT_SUCCESS; }
+
+    static CommandDescription GetStaticDescription (void)
+    {
+      CommandDescription description;
+      description.Name = TEST_PLUGIN_COMMAND;
+      description.ShortDescription = "Command of a test plugin";
+      description.Category = "Tests";
+      return description;
+    }
+
+  protected:
+    TestPluginCommand() {}
+    ~TestPluginCommand() {}
+
+  private:
+    TestPluginCommand (const Self&);
+    void operator=(const Self&);
+  };
+
+
+  class TestPluginCommandFactory : public ObjectFactoryBase
+  {
+  public:
+    typedef TestPluginCommandFactory Self;
+    typedef ObjectFactoryBase        Superclass;
+    typedef SmartPointer<Self>       Pointer;
+    typedef SmartPointer<const Self> ConstPointer;
+
+    itkFactorylessNewMacro (Self);
+    itkTypeMacro (TestPluginCommandFactory, ObjectFactoryBase);
+
+    virtual const char *GetITKSourceVersion (void) const
+    { return ITK_SOURCE_VERSION; }
+    virtual const char *GetDescription (void) const
+    { return "Command plugin of the tests"; }
+
+  protected:
+    TestPluginCommandFactory()
+    {
+      this->RegisterOverride ("itkCommandObjectBase", "itkTestPluginCommand", "Test plugin command", 1,
+                              CreateObjectFunction<TestPluginCommand>::New());
+      CommandObjectFactory::RegisterCommand (TestPluginCommand::GetStaticDescription(),
+                                             CreateObjectFunction<TestPluginCommand>::New(),
+                                             "itkTestPluginCommand");
+    }
+    ~TestPluginCommandFactory()
+    {
+      CommandObjectFactory::UnRegisterCommand (TEST_PLUGIN_COMMAND);
+    }
+
+  private:
+    TestPluginCommandFactory (const Self&);
+    void operator=(const Self&);
+  };
+
+} // end of namespace
+
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+#define TEST_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define TEST_PLUGIN_EXPORT
+#endif
+
+extern "C" TEST_PLUGIN_EXPORT itk::ObjectFactoryBase *itkLoad();
+
+itk::ObjectFactoryBase *itkLoad()
+{
+  // a new reference, given to the caller
+  itk::ObjectFactoryBase::Pointer factory = itk::TestPluginCommandFactory::New();
+  factory->Register();
+  return factory.GetPointer();
+}
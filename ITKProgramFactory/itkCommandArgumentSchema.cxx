@@ -0,0 +1,322 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkCommandArgumentSchema.h"
+#include "itkSharedMemoryImageSegment.h"
+
+#include <itksys/SystemTools.hxx>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace itk
+{
+
+  namespace
+  {
+    /** Convert a value to the type of its argument; false if it is not one. */
+    bool ConvertValue (const char *text, CommandArgumentSchema::ArgumentType type,
+                       long &integer, double &real)
+    {
+      char *end = 0;
+      errno = 0;
+      switch (type)
+      {
+        case CommandArgumentSchema::Integer:
+          integer = strtol (text, &end, 10);
+          real = integer;
+          return *text && !*end && errno==0;
+        case CommandArgumentSchema::Real:
+          real = strtod (text, &end);
+          integer = static_cast<long>(real);
+          return *text && !*end && errno==0;
+        case CommandArgumentSchema::InputFile:
+          if (SharedMemoryImageSegment::IsSharedMemoryName (text))
+            return SharedMemoryImageSegment::Exists (text);
+          return itksys::SystemTools::FileExists (text);
+        default:
+          return true;
+      }
+    }
+  }
+
+
+  CommandArgumentSchema::CommandArgumentSchema()
+  {}
+
+
+  CommandArgumentSchema::~CommandArgumentSchema()
+  {}
+
+
+  void CommandArgumentSchema::AddOption (const char *name, ArgumentType type, const char *description,
+                                         bool required, const char *defaultValue)
+  {
+    Argument argument;
+    argument.Name        = name;
+    argument.Type        = type;
+    argument.Positional  = false;
+    argument.Required    = required && type!=Flag;
+    argument.Default     = defaultValue;
+    argument.Description = description;
+    m_Arguments.push_back (argument);
+    this->Modified();
+  }
+
+
+  void CommandArgumentSchema::AddPositional (const char *name, ArgumentType type, const char *description,
+                                             bool required, const char *defaultValue)
+  {
+    Argument argument;
+    argument.Name        = name;
+    argument.Type        = type==Flag ? String : type;
+    argument.Positional  = true;
+    argument.Required    = required;
+    argument.Default     = defaultValue;
+    argument.Description = description;
+    m_Arguments.push_back (argument);
+    this->Modified();
+  }
+
+
+  int CommandArgumentSchema::FindArgument (const char *name) const
+  {
+    for (unsigned int i=0; i<m_Arguments.size(); i++)
+      if (m_Arguments[i].Name==name)
+        return static_cast<int>(i);
+    return -1;
+  }
+
+
+  std::string CommandArgumentSchema::QuoteJSON (const std::string &text)
+  {
+    std::string quoted ("\"");
+    for (unsigned int i=0; i<text.size(); i++)
+    {
+      const char c = text[i];
+      if (c=='"' || c=='\\')
+        quoted += std::string ("\\") + c;
+      else if (c=='\n')
+        quoted += "\\n";
+      else if (static_cast<unsigned char>(c) < 0x20)
+        quoted += ' ';
+      else
+        quoted += c;
+    }
+    return quoted + "\"";
+  }
+
+
+  const char *CommandArgumentSchema::GetTypeName (ArgumentType type)
+  {
+    switch (type)
+    {
+      case Flag:       return "flag";
+      case Integer:    return "integer";
+      case Real:       return "real";
+      case String:     return "string";
+      case InputFile:  return "input-file";
+      case OutputFile: return "output-file";
+    }
+    return "unknown";
+  }
+
+
+  bool CommandArgumentSchema::Parse (int argc, const char *argv[], CommandArguments &arguments,
+                                     std::string &error, const std::set<std::string> *produced) const
+  {
+    arguments.m_Schema = this;
+    arguments.m_Values.resize (m_Arguments.size());
+    for (unsigned int i=0; i<m_Arguments.size(); i++)
+    {
+      CommandArguments::Value &value = arguments.m_Values[i];
+      value.Text    = m_Arguments[i].Default.c_str();
+      value.Integer = 0;
+      value.Real    = 0.0;
+      value.Set     = false;
+      ConvertValue (value.Text, m_Arguments[i].Type==InputFile ? String : m_Arguments[i].Type,
+                    value.Integer, value.Real);
+    }
+
+    unsigned int positional = 0;
+    for (int a=0; a<argc; a++)
+    {
+      // negative numbers are positional values, not options
+      const int option = argv[a][0]=='-' ? this->FindArgument (argv[a]) : -1;
+      long integer;
+      double real;
+      if (argv[a][0]=='-' && argv[a][1] && option<0 && !ConvertValue (argv[a], Real, integer, real))
+      {
+        error = std::string ("unknown option ") + argv[a];
+        return false;
+      }
+
+      int index = option;
+      const char *text = argv[a];
+      if (index>=0 && m_Arguments[index].Positional)
+        index = -1;
+      if (index>=0)
+      {
+        if (m_Arguments[index].Type!=Flag)
+        {
+          if (a+1>=argc)
+          {
+            error = m_Arguments[index].Name + " needs a value";
+            return false;
+          }
+          text = argv[++a];
+        }
+      }
+      else
+      {
+        while (positional<m_Arguments.size() && !m_Arguments[positional].Positional)
+          positional++;
+        if (positional>=m_Arguments.size())
+        {
+          error = std::string ("unexpected argument ") + argv[a];
+          return false;
+        }
+        index = positional++;
+      }
+
+      CommandArguments::Value &value = arguments.m_Values[index];
+      value.Text = text;
+      value.Set  = true;
+      if (m_Arguments[index].Type==Flag)
+        value.Integer = 1;
+      else if (m_Arguments[index].Type==InputFile && produced && produced->count (text))
+        continue;
+      else if (!ConvertValue (text, m_Arguments[index].Type, value.Integer, value.Real))
+      {
+        error = m_Arguments[index].Type==InputFile ? std::string ("no file ") + text
+          : m_Arguments[index].Name + " must be " + (m_Arguments[index].Type==Integer ? "an integer" : "a number")
+          + ", not " + text;
+        return false;
+      }
+    }
+
+    for (unsigned int i=0; i<m_Arguments.size(); i++)
+    {
+      if (m_Arguments[i].Required && !arguments.m_Values[i].Set)
+      {
+        error = "missing " + m_Arguments[i].Name;
+        return false;
+      }
+    }
+    return true;
+  }
+
+
+  void CommandArgumentSchema::WriteUsage (std::ostream &os, const char *commandName) const
+  {
+    os << commandName;
+    for (unsigned int i=0; i<m_Arguments.size(); i++)
+    {
+      const Argument &argument = m_Arguments[i];
+      os << " " << (argument.Required ? "" : "[");
+      if (argument.Positional)
+        os << argument.Name;
+      else if (argument.Type==Flag)
+        os << argument.Name;
+      else
+        os << argument.Name << " " << GetTypeName (argument.Type);
+      os << (argument.Required ? "" : "]");
+    }
+    os << std::endl;
+    for (unsigned int i=0; i<m_Arguments.size(); i++)
+    {
+      const Argument &argument = m_Arguments[i];
+      os << "  " << argument.Name << ": " << argument.Description;
+      if (!argument.Default.empty())
+        os << " (default: " << argument.Default << ")";
+      os << std::endl;
+    }
+  }
+
+
+  void CommandArgumentSchema::WriteJSON (std::ostream &os) const
+  {
+    os << "[";
+    for (unsigned int i=0; i<m_Arguments.size(); i++)
+    {
+      const Argument &argument = m_Arguments[i];
+      os << (i ? ", " : "") << "{\"name\": " << QuoteJSON (argument.Name)
+         << ", \"type\": \"" << GetTypeName (argument.Type) << "\""
+         << ", \"positional\": " << (argument.Positional ? "true" : "false")
+         << ", \"required\": " << (argument.Required ? "true" : "false")
+         << ", \"default\": " << QuoteJSON (argument.Default)
+         << ", \"description\": " << QuoteJSON (argument.Description) << "}";
+    }
+    os << "]";
+  }
+
+
+  void CommandArgumentSchema::PrintSelf (std::ostream &os, Indent indent) const
+  {
+    Superclass::PrintSelf (os, indent);
+    os << indent << "NumberOfArguments: " << m_Arguments.size() << std::endl;
+  }
+
+
+  CommandArguments::CommandArguments()
+  {}
+
+
+  const CommandArguments::Value *CommandArguments::Find (const char *name) const
+  {
+    if (m_Schema.IsNull())
+      return 0;
+    const int index = m_Schema->FindArgument (name);
+    return index<0 ? 0 : &m_Values[index];
+  }
+
+
+  bool CommandArguments::IsSet (const char *name) const
+  {
+    const Value *value = this->Find (name);
+    return value && value->Set;
+  }
+
+
+  const char *CommandArguments::GetString (const char *name) const
+  {
+    const Value *value = this->Find (name);
+    return value ? value->Text : 0;
+  }
+
+
+  long CommandArguments::GetInteger (const char *name) const
+  {
+    const Value *value = this->Find (name);
+    return value ? value->Integer : 0;
+  }
+
+
+  double CommandArguments::GetReal (const char *name) const
+  {
+    const Value *value = this->Find (name);
+    return value ? value->Real : 0.0;
+  }
+
+
+  bool CommandArguments::GetFlag (const char *name) const
+  {
+    const Value *value = this->Find (name);
+    return value && value->Set;
+  }
+
+} // end of namespace
@@ -0,0 +1,162 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_CommandArgumentSchema_h_
+#define _itk_CommandArgumentSchema_h_
+
+#include "itkObject.h"
+
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+   Typed arguments of a command, declared once and registered with its
+   CommandDescription, so that the driver checks and converts a command
+   line before the command is constructed, and describes it in --help-json.
+
+   Options are named (-s value, or -v for flags), positional arguments
+   are the others, in order. Values are checked against their type:
+   integers and reals must be whole numbers, input files must exist,
+   as files or shm://name shared memory images, unless an earlier command
+   of the pipeline writes them.
+   CommandArguments then gives the command its values without copying
+   the command line, which must outlive it.
+ */
+
+namespace itk
+{
+
+  class CommandArguments;
+
+  class CommandArgumentSchema : public Object
+  {
+  public:
+    typedef CommandArgumentSchema    Self;
+    typedef Object                   Superclass;
+    typedef SmartPointer<Self>       Pointer;
+    typedef SmartPointer<const Self> ConstPointer;
+
+    itkNewMacro (Self);
+    itkTypeMacro (CommandArgumentSchema, Object);
+
+    typedef enum
+    {
+      Flag,
+      Integer,
+      Real,
+      String,
+      InputFile,
+      OutputFile
+    } ArgumentType;
+
+    struct Argument
+    {
+      std::string  Name;
+      ArgumentType Type;
+      bool         Positional;
+      bool         Required;
+      std::string  Default;
+      std::string  Description;
+    };
+
+    /** Named option, and positional argument. */
+    void AddOption (const char *name, ArgumentType type, const char *description,
+                    bool required = false, const char *defaultValue = "");
+    void AddPositional (const char *name, ArgumentType type, const char *description,
+                        bool required = true, const char *defaultValue = "");
+
+    const std::vector<Argument> &GetArguments (void) const
+    { return m_Arguments; }
+
+    /** Index of an argument, -1 if it is not declared. */
+    int FindArgument (const char *name) const;
+
+    /** Check and convert the arguments of a command, without its name;
+        on failure error tells why. Input files among produced, such as
+        the output files of the earlier commands of a pipeline, need not
+        exist yet. */
+    bool Parse (int argc, const char *argv[], CommandArguments &arguments, std::string &error,
+                const std::set<std::string> *produced = 0) const;
+
+    /** One line usage, and a JSON object describing the arguments. */
+    void WriteUsage (std::ostream &os, const char *commandName) const;
+    void WriteJSON (std::ostream &os) const;
+
+    static const char *GetTypeName (ArgumentType type);
+
+    /** Text as a JSON string, quotes included. */
+    static std::string QuoteJSON (const std::string &text);
+
+  protected:
+    CommandArgumentSchema();
+    ~CommandArgumentSchema();
+
+    void PrintSelf (std::ostream &os, Indent indent) const;
+
+  private:
+    CommandArgumentSchema (const Self&);
+    void operator=(const Self&);
+
+    std::vector<Argument> m_Arguments;
+  };
+
+
+  /**
+     Values of a command line checked by a CommandArgumentSchema: the
+     strings point into the command line, or into the schema for the
+     defaults.
+   */
+  class CommandArguments
+  {
+  public:
+    CommandArguments();
+
+    /** Whether the arguments were checked against a schema. */
+    bool IsValid (void) const
+    { return m_Schema.IsNotNull(); }
+
+    /** Whether the argument was given on the command line. */
+    bool IsSet (const char *name) const;
+
+    /** Value given, else the default; 0, 0 or false if there is none, or
+        the argument is not declared. */
+    const char *GetString (const char *name) const;
+    long GetInteger (const char *name) const;
+    double GetReal (const char *name) const;
+    bool GetFlag (const char *name) const;
+
+  private:
+    friend class CommandArgumentSchema;
+
+    struct Value
+    {
+      const char *Text;
+      long        Integer;
+      double      Real;
+      bool        Set;
+    };
+
+    const Value *Find (const char *name) const;
+
+    CommandArgumentSchema::ConstPointer m_Schema;
+    std::vector<Value>                  m_Values;
+  };
+
+} // end of namespace
+
+#endif
@@ -0,0 +1,260 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkCommandBatchExecutor.h"
+#include "itkCommandObjectFactory.h"
+
+#include <itksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+
+namespace itk
+{
+
+  namespace
+  {
+    /** Split a job line into arguments, double quotes grouping spaces. */
+    std::vector<std::string> SplitJobLine (const std::string &line)
+    {
+      std::vector<std::string> arguments;
+      std::string argument;
+      bool quoted = false, started = false;
+      for (unsigned int i=0; i<line.size(); i++)
+      {
+        const char c = line[i];
+        if (c=='"')
+        {
+          quoted = !quoted;
+          started = true;
+        }
+        else if (!quoted && (c==' ' || c=='\t' || c=='\r'))
+        {
+          if (started)
+            arguments.push_back (argument);
+          argument.clear();
+          started = false;
+        }
+        else
+        {
+          argument += c;
+          started = true;
+        }
+      }
+      if (started)
+        arguments.push_back (argument);
+      return arguments;
+    }
+  }
+
+
+  CommandBatchExecutor::CommandBatchExecutor()
+  {
+    m_ExecutableName = "programFactoryTest";
+    m_ThreadBudget = MultiThreader::GetGlobalDefaultNumberOfThreads();
+    m_NumberOfConcurrentJobs = 0;
+    m_Seconds = 0.0;
+    m_NextJob = 0;
+  }
+
+
+  CommandBatchExecutor::~CommandBatchExecutor()
+  {}
+
+
+  bool CommandBatchExecutor::ReadJobFile (const std::string &filename)
+  {
+    std::ifstream file (filename.c_str());
+    if (!file)
+      return false;
+    std::string line;
+    while (std::getline (file, line))
+    {
+      std::vector<std::string> arguments = SplitJobLine (line);
+      if (!arguments.empty() && arguments[0][0]!='#')
+        this->AddJob (arguments);
+    }
+    return true;
+  }
+
+
+  void CommandBatchExecutor::AddJob (const std::vector<std::string> &arguments)
+  {
+    Job job;
+    job.Arguments = arguments;
+    job.ExitCode  = EXIT_SUCCESS;
+    job.Seconds   = 0.0;
+    m_Jobs.push_back (job);
+    this->Modified();
+  }
+
+
+  void CommandBatchExecutor::ClearJobs (void)
+  {
+    m_Jobs.clear();
+    this->Modified();
+  }
+
+
+  void CommandBatchExecutor::RunJob (Job &job) const
+  {
+    const double start = itksys::SystemTools::GetTime();
+    try
+    {
+      std::vector<const char*> args;
+      args.push_back (m_ExecutableName.c_str());
+      for (unsigned int i=0; i<job.Arguments.size(); i++)
+        args.push_back (job.Arguments[i].c_str());
+
+      // bad arguments fail the job before a command is built
+      CommandArguments arguments;
+      if (!CommandObjectFactory::ParseCommandArguments (args[1], static_cast<int>(args.size())-2, &args[0]+2,
+                                                        arguments, job.Error))
+      {
+        job.ExitCode = EXIT_FAILURE;
+        job.Seconds = itksys::SystemTools::GetTime() - start;
+        return;
+      }
+
+      // jobs of the same command reuse the commands released by the previous ones
+      CommandObjectBase::Pointer command = CommandObjectFactory::AcquireCommandObject (args[1]);
+      if (command.IsNull())
+      {
+        job.ExitCode = EXIT_FAILURE;
+        job.Error = "unknown command " + job.Arguments[0];
+      }
+      else
+      {
+        command->SetArguments (arguments);
+        job.ExitCode = command->Execute (static_cast<int>(args.size()), &args[0]);
+        CommandObjectFactory::ReleaseCommandObject (command);
+      }
+    }
+    catch (ExceptionObject &e)
+    {
+      job.ExitCode = EXIT_FAILURE;
+      job.Error = e.GetDescription();
+    }
+    catch (std::exception &e)
+    {
+      job.ExitCode = EXIT_FAILURE;
+      job.Error = e.what();
+    }
+    job.Seconds = itksys::SystemTools::GetTime() - start;
+  }
+
+
+  ITK_THREAD_RETURN_TYPE CommandBatchExecutor::RunJobs (void *arg)
+  {
+    MultiThreader::ThreadInfoStruct *info = static_cast<MultiThreader::ThreadInfoStruct*>(arg);
+    Self *self = static_cast<Self*>(info->UserData);
+
+    for (;;)
+    {
+      self->m_NextJobLock.Lock();
+      const unsigned int next = self->m_NextJob++;
+      self->m_NextJobLock.Unlock();
+      if (next>=self->m_Jobs.size())
+        break;
+      self->RunJob (self->m_Jobs[next]);
+    }
+    return ITK_THREAD_RETURN_VALUE;
+  }
+
+
+  unsigned int CommandBatchExecutor::Run (void)
+  {
+    if (m_Jobs.empty())
+      return 0;
+
+    // plugins are loaded up front: loading is not thread safe
+    if (m_PluginLoader)
+    {
+      std::set<std::string> names;
+      for (unsigned int i=0; i<m_Jobs.size(); i++)
+        names.insert (m_Jobs[i].Arguments[0]);
+      CommandDescription description;
+      for (std::set<std::string>::const_iterator it=names.begin(); it!=names.end(); ++it)
+        if (!CommandObjectFactory::GetCommandDescription (it->c_str(), description))
+          m_PluginLoader->LoadCommand (it->c_str());
+    }
+
+    const unsigned int budget = std::max (m_ThreadBudget, 1u);
+    unsigned int concurrent = m_NumberOfConcurrentJobs ? m_NumberOfConcurrentJobs : budget;
+    concurrent = std::min<unsigned int> (concurrent, m_Jobs.size());
+    concurrent = std::min<unsigned int> (concurrent, MultiThreader::GetGlobalMaximumNumberOfThreads());
+    concurrent = std::max (concurrent, 1u);
+
+    // the filters of the jobs get their share of the budget
+    const int defaultThreads = MultiThreader::GetGlobalDefaultNumberOfThreads();
+    MultiThreader::SetGlobalDefaultNumberOfThreads (std::max (budget / concurrent, 1u));
+
+    // a pooled command per thread and per command name
+    const unsigned int pooled = CommandObjectFactory::GetMaximumPooledCommands();
+    CommandObjectFactory::SetMaximumPooledCommands (std::max (pooled, concurrent));
+
+    const double start = itksys::SystemTools::GetTime();
+    m_NextJob = 0;
+    MultiThreader::Pointer threader = MultiThreader::New();
+    threader->SetNumberOfThreads (concurrent);
+    threader->SetSingleMethod (RunJobs, this);
+    threader->SingleMethodExecute();
+    m_Seconds = itksys::SystemTools::GetTime() - start;
+
+    MultiThreader::SetGlobalDefaultNumberOfThreads (defaultThreads);
+    CommandObjectFactory::SetMaximumPooledCommands (pooled);
+
+    unsigned int failures = 0;
+    for (unsigned int i=0; i<m_Jobs.size(); i++)
+      if (m_Jobs[i].ExitCode!=EXIT_SUCCESS)
+        failures++;
+    return failures;
+  }
+
+
+  void CommandBatchExecutor::WriteSummary (std::ostream &os) const
+  {
+    unsigned int failures = 0;
+    double seconds = 0.0;
+    for (unsigned int i=0; i<m_Jobs.size(); i++)
+    {
+      const Job &job = m_Jobs[i];
+      os << i << '\t' << job.ExitCode << '\t' << job.Seconds << '\t';
+      for (unsigned int a=0; a<job.Arguments.size(); a++)
+        os << (a ? " " : "") << job.Arguments[a];
+      if (!job.Error.empty())
+        os << '\t' << job.Error;
+      os << '\n';
+      if (job.ExitCode!=EXIT_SUCCESS)
+        failures++;
+      seconds += job.Seconds;
+    }
+    os << "# " << m_Jobs.size() << " jobs, " << failures << " failed, "
+       << seconds << " s of jobs in " << m_Seconds << " s" << std::endl;
+  }
+
+
+  void CommandBatchExecutor::PrintSelf (std::ostream &os, Indent indent) const
+  {
+    Superclass::PrintSelf (os, indent);
+    os << indent << "NumberOfJobs: " << m_Jobs.size() << std::endl;
+    os << indent << "ExecutableName: " << m_ExecutableName << std::endl;
+    os << indent << "ThreadBudget: " << m_ThreadBudget << std::endl;
+    os << indent << "NumberOfConcurrentJobs: " << m_NumberOfConcurrentJobs << std::endl;
+  }
+
+} // end of namespace
@@ -0,0 +1,125 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_CommandBatchExecutor_h_
+#define _itk_CommandBatchExecutor_h_
+
+#include "itkObject.h"
+#include "itkMultiThreader.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkCommandPluginLoader.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+   Run many commands concurrently, each job being one command and its
+   arguments, as on the command line of the driver.
+
+   Jobs are read from a file, one per line: the command name, then its
+   arguments, separated by white space, double quotes grouping an
+   argument with spaces; empty lines and lines starting with # are
+   skipped. The threads of a MultiThreader take the next job from a
+   shared counter as soon as they finish one, so that long jobs do not
+   hold the others back.
+
+   The threads share one budget with the filters the commands run: with
+   J concurrent jobs, the global default number of ITK threads is the
+   budget divided by J for the duration of the batch.
+ */
+
+namespace itk
+{
+
+  class CommandBatchExecutor : public Object
+  {
+  public:
+    typedef CommandBatchExecutor     Self;
+    typedef Object                   Superclass;
+    typedef SmartPointer<Self>       Pointer;
+    typedef SmartPointer<const Self> ConstPointer;
+
+    itkNewMacro (Self);
+    itkTypeMacro (CommandBatchExecutor, Object);
+
+    /** A job, and how it ran. */
+    struct Job
+    {
+      std::vector<std::string> Arguments;
+      int                      ExitCode;
+      double                   Seconds;
+      std::string              Error;
+    };
+
+    /** Read the jobs of a job file; false if it cannot be read. */
+    bool ReadJobFile (const std::string &filename);
+    void AddJob (const std::vector<std::string> &arguments);
+    void ClearJobs (void);
+    const std::vector<Job> &GetJobs (void) const
+    { return m_Jobs; }
+
+    /** Executable name given as first argument to the commands. */
+    itkSetStringMacro (ExecutableName);
+    itkGetStringMacro (ExecutableName);
+
+    /** Threads shared by the jobs and their filters (default: the global
+        default number of ITK threads). */
+    itkSetMacro (ThreadBudget, unsigned int);
+    itkGetConstMacro (ThreadBudget, unsigned int);
+
+    /** Jobs run at once (0: as many as the budget). */
+    itkSetMacro (NumberOfConcurrentJobs, unsigned int);
+    itkGetConstMacro (NumberOfConcurrentJobs, unsigned int);
+
+    /** Plugins to load the commands from, before the jobs start. */
+    itkSetObjectMacro (PluginLoader, CommandPluginLoader);
+
+    /** Run every job; returns the number of jobs that failed. */
+    unsigned int Run (void);
+
+    /** One line per job: number, exit code, seconds, command line, and
+        the error if any, then the totals. */
+    void WriteSummary (std::ostream &os) const;
+
+  protected:
+    CommandBatchExecutor();
+    ~CommandBatchExecutor();
+
+    void PrintSelf (std::ostream &os, Indent indent) const;
+
+  private:
+    CommandBatchExecutor (const Self&);
+    void operator=(const Self&);
+
+    static ITK_THREAD_RETURN_TYPE RunJobs (void *arg);
+    void RunJob (Job &job) const;
+
+    std::vector<Job>              m_Jobs;
+    std::string                   m_ExecutableName;
+    unsigned int                  m_ThreadBudget;
+    unsigned int                  m_NumberOfConcurrentJobs;
+    CommandPluginLoader::Pointer  m_PluginLoader;
+    double                        m_Seconds;
+
+    /** Next job to run, taken by the threads under the lock. */
+    unsigned int                  m_NextJob;
+    SimpleFastMutexLock           m_NextJobLock;
+  };
+
+} // end of namespace
+
+#endif
@@ -15,6 +15,7 @@
 
 =========================================================================*/
 #include "itkCommandObjectBase.h"
+#include "itkCommandObjectFactory.h"
 
 namespace itk
 {
@@ -36,5 +37,76 @@ namespace itk
   {
     return m_LongDescription.c_str();
   }
+
+
+  void CommandObjectBase::SetPipelineInput (DataObject *input)
+  {
+    m_PipelineInput = input;
+  }
+
+  DataObject *CommandObjectBase::GetPipelineInput (void) const
+  {
+    return m_PipelineInput.GetPointer();
+  }
+
+  DataObject *CommandObjectBase::GetPipelineOutput (void) const
+  {
+    return m_PipelineOutput.GetPointer();
+  }
+
+  void CommandObjectBase::SetPipelineOutput (DataObject *output)
+  {
+    m_PipelineOutput = output;
+  }
+
+
+  bool CommandObjectBase::Reset (void)
+  {
+    m_PipelineInput = 0;
+    m_PipelineOutput = 0;
+    m_FilterObserver = 0;
+    m_Arguments = CommandArguments();
+    return false;
+  }
+
+
+  void CommandObjectBase::SetFilterObserver (Command *observer)
+  {
+    m_FilterObserver = observer;
+  }
+
+  void CommandObjectBase::ObserveFilter (ProcessObject *filter)
+  {
+    if (!m_FilterObserver || !filter)
+      return;
+    filter->AddObserver (StartEvent(), m_FilterObserver);
+    filter->AddObserver (EndEvent(), m_FilterObserver);
+    filter->AddObserver (ProgressEvent(), m_FilterObserver);
+  }
+
+
+  void CommandObjectBase::SetArguments (const CommandArguments &arguments)
+  {
+    m_Arguments = arguments;
+  }
+
+  const CommandArguments &CommandObjectBase::GetArguments (void) const
+  {
+    return m_Arguments;
+  }
+
+  bool CommandObjectBase::CheckArguments (int nargs, const char *args[])
+  {
+    if (m_Arguments.IsValid() || nargs<2)
+      return true;
+    std::string error;
+    if (!CommandObjectFactory::ParseCommandArguments (this->GetCommandName(), nargs-2, args+2,
+                                                      m_Arguments, error))
+    {
+      std::cerr << "Error: " << this->GetCommandName() << ": " << error << std::endl;
+      return false;
+    }
+    return true;
+  }
   
 }
@@ -19,12 +19,30 @@
 
 
 #include "itkProcessObject.h"
+#include "itkDataObject.h"
+#include "itkCommand.h"
+#include "itkCommandArgumentSchema.h"
+
+#include <string>
 /**
  */
 
 namespace itk
 {
 
+  /** What a command factory tells about a command without constructing it. */
+  struct CommandDescription
+  {
+    std::string Name;
+    std::string ShortDescription;
+    std::string LongDescription;
+    std::string Category;
+
+    /** Arguments of the command, checked by the driver before it
+        constructs the command; none for commands parsing their own. */
+    CommandArgumentSchema::ConstPointer Arguments;
+  };
+
   class CommandObjectBase : public ProcessObject
   {
   public:
@@ -41,13 +59,65 @@ namespace itk
 
     virtual int Execute (int nargs, const char *args[]) = 0;
 
+    /** Arguments checked by the driver against the schema of the
+        command description, set before Execute; a command reads their
+        values instead of parsing args. */
+    void SetArguments (const CommandArguments &arguments);
+    const CommandArguments &GetArguments (void) const;
+
+    /** Reuse contract: a command that can be executed again forgets its
+        last execution (arguments, results, pipeline data) and keeps what
+        it built, such as its filters and their buffers, then returns
+        true. Commands overriding it call this implementation, which
+        drops the pipeline data and the filter observer and returns false:
+        by default a command is not reused. */
+    virtual bool Reset (void);
+
+    /** In-memory handoff between the commands of a pipeline run in one
+        process: the driver gives each command the pipeline output of the
+        previous one, to read instead of its input file. Commands that
+        support it set their output, disconnected from the filters that
+        produced it (DataObject::DisconnectPipeline), during Execute. */
+    void SetPipelineInput (DataObject *input);
+    DataObject *GetPipelineInput (void) const;
+    DataObject *GetPipelineOutput (void) const;
+
+    /** Pipeline input as the data type a command reads, 0 if there is
+        none or it is of another type. */
+    template <class TData> TData *GetPipelineInputAs (void) const
+    { return dynamic_cast<TData*>(m_PipelineInput.GetPointer()); }
+
+    /** Observer of the StartEvent, EndEvent and ProgressEvent of the
+        filters the command runs, such as a CommandProfiler; set before
+        Execute. */
+    void SetFilterObserver (Command *observer);
+
   protected:
     CommandObjectBase();
     ~CommandObjectBase();
+
+    void SetPipelineOutput (DataObject *output);
+
+    /** Let the filter observer, if any, watch a filter of the command. */
+    void ObserveFilter (ProcessObject *filter);
+
+    /** For commands executed without the driver: check args against the
+        schema of the command, unless the driver did, reporting errors on
+        std::cerr. */
+    bool CheckArguments (int nargs, const char *args[]);
 	  
 	std::string m_ShortDescription;
 	std::string m_LongDescription;
 
+    /** Held here rather than as the inputs and outputs of the process
+        object, which would make the command their source. */
+    DataObject::Pointer m_PipelineInput;
+    DataObject::Pointer m_PipelineOutput;
+
+    Command::Pointer    m_FilterObserver;
+
+    CommandArguments    m_Arguments;
+
 
   private:
     CommandObjectBase (const Self&);
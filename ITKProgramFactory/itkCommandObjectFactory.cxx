@@ -18,16 +18,248 @@
 
 #include "itkMutexLock.h"
 #include "itkMutexLockHolder.h"
+#include "itkSimpleFastMutexLock.h"
+
+#include <itksys/hash_map.hxx>
 
 #include <algorithm>
+#include <set>
 #include <string.h>
 
 namespace itk
 {
 
+namespace
+{
+
+struct CommandEntry
+{
+  CommandDescription                Description;
+  CreateObjectFunctionBase::Pointer Creator;
+  std::string                       OverrideClassName;
+};
+
+struct CommandNameHash
+{
+  size_t operator()(const std::string &name) const
+  {
+    return itksys::hash<const char*>()(name.c_str());
+  }
+};
+
+typedef itksys::hash_map<std::string, CommandEntry, CommandNameHash> CommandIndexType;
+
+/** Built as the factories register, possibly from static initializers
+    of other libraries: both are created on first use. They are never
+    destroyed, since factories are unregistered (and UnRegisterCommand
+    called) by ITK's own cleanup, which may run after local statics of
+    this file have gone. */
+CommandIndexType &GetCommandIndex()
+{
+  static CommandIndexType *index = new CommandIndexType;
+  return *index;
+}
+
+SimpleFastMutexLock &GetCommandIndexLock()
+{
+  static SimpleFastMutexLock *lock = new SimpleFastMutexLock;
+  return *lock;
+}
+
+/** Commands released for reuse, by name; they are given back by
+    AcquireCommandObject, and dropped with the command when unregistered.
+    Never destroyed, like the index. */
+typedef itksys::hash_map<std::string, std::vector<CommandObjectBase::Pointer>, CommandNameHash> CommandPoolType;
+
+CommandPoolType &GetCommandPool()
+{
+  static CommandPoolType *pool = new CommandPoolType;
+  return *pool;
+}
+
+unsigned int s_MaximumPooledCommands = 4;
+
+/** Whether some registered factory overrides itkCommandObjectBase with a
+    class no command was indexed for: the legacy scan, which constructs
+    every command, is only needed then. */
+bool HasUnindexedCommands()
+{
+  std::set<std::string> indexed;
+  {
+    MutexLockHolder<SimpleFastMutexLock> holder(GetCommandIndexLock());
+    for(CommandIndexType::const_iterator it = GetCommandIndex().begin();
+        it != GetCommandIndex().end(); ++it)
+      {
+      indexed.insert(it->second.OverrideClassName);
+      }
+  }
+  std::list<ObjectFactoryBase*> factories = ObjectFactoryBase::GetRegisteredFactories();
+  for(std::list<ObjectFactoryBase*>::iterator f = factories.begin();
+      f != factories.end(); ++f)
+    {
+    // parallel lists, one entry per override
+    std::list<std::string> names = (*f)->GetClassOverrideNames();
+    std::list<std::string> classes = (*f)->GetClassOverrideWithNames();
+    std::list<std::string>::const_iterator c = classes.begin();
+    for(std::list<std::string>::const_iterator n = names.begin();
+        n != names.end() && c != classes.end(); ++n, ++c)
+      {
+      if(*n == "itkCommandObjectBase" && indexed.find(*c) == indexed.end())
+        {
+        return true;
+        }
+      }
+    }
+  return false;
+}
+
+}
+
+
+bool
+CommandObjectFactory::CommandDescriptionLess(const CommandDescription& a, const CommandDescription& b)
+{
+  return a.Category < b.Category || (a.Category == b.Category && a.Name < b.Name);
+}
+
+
+void
+CommandObjectFactory::RegisterCommand(const CommandDescription& description, CreateObjectFunctionBase* creator,
+                                      const char* overrideClassName)
+{
+  MutexLockHolder<SimpleFastMutexLock> holder(GetCommandIndexLock());
+  CommandEntry &entry = GetCommandIndex()[description.Name];
+  entry.Description = description;
+  entry.Creator = creator;
+  entry.OverrideClassName = overrideClassName ? overrideClassName : "";
+}
+
+
+void
+CommandObjectFactory::UnRegisterCommand(const char* name)
+{
+  // pooled commands may come from a plugin about to be unloaded
+  std::vector<CommandObjectBase::Pointer> pooled;
+  {
+    MutexLockHolder<SimpleFastMutexLock> holder(GetCommandIndexLock());
+    GetCommandIndex().erase(name);
+    CommandPoolType::iterator it = GetCommandPool().find(name);
+    if(it != GetCommandPool().end())
+      {
+      pooled.swap(it->second);
+      GetCommandPool().erase(it);
+      }
+  }
+}
+
+
+CommandObjectBase::Pointer
+CommandObjectFactory::AcquireCommandObject(const char* name)
+{
+  {
+    MutexLockHolder<SimpleFastMutexLock> holder(GetCommandIndexLock());
+    CommandPoolType::iterator it = GetCommandPool().find(name);
+    if(it != GetCommandPool().end() && !it->second.empty())
+      {
+      CommandObjectBase::Pointer command = it->second.back();
+      it->second.pop_back();
+      return command;
+      }
+  }
+  return CreateCommandObject(name);
+}
+
+
+void
+CommandObjectFactory::ReleaseCommandObject(CommandObjectBase* command)
+{
+  // reset outside of the lock, and destroyed there if not kept
+  CommandObjectBase::Pointer kept = command;
+  if(!command || !command->Reset())
+    {
+    return;
+    }
+  const std::string name = command->GetCommandName();
+  MutexLockHolder<SimpleFastMutexLock> holder(GetCommandIndexLock());
+  if(!GetCommandIndex().count(name))
+    {
+    return;
+    }
+  std::vector<CommandObjectBase::Pointer> &pool = GetCommandPool()[name];
+  if(pool.size() < s_MaximumPooledCommands)
+    {
+    pool.push_back(kept);
+    }
+}
+
+
+void
+CommandObjectFactory::SetMaximumPooledCommands(unsigned int maximum)
+{
+  // the commands dropped are destroyed once the lock is released
+  std::vector<CommandObjectBase::Pointer> dropped;
+  MutexLockHolder<SimpleFastMutexLock> holder(GetCommandIndexLock());
+  s_MaximumPooledCommands = maximum;
+  for(CommandPoolType::iterator it = GetCommandPool().begin();
+      it != GetCommandPool().end(); ++it)
+    {
+    if(it->second.size() > maximum)
+      {
+      dropped.insert(dropped.end(), it->second.begin() + maximum, it->second.end());
+      it->second.resize(maximum);
+      }
+    }
+}
+
+
+unsigned int
+CommandObjectFactory::GetMaximumPooledCommands()
+{
+  MutexLockHolder<SimpleFastMutexLock> holder(GetCommandIndexLock());
+  return s_MaximumPooledCommands;
+}
+
+
+void
+CommandObjectFactory::ClearCommandPool()
+{
+  CommandPoolType pool;
+  MutexLockHolder<SimpleFastMutexLock> holder(GetCommandIndexLock());
+  pool.swap(GetCommandPool());
+}
+
+
 CommandObjectBase::Pointer
 CommandObjectFactory::CreateCommandObject(const char* name)
 {
+  CreateObjectFunctionBase::Pointer creator;
+  {
+    MutexLockHolder<SimpleFastMutexLock> holder(GetCommandIndexLock());
+    CommandIndexType::const_iterator it = GetCommandIndex().find(name);
+    if(it != GetCommandIndex().end())
+      {
+      creator = it->second.Creator;
+      }
+  }
+  // constructed outside of the lock: a command may create others
+  if(creator)
+    {
+    LightObject::Pointer object = creator->CreateObject();
+    CommandObjectBase* command = dynamic_cast<CommandObjectBase*>(object.GetPointer());
+    if(command)
+      {
+      return command;
+      }
+    std::cerr << "Error CommandObject creator did not return an CommandObjectBase: "
+              << object->GetNameOfClass()
+              << std::endl;
+    }
+
+  // commands of factories that do not index them
+  if(!HasUnindexedCommands())
+    {
+    return 0;
+    }
 
   std::list<CommandObjectBase::Pointer> possibleCommandObject;
   std::list<LightObject::Pointer> allobjects =
@@ -57,34 +289,130 @@ CommandObjectFactory::CreateCommandObject(const char* name)
 }
 
 	
+bool
+CommandObjectFactory::GetCommandDescription(const char* name, CommandDescription& description)
+{
+  MutexLockHolder<SimpleFastMutexLock> holder(GetCommandIndexLock());
+  CommandIndexType::const_iterator it = GetCommandIndex().find(name);
+  if(it == GetCommandIndex().end())
+    {
+    return false;
+    }
+  description = it->second.Description;
+  return true;
+}
+
+
+std::vector<CommandDescription>
+CommandObjectFactory::GetCommandDescriptions()
+{
+  std::vector<CommandDescription> descriptions;
+  {
+    MutexLockHolder<SimpleFastMutexLock> holder(GetCommandIndexLock());
+    descriptions.reserve(GetCommandIndex().size());
+    for(CommandIndexType::const_iterator it = GetCommandIndex().begin();
+        it != GetCommandIndex().end(); ++it)
+      {
+      descriptions.push_back(it->second.Description);
+      }
+  }
+  std::sort(descriptions.begin(), descriptions.end(), CommandDescriptionLess);
+  return descriptions;
+}
+
+
+bool
+CommandObjectFactory::ParseCommandArguments(const char* name, int argc, const char* argv[],
+                                            CommandArguments& arguments, std::string& error)
+{
+  CommandDescription description;
+  if(!GetCommandDescription(name, description) || description.Arguments.IsNull())
+    {
+    return true;
+    }
+  return description.Arguments->Parse(argc, argv, arguments, error);
+}
+
+
 void CommandObjectFactory::PrintHelp(std::ostream &os, Indent indent)
 {
-  std::list<LightObject::Pointer> allobjects =
-    ObjectFactoryBase::CreateAllInstance("itkCommandObjectBase");
+  PrintHelp(os, indent, std::vector<CommandDescription>());
+}
 
-  std::vector<std::string> commandNames;
-  
-  for(std::list<LightObject::Pointer>::iterator i = allobjects.begin();
-      i != allobjects.end(); ++i)
+
+std::vector<CommandDescription>
+CommandObjectFactory::GetAllCommandDescriptions(const std::vector<CommandDescription> &others)
+{
+  std::vector<CommandDescription> descriptions = GetCommandDescriptions();
+  for (unsigned int i=0; i<others.size(); i++)
   {
-    CommandObjectBase* command = dynamic_cast<CommandObjectBase*>(i->GetPointer());
-    if(command)
+    CommandDescription description;
+    if (!GetCommandDescription(others[i].Name.c_str(), description))
+      descriptions.push_back(others[i]);
+  }
+  std::sort(descriptions.begin(), descriptions.end(), CommandDescriptionLess);
+
+  // commands of factories that do not describe them, constructed to be named
+  if(HasUnindexedCommands())
+  {
+    std::list<LightObject::Pointer> allobjects =
+      ObjectFactoryBase::CreateAllInstance("itkCommandObjectBase");
+    for(std::list<LightObject::Pointer>::iterator i = allobjects.begin();
+        i != allobjects.end(); ++i)
     {
-      commandNames.push_back ( command->GetCommandName() );
+      CommandObjectBase* command = dynamic_cast<CommandObjectBase*>(i->GetPointer());
+      CommandDescription description;
+      if(command && !GetCommandDescription(command->GetCommandName(), description))
+      {
+        description.Name = command->GetCommandName();
+        description.ShortDescription = command->GetShortDescription();
+        descriptions.push_back(description);
+      }
     }
+    std::sort(descriptions.begin(), descriptions.end(), CommandDescriptionLess);
   }
 
-  std::sort (commandNames.begin(), commandNames.end());
-  for (unsigned int i=0; i<commandNames.size(); i++)
+  return descriptions;
+}
+
+
+void CommandObjectFactory::PrintHelp(std::ostream &os, Indent indent,
+                                     const std::vector<CommandDescription> &others)
+{
+  std::vector<CommandDescription> descriptions = GetAllCommandDescriptions(others);
+  for (unsigned int i=0; i<descriptions.size(); i++)
   {
-    os << indent << "\t " << commandNames[i] << std::endl;
-    /*
-      << "...";
-      os << indent << command->GetShortDescription() << "\n";
-      os << "\n";
-    */
-  }  
+    if (i==0 || descriptions[i].Category!=descriptions[i-1].Category)
+      os << indent << (descriptions[i].Category.empty() ? "Other" : descriptions[i].Category.c_str()) << ":" << std::endl;
+    os << indent << "\t " << descriptions[i].Name;
+    if (!descriptions[i].ShortDescription.empty())
+      os << " - " << descriptions[i].ShortDescription;
+    os << std::endl;
+  }
 }
-	
-	
+
+
+void CommandObjectFactory::PrintHelpJSON(std::ostream &os,
+                                         const std::vector<CommandDescription> &others)
+{
+  std::vector<CommandDescription> descriptions = GetAllCommandDescriptions(others);
+  os << "[" << std::endl;
+  for (unsigned int i=0; i<descriptions.size(); i++)
+  {
+    const CommandDescription &description = descriptions[i];
+    os << "  {\"name\": " << CommandArgumentSchema::QuoteJSON(description.Name)
+       << ", \"category\": " << CommandArgumentSchema::QuoteJSON(description.Category)
+       << ", \"short\": " << CommandArgumentSchema::QuoteJSON(description.ShortDescription)
+       << ", \"long\": " << CommandArgumentSchema::QuoteJSON(description.LongDescription)
+       << ", \"arguments\": ";
+    if (description.Arguments.IsNotNull())
+      description.Arguments->WriteJSON(os);
+    else
+      os << "null";
+    os << "}" << (i+1<descriptions.size() ? "," : "") << std::endl;
+  }
+  os << "]" << std::endl;
+}
+
+
 } // end namespace itk
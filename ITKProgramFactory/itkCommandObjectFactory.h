@@ -18,8 +18,11 @@
 #define __itkCommandObjectFactory_h
 
 #include "itkObject.h"
+#include "itkCreateObjectFunction.h"
 #include "itkCommandObjectBase.h"
 
+#include <vector>
+
 namespace itk
 {
 
@@ -40,15 +43,73 @@ namespace itk
     /** Convenient typedefs. */
     typedef ::itk::CommandObjectBase::Pointer CommandObjectBasePointer;
 
-    /** Create the appropriate CommandObject. */
+    /** Create the appropriate CommandObject. Commands registered with
+        RegisterCommand are found by name, constructing only the one
+        requested; the others are searched the legacy way, constructing
+        every itkCommandObjectBase override of the registered factories. */
     static CommandObjectBasePointer CreateCommandObject(const char* name);
 
-	/** Print help messages of all registered commands */
+    /** Command of the pool of its name, released by an earlier execution,
+        else a new one, as created by CreateCommandObject. */
+    static CommandObjectBasePointer AcquireCommandObject(const char* name);
+
+    /** Give a command back after its execution: it is kept in the pool of
+        its name, up to MaximumPooledCommands (default 4), if its Reset()
+        succeeds and it was registered with RegisterCommand. */
+    static void ReleaseCommandObject(CommandObjectBase* command);
+
+    static void SetMaximumPooledCommands(unsigned int maximum);
+    static unsigned int GetMaximumPooledCommands();
+    static void ClearCommandPool();
+
+    /** Index the creator and the description of a command by its name;
+        command factories call it from their constructor, next to
+        RegisterOverride, and UnRegisterCommand from their destructor.
+        overrideClassName is the class name given to RegisterOverride:
+        without it, the override is not known to be indexed, and listing
+        or looking up commands falls back to constructing them all. */
+    static void RegisterCommand(const CommandDescription& description, CreateObjectFunctionBase* creator,
+                                const char* overrideClassName = 0);
+    static void UnRegisterCommand(const char* name);
+
+    /** Description of a registered command, read without constructing it. */
+    static bool GetCommandDescription(const char* name, CommandDescription& description);
+
+    /** Descriptions of the registered commands, by category and name. */
+    static std::vector<CommandDescription> GetCommandDescriptions();
+
+    /** Order of the command lists: by category, then by name. */
+    static bool CommandDescriptionLess(const CommandDescription& a, const CommandDescription& b);
+
+    /** Check the arguments of a command, without its name, against the
+        schema of its description, before constructing it. True, leaving
+        arguments unchecked, for the commands without schema. */
+    static bool ParseCommandArguments(const char* name, int argc, const char* argv[],
+                                      CommandArguments& arguments, std::string& error);
+
+	/** Print help messages of all registered commands, by category; only
+	    the commands of factories that do not register their description
+	    are constructed. */
 	  static void PrintHelp(std::ostream &os, Indent indent);
+
+	/** Same, listing also the commands described elsewhere, such as those
+	    of plugins not loaded yet. */
+	  static void PrintHelp(std::ostream &os, Indent indent,
+	                        const std::vector<CommandDescription> &others);
+
+	/** Machine-readable help: a JSON array of the registered commands and
+	    others, with their descriptions and argument schemas. */
+	  static void PrintHelpJSON(std::ostream &os,
+	                            const std::vector<CommandDescription> &others);
 	  
   protected:
     CommandObjectFactory();
     ~CommandObjectFactory();
+
+    /** Registered commands, others not registered, and those of the
+        factories that do not describe them, constructed to be named. */
+    static std::vector<CommandDescription> GetAllCommandDescriptions(
+      const std::vector<CommandDescription> &others);
     
 private:
     CommandObjectFactory(const Self&); //purposely not implemented
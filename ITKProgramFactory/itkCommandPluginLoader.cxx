@@ -0,0 +1,396 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkCommandPluginLoader.h"
+#include "itkCommandObjectFactory.h"
+
+#include <itksys/Directory.hxx>
+#include <itksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace itk
+{
+
+  namespace
+  {
+    typedef ObjectFactoryBase *(*PluginLoadFunction)();
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    const char PathSeparator = ';';
+#else
+    const char PathSeparator = ':';
+#endif
+
+    /** Manifest fields are tab separated, one command per line. */
+    std::string ManifestField (const std::string &text)
+    {
+      std::string field (text);
+      for (unsigned int i=0; i<field.size(); i++)
+        if (field[i]=='\t' || field[i]=='\n' || field[i]=='\r')
+          field[i] = ' ';
+      return field;
+    }
+
+    std::set<std::string> GetIndexedCommandNames (void)
+    {
+      std::set<std::string> names;
+      std::vector<CommandDescription> descriptions = CommandObjectFactory::GetCommandDescriptions();
+      for (unsigned int i=0; i<descriptions.size(); i++)
+        names.insert (descriptions[i].Name);
+      return names;
+    }
+  }
+
+
+  CommandPluginLoader::CommandPluginLoader()
+  {
+    m_ManifestRead = false;
+    m_ManifestUpToDate = false;
+
+    std::string home;
+    if (!itksys::SystemTools::GetEnv ("IPF_COMMAND_MANIFEST", m_ManifestFileName)
+        && itksys::SystemTools::GetEnv ("HOME", home))
+      m_ManifestFileName = home + "/.ipf_command_manifest";
+  }
+
+
+  CommandPluginLoader::~CommandPluginLoader()
+  {}
+
+
+  void CommandPluginLoader::AddSearchPath (const std::string &path)
+  {
+    // compared with the directories of the plugin paths
+    std::string directory (path);
+    while (directory.size()>1 && directory[directory.size()-1]=='/')
+      directory.erase (directory.size()-1);
+    if (directory.empty() || std::find (m_SearchPath.begin(), m_SearchPath.end(), directory)!=m_SearchPath.end())
+      return;
+    m_SearchPath.push_back (directory);
+    m_ManifestUpToDate = false;
+    this->Modified();
+  }
+
+
+  void CommandPluginLoader::SetSearchPathFromEnvironment (const char *variable)
+  {
+    std::string path;
+    if (!itksys::SystemTools::GetEnv (variable, path))
+      return;
+    std::string::size_type begin = 0;
+    while (begin<=path.size())
+    {
+      std::string::size_type end = path.find (PathSeparator, begin);
+      if (end==std::string::npos)
+        end = path.size();
+      this->AddSearchPath (path.substr (begin, end - begin));
+      begin = end + 1;
+    }
+  }
+
+
+  void CommandPluginLoader::ReadManifest (void)
+  {
+    m_ManifestRead = true;
+    if (m_ManifestFileName.empty())
+      return;
+    std::ifstream file (m_ManifestFileName.c_str());
+
+    // path, time, size, unindexed, then the command, if any
+    std::string line;
+    while (std::getline (file, line))
+    {
+      std::vector<std::string> fields;
+      std::string::size_type begin = 0;
+      while (begin<=line.size())
+      {
+        std::string::size_type end = line.find ('\t', begin);
+        if (end==std::string::npos)
+          end = line.size();
+        fields.push_back (line.substr (begin, end - begin));
+        begin = end + 1;
+      }
+      if (fields.size()<8)
+        continue;
+
+      PluginEntry &entry = m_Plugins[fields[0]];
+      entry.ModifiedTime = atol (fields[1].c_str());
+      entry.Size         = strtoul (fields[2].c_str(), 0, 10);
+      entry.Unindexed    = fields[3]=="1";
+      if (!fields[4].empty())
+      {
+        CommandDescription description;
+        description.Name             = fields[4];
+        description.Category         = fields[5];
+        description.ShortDescription = fields[6];
+        description.LongDescription  = fields[7];
+        entry.Commands.push_back (description);
+      }
+    }
+  }
+
+
+  void CommandPluginLoader::WriteManifest (void) const
+  {
+    if (m_ManifestFileName.empty())
+      return;
+
+    // written aside and renamed, for the processes reading it meanwhile
+    std::ostringstream temporary;
+    temporary << m_ManifestFileName << "." << getpid();
+    {
+      std::ofstream file (temporary.str().c_str());
+      for (PluginMapType::const_iterator it=m_Plugins.begin(); it!=m_Plugins.end(); ++it)
+      {
+        const PluginEntry &entry = it->second;
+        for (unsigned int i=0; i<std::max<size_t> (entry.Commands.size(), 1); i++)
+        {
+          file << it->first << '\t' << entry.ModifiedTime << '\t' << entry.Size << '\t'
+               << (entry.Unindexed ? 1 : 0) << '\t';
+          if (i<entry.Commands.size())
+          {
+            const CommandDescription &description = entry.Commands[i];
+            file << ManifestField (description.Name) << '\t' << ManifestField (description.Category) << '\t'
+                 << ManifestField (description.ShortDescription) << '\t'
+                 << ManifestField (description.LongDescription);
+          }
+          else
+            file << "\t\t\t";
+          file << '\n';
+        }
+      }
+      if (!file)
+      {
+        itkWarningMacro (<< "cannot write the plugin manifest " << m_ManifestFileName);
+        itksys::SystemTools::RemoveFile (temporary.str().c_str());
+        return;
+      }
+    }
+    itksys::SystemTools::RenameFile (temporary.str().c_str(), m_ManifestFileName.c_str());
+  }
+
+
+  ObjectFactoryBase *CommandPluginLoader::LoadPlugin (const std::string &path,
+                                                       itksys::DynamicLoader::LibraryHandle &library) const
+  {
+    library = itksys::DynamicLoader::OpenLibrary (path.c_str());
+    if (!library)
+    {
+      itkWarningMacro (<< "cannot load plugin " << path << ": " << itksys::DynamicLoader::LastError());
+      return 0;
+    }
+    PluginLoadFunction load = reinterpret_cast<PluginLoadFunction>(
+      itksys::DynamicLoader::GetSymbolAddress (library, "itkLoad"));
+    ObjectFactoryBase *factory = load ? (*load)() : 0;
+    if (!factory)
+    {
+      itkWarningMacro (<< path << " is not a command plugin: it has no itkLoad factory");
+      itksys::DynamicLoader::CloseLibrary (library);
+      library = 0;
+    }
+    return factory;
+  }
+
+
+  void CommandPluginLoader::ScanPlugin (const std::string &path, PluginEntry &entry)
+  {
+    entry.Unindexed = false;
+    entry.Commands.clear();
+
+    // the commands the factory indexes when constructed, by itkLoad
+    const std::set<std::string> before = GetIndexedCommandNames();
+    itksys::DynamicLoader::LibraryHandle library;
+    ObjectFactoryBase::Pointer factory = this->LoadPlugin (path, library);
+    if (!factory)
+      return;
+    // itkLoad returns a new reference, now held by factory
+    factory->UnRegister();
+    ObjectFactoryBase::RegisterFactory (factory);
+    std::vector<CommandDescription> descriptions = CommandObjectFactory::GetCommandDescriptions();
+    for (unsigned int i=0; i<descriptions.size(); i++)
+      if (!before.count (descriptions[i].Name))
+        entry.Commands.push_back (descriptions[i]);
+
+    std::list<std::string> overrides = factory->GetClassOverrideNames();
+    entry.Unindexed = static_cast<size_t>(std::count (overrides.begin(), overrides.end(),
+                                                      std::string ("itkCommandObjectBase"))) > entry.Commands.size();
+
+    // a factory destroyed without unregistering its commands leaves
+    // creators pointing into the library: it is then kept loaded
+    ObjectFactoryBase::UnRegisterFactory (factory);
+    factory = 0;
+    const std::set<std::string> after = GetIndexedCommandNames();
+    for (unsigned int i=0; i<entry.Commands.size(); i++)
+      if (after.count (entry.Commands[i].Name))
+        return;
+    itksys::DynamicLoader::CloseLibrary (library);
+  }
+
+
+  void CommandPluginLoader::UpdateManifest (void)
+  {
+    if (!m_ManifestRead)
+      this->ReadManifest();
+    if (m_ManifestUpToDate)
+      return;
+    m_ManifestUpToDate = true;
+
+    const std::string extension = itksys::DynamicLoader::LibExtension();
+    std::set<std::string> found;
+    bool changed = false;
+    for (unsigned int d=0; d<m_SearchPath.size(); d++)
+    {
+      itksys::Directory directory;
+      if (!directory.Load (m_SearchPath[d].c_str()))
+        continue;
+      for (unsigned long f=0; f<directory.GetNumberOfFiles(); f++)
+      {
+        const std::string name = directory.GetFile (f);
+        if (name.size()<=extension.size() || name.compare (name.size() - extension.size(), extension.size(), extension)!=0)
+          continue;
+        const std::string path = m_SearchPath[d] + "/" + name;
+        if (m_Loaded.count (path))
+        {
+          found.insert (path);
+          continue;
+        }
+
+        const long          time = itksys::SystemTools::ModifiedTime (path.c_str());
+        const unsigned long size = itksys::SystemTools::FileLength (path.c_str());
+        found.insert (path);
+        PluginMapType::iterator it = m_Plugins.find (path);
+        if (it!=m_Plugins.end() && it->second.ModifiedTime==time && it->second.Size==size)
+          continue;
+
+        PluginEntry &entry = m_Plugins[path];
+        entry.ModifiedTime = time;
+        entry.Size = size;
+        this->ScanPlugin (path, entry);
+        changed = true;
+      }
+    }
+
+    // plugins removed from the directories searched
+    for (PluginMapType::iterator it=m_Plugins.begin(); it!=m_Plugins.end(); )
+    {
+      const std::string directory = itksys::SystemTools::GetFilenamePath (it->first);
+      if (!found.count (it->first)
+          && std::find (m_SearchPath.begin(), m_SearchPath.end(), directory)!=m_SearchPath.end())
+      {
+        m_Plugins.erase (it++);
+        changed = true;
+      }
+      else
+        ++it;
+    }
+
+    if (changed)
+      this->WriteManifest();
+  }
+
+
+  bool CommandPluginLoader::RegisterPlugin (const std::string &path)
+  {
+    if (m_Loaded.count (path))
+      return true;
+
+    LoadedPlugin plugin;
+    plugin.Factory = this->LoadPlugin (path, plugin.Library);
+    if (!plugin.Factory)
+      return false;
+    plugin.Factory->UnRegister();
+    ObjectFactoryBase::RegisterFactory (plugin.Factory);
+    m_Loaded[path] = plugin;
+    return true;
+  }
+
+
+  bool CommandPluginLoader::LoadCommand (const char *name)
+  {
+    this->UpdateManifest();
+
+    // only the plugins of the search path: the manifest may be shared
+    bool loaded = false;
+    for (PluginMapType::const_iterator it=m_Plugins.begin(); it!=m_Plugins.end() && !loaded; ++it)
+    {
+      if (std::find (m_SearchPath.begin(), m_SearchPath.end(),
+                     itksys::SystemTools::GetFilenamePath (it->first))==m_SearchPath.end())
+        continue;
+      for (unsigned int i=0; i<it->second.Commands.size(); i++)
+        if (it->second.Commands[i].Name==name)
+          loaded = this->RegisterPlugin (it->first);
+    }
+    if (loaded)
+      return true;
+
+    // the commands of unindexed plugins are only known once constructed
+    for (PluginMapType::const_iterator it=m_Plugins.begin(); it!=m_Plugins.end(); ++it)
+      if (it->second.Unindexed
+          && std::find (m_SearchPath.begin(), m_SearchPath.end(),
+                        itksys::SystemTools::GetFilenamePath (it->first))!=m_SearchPath.end())
+        loaded = this->RegisterPlugin (it->first) || loaded;
+    return loaded;
+  }
+
+
+  void CommandPluginLoader::LoadAllPlugins (void)
+  {
+    this->UpdateManifest();
+    for (PluginMapType::const_iterator it=m_Plugins.begin(); it!=m_Plugins.end(); ++it)
+      if (std::find (m_SearchPath.begin(), m_SearchPath.end(),
+                     itksys::SystemTools::GetFilenamePath (it->first))!=m_SearchPath.end())
+        this->RegisterPlugin (it->first);
+  }
+
+
+  std::vector<CommandDescription> CommandPluginLoader::GetCommandDescriptions (void)
+  {
+    this->UpdateManifest();
+    std::vector<CommandDescription> descriptions;
+    for (PluginMapType::const_iterator it=m_Plugins.begin(); it!=m_Plugins.end(); ++it)
+      if (std::find (m_SearchPath.begin(), m_SearchPath.end(),
+                     itksys::SystemTools::GetFilenamePath (it->first))!=m_SearchPath.end())
+        descriptions.insert (descriptions.end(), it->second.Commands.begin(), it->second.Commands.end());
+    std::sort (descriptions.begin(), descriptions.end(), CommandObjectFactory::CommandDescriptionLess);
+    return descriptions;
+  }
+
+
+  void CommandPluginLoader::PrintSelf (std::ostream &os, Indent indent) const
+  {
+    Superclass::PrintSelf (os, indent);
+    os << indent << "SearchPath:";
+    for (unsigned int i=0; i<m_SearchPath.size(); i++)
+      os << " " << m_SearchPath[i];
+    os << std::endl;
+    os << indent << "ManifestFileName: " << m_ManifestFileName << std::endl;
+    os << indent << "NumberOfPlugins: " << m_Plugins.size() << std::endl;
+    os << indent << "NumberOfLoadedPlugins: " << m_Loaded.size() << std::endl;
+  }
+
+} // end of namespace
@@ -0,0 +1,131 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_CommandPluginLoader_h_
+#define _itk_CommandPluginLoader_h_
+
+#include "itkObject.h"
+#include "itkObjectFactoryBase.h"
+#include "itkCommandObjectBase.h"
+
+#include <itksys/DynamicLoader.hxx>
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+   Load command factories from shared libraries on demand.
+
+   The plugins are the shared libraries found in the directories of the
+   search path (IPF_COMMAND_PATH by default, separated like PATH), each
+   exporting, as ITK_AUTOLOAD_PATH factories do,
+
+     extern "C" itk::ObjectFactoryBase *itkLoad();
+
+   A manifest file caches the commands each plugin registers with
+   CommandObjectFactory::RegisterCommand, by path, modification time and
+   size: only the plugins added or changed since it was written are
+   loaded to list their commands, and LoadCommand then loads the one
+   plugin that provides the requested command. Plugins whose factories
+   do not register their commands are only loaded when a command is not
+   found in the manifest.
+ */
+
+namespace itk
+{
+
+  class CommandPluginLoader : public Object
+  {
+  public:
+    typedef CommandPluginLoader      Self;
+    typedef Object                   Superclass;
+    typedef SmartPointer<Self>       Pointer;
+    typedef SmartPointer<const Self> ConstPointer;
+
+    itkNewMacro (Self);
+    itkTypeMacro (CommandPluginLoader, Object);
+
+    /** Directories searched for plugins, in order. */
+    void AddSearchPath (const std::string &directory);
+    void SetSearchPathFromEnvironment (const char *variable = "IPF_COMMAND_PATH");
+    const std::vector<std::string> &GetSearchPath (void) const
+    { return m_SearchPath; }
+
+    /** Manifest cache; by default IPF_COMMAND_MANIFEST, else
+        ~/.ipf_command_manifest. Empty: nothing is cached. */
+    itkSetStringMacro (ManifestFileName);
+    itkGetStringMacro (ManifestFileName);
+
+    /** Bring the manifest up to date with the plugins of the search path,
+        and save it if it changed. */
+    void UpdateManifest (void);
+
+    /** Load and register the factory of the plugin providing name.
+        Returns false if no plugin provides it. */
+    bool LoadCommand (const char *name);
+
+    /** Load and register the factories of every plugin. */
+    void LoadAllPlugins (void);
+
+    /** Commands of the plugins, from the manifest, by category and name. */
+    std::vector<CommandDescription> GetCommandDescriptions (void);
+
+  protected:
+    CommandPluginLoader();
+    ~CommandPluginLoader();
+
+    void PrintSelf (std::ostream &os, Indent indent) const;
+
+  private:
+    CommandPluginLoader (const Self&);
+    void operator=(const Self&);
+
+    struct PluginEntry
+    {
+      long                            ModifiedTime;
+      unsigned long                   Size;
+      bool                            Unindexed;
+      std::vector<CommandDescription> Commands;
+    };
+    typedef std::map<std::string, PluginEntry> PluginMapType;
+
+    struct LoadedPlugin
+    {
+      itksys::DynamicLoader::LibraryHandle Library;
+      ObjectFactoryBase::Pointer           Factory;
+    };
+
+    void ReadManifest (void);
+    void WriteManifest (void) const;
+    void ScanPlugin (const std::string &path, PluginEntry &entry);
+    ObjectFactoryBase *LoadPlugin (const std::string &path, itksys::DynamicLoader::LibraryHandle &library) const;
+    bool RegisterPlugin (const std::string &path);
+
+    std::vector<std::string>  m_SearchPath;
+    std::string               m_ManifestFileName;
+    bool                      m_ManifestRead;
+    bool                      m_ManifestUpToDate;
+    PluginMapType             m_Plugins;
+
+    /** Plugins registered by this loader, which stay loaded for the life
+        of the process, as ITK_AUTOLOAD_PATH factories do. */
+    std::map<std::string, LoadedPlugin> m_Loaded;
+  };
+
+} // end of namespace
+
+#endif
@@ -0,0 +1,273 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkCommandProfiler.h"
+#include "itkCommandArgumentSchema.h"
+
+#include <itksys/SystemTools.hxx>
+
+#include <fstream>
+#include <iomanip>
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <sys/time.h>
+#endif
+
+namespace itk
+{
+
+  namespace
+  {
+    struct ResourceUsage
+    {
+      double             UserSeconds;
+      double             SystemSeconds;
+      unsigned long long PeakResidentBytes;
+      unsigned long long MinorPageFaults;
+      unsigned long long MajorPageFaults;
+    };
+
+    void GetResourceUsage (ResourceUsage &usage)
+    {
+#if defined(_WIN32) && !defined(__CYGWIN__)
+      FILETIME creation, exit, kernel, user;
+      GetProcessTimes (GetCurrentProcess(), &creation, &exit, &kernel, &user);
+      ULARGE_INTEGER u, k;
+      u.LowPart = user.dwLowDateTime;    u.HighPart = user.dwHighDateTime;
+      k.LowPart = kernel.dwLowDateTime;  k.HighPart = kernel.dwHighDateTime;
+      usage.UserSeconds   = u.QuadPart * 1e-7;
+      usage.SystemSeconds = k.QuadPart * 1e-7;
+      PROCESS_MEMORY_COUNTERS memory;
+      GetProcessMemoryInfo (GetCurrentProcess(), &memory, sizeof(memory));
+      usage.PeakResidentBytes = memory.PeakWorkingSetSize;
+      usage.MinorPageFaults   = memory.PageFaultCount;
+      usage.MajorPageFaults   = 0;
+#else
+      struct rusage ru;
+      getrusage (RUSAGE_SELF, &ru);
+      usage.UserSeconds   = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6;
+      usage.SystemSeconds = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+#if defined(__APPLE__)
+      usage.PeakResidentBytes = ru.ru_maxrss;
+#else
+      usage.PeakResidentBytes = static_cast<unsigned long long>(ru.ru_maxrss) * 1024;
+#endif
+      usage.MinorPageFaults = ru.ru_minflt;
+      usage.MajorPageFaults = ru.ru_majflt;
+#endif
+#ifdef __linux__
+      // VmHWM, unlike ru_maxrss, follows ResetPeakResidentBytes
+      std::ifstream status ("/proc/self/status");
+      std::string key;
+      while (status >> key)
+      {
+        if (key=="VmHWM:")
+        {
+          unsigned long long kilobytes = 0;
+          if (status >> kilobytes)
+            usage.PeakResidentBytes = kilobytes * 1024;
+          break;
+        }
+      }
+#endif
+    }
+
+    /** Bring the peak resident memory of the process down to its current
+        resident memory, where the system allows it (Linux 4.0 and later). */
+    bool ResetPeakResidentBytes (void)
+    {
+#ifdef __linux__
+      std::ofstream clearRefs ("/proc/self/clear_refs");
+      clearRefs << "5" << std::flush;
+      return clearRefs.good();
+#else
+      return false;
+#endif
+    }
+  }
+
+
+  CommandProfiler::CommandProfiler()
+  {
+    m_Observer = ObserverType::New();
+    m_Observer->SetCallbackFunction (this, &Self::OnFilterEvent);
+    m_Observer->SetCallbackFunction (this, &Self::OnConstFilterEvent);
+    m_ExitCode = 0;
+    m_Started = 0.0;
+    m_WallSeconds = m_UserSeconds = m_SystemSeconds = 0.0;
+    m_PeakResidentBytes = m_MinorPageFaults = m_MajorPageFaults = 0;
+    m_PeakResidentOfCommand = false;
+  }
+
+
+  CommandProfiler::~CommandProfiler()
+  {}
+
+
+  void CommandProfiler::Start (const char *commandName)
+  {
+    m_CommandName = commandName;
+    m_ExitCode = 0;
+    m_StageIndex.clear();
+    m_Stages.clear();
+    m_PeakResidentOfCommand = ResetPeakResidentBytes();
+    ResourceUsage usage;
+    GetResourceUsage (usage);
+    m_UserSeconds     = usage.UserSeconds;
+    m_SystemSeconds   = usage.SystemSeconds;
+    m_MinorPageFaults = usage.MinorPageFaults;
+    m_MajorPageFaults = usage.MajorPageFaults;
+    m_Started = itksys::SystemTools::GetTime();
+  }
+
+
+  void CommandProfiler::Stop (int exitCode)
+  {
+    m_WallSeconds = itksys::SystemTools::GetTime() - m_Started;
+    m_ExitCode = exitCode;
+    ResourceUsage usage;
+    GetResourceUsage (usage);
+    // the counters hold their value at Start until then
+    m_UserSeconds       = usage.UserSeconds - m_UserSeconds;
+    m_SystemSeconds     = usage.SystemSeconds - m_SystemSeconds;
+    m_PeakResidentBytes = usage.PeakResidentBytes;
+    m_MinorPageFaults   = usage.MinorPageFaults - m_MinorPageFaults;
+    m_MajorPageFaults   = usage.MajorPageFaults - m_MajorPageFaults;
+  }
+
+
+  void CommandProfiler::Observe (ProcessObject *filter)
+  {
+    filter->AddObserver (StartEvent(), m_Observer);
+    filter->AddObserver (EndEvent(), m_Observer);
+    filter->AddObserver (ProgressEvent(), m_Observer);
+  }
+
+
+  void CommandProfiler::OnFilterEvent (Object *caller, const EventObject &event)
+  {
+    this->OnConstFilterEvent (caller, event);
+  }
+
+
+  void CommandProfiler::OnConstFilterEvent (const Object *caller, const EventObject &event)
+  {
+    const double now = itksys::SystemTools::GetTime();
+    m_StagesLock.Lock();
+    std::map<const Object*, unsigned int>::const_iterator it = m_StageIndex.find (caller);
+    if (it==m_StageIndex.end())
+    {
+      StageProfile stage;
+      stage.Name     = caller->GetNameOfClass();
+      stage.Runs     = 0;
+      stage.Seconds  = 0.0;
+      stage.Progress = 0.0f;
+      stage.Started  = -1.0;
+      it = m_StageIndex.insert (std::make_pair (caller, static_cast<unsigned int>(m_Stages.size()))).first;
+      m_Stages.push_back (stage);
+    }
+    StageProfile &stage = m_Stages[it->second];
+
+    if (StartEvent().CheckEvent (&event))
+    {
+      stage.Started  = now;
+      stage.Progress = 0.0f;
+    }
+    else if (EndEvent().CheckEvent (&event) && stage.Started>=0.0)
+    {
+      stage.Seconds += now - stage.Started;
+      stage.Started  = -1.0;
+      stage.Runs++;
+    }
+    else if (ProgressEvent().CheckEvent (&event))
+    {
+      const ProcessObject *filter = dynamic_cast<const ProcessObject*>(caller);
+      if (filter)
+        stage.Progress = filter->GetProgress();
+    }
+    m_StagesLock.Unlock();
+  }
+
+
+  std::vector<CommandProfiler::StageProfile> CommandProfiler::GetStages (void) const
+  {
+    m_StagesLock.Lock();
+    std::vector<StageProfile> stages (m_Stages);
+    m_StagesLock.Unlock();
+    return stages;
+  }
+
+
+  void CommandProfiler::WriteReport (std::ostream &os) const
+  {
+    os << "Profile of " << m_CommandName << " (exit code " << m_ExitCode << "):\n"
+       << "  wall " << m_WallSeconds << " s, cpu " << m_UserSeconds + m_SystemSeconds
+       << " s (user " << m_UserSeconds << ", system " << m_SystemSeconds << ")\n"
+       << "  peak resident " << m_PeakResidentBytes / (1024.0 * 1024.0) << " MB"
+       << (m_PeakResidentOfCommand ? "" : " (process)") << ", page faults "
+       << m_MinorPageFaults << " minor, " << m_MajorPageFaults << " major\n";
+
+    const std::vector<StageProfile> stages = this->GetStages();
+    for (unsigned int i=0; i<stages.size(); i++)
+    {
+      const StageProfile &stage = stages[i];
+      os << "  " << std::left << std::setw (40) << stage.Name << std::right << " "
+         << stage.Seconds << " s, " << stage.Runs << (stage.Runs==1 ? " run" : " runs");
+      if (stage.Started>=0.0)
+        os << ", not ended";
+      os << ", progress " << static_cast<int>(stage.Progress * 100.0f + 0.5f) << "%\n";
+    }
+    os << std::flush;
+  }
+
+
+  void CommandProfiler::WriteJSON (std::ostream &os) const
+  {
+    os << "{\"command\": " << CommandArgumentSchema::QuoteJSON (m_CommandName)
+       << ", \"exit_code\": " << m_ExitCode
+       << ", \"wall_seconds\": " << m_WallSeconds
+       << ", \"user_seconds\": " << m_UserSeconds
+       << ", \"system_seconds\": " << m_SystemSeconds
+       << ", \"peak_resident_bytes\": " << m_PeakResidentBytes
+       << ", \"peak_resident_scope\": " << (m_PeakResidentOfCommand ? "\"command\"" : "\"process\"")
+       << ", \"minor_page_faults\": " << m_MinorPageFaults
+       << ", \"major_page_faults\": " << m_MajorPageFaults
+       << ", \"stages\": [";
+    const std::vector<StageProfile> stages = this->GetStages();
+    for (unsigned int i=0; i<stages.size(); i++)
+    {
+      os << (i ? ", " : "") << "{\"name\": " << CommandArgumentSchema::QuoteJSON (stages[i].Name)
+         << ", \"seconds\": " << stages[i].Seconds
+         << ", \"runs\": " << stages[i].Runs
+         << ", \"progress\": " << stages[i].Progress << "}";
+    }
+    os << "]}" << std::endl;
+  }
+
+
+  void CommandProfiler::PrintSelf (std::ostream &os, Indent indent) const
+  {
+    Superclass::PrintSelf (os, indent);
+    os << indent << "CommandName: " << m_CommandName << std::endl;
+    os << indent << "WallSeconds: " << m_WallSeconds << std::endl;
+    os << indent << "NumberOfStages: " << m_Stages.size() << std::endl;
+  }
+
+} // end of namespace
@@ -0,0 +1,135 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_CommandProfiler_h_
+#define _itk_CommandProfiler_h_
+
+#include "itkObject.h"
+#include "itkCommand.h"
+#include "itkProcessObject.h"
+#include "itkSimpleFastMutexLock.h"
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+   Measure the execution of a command: wall and CPU time, peak resident
+   memory and page faults of the process between Start and Stop, and the
+   time and progress of each filter the command lets it observe
+   (CommandObjectBase::SetFilterObserver with GetFilterObserver()),
+   from their StartEvent, EndEvent and ProgressEvent.
+
+   The resource counters are those of the whole process: profile one
+   command at a time for them to be the command's own. The peak resident
+   memory is reset at Start on Linux (/proc/self/clear_refs); elsewhere,
+   or when the kernel refuses it, it is the peak of the process since it
+   started, as GetPeakResidentOfCommand tells.
+ */
+
+namespace itk
+{
+
+  class CommandProfiler : public Object
+  {
+  public:
+    typedef CommandProfiler          Self;
+    typedef Object                   Superclass;
+    typedef SmartPointer<Self>       Pointer;
+    typedef SmartPointer<const Self> ConstPointer;
+
+    itkNewMacro (Self);
+    itkTypeMacro (CommandProfiler, Object);
+
+    /** Time and progress of one filter, over all its runs. */
+    struct StageProfile
+    {
+      std::string  Name;
+      unsigned int Runs;
+      double       Seconds;
+      float        Progress;
+      double       Started;
+    };
+
+    /** Start measuring a command, forgetting the previous one. */
+    void Start (const char *commandName);
+    void Stop (int exitCode);
+
+    /** Observer to give to the command, and to any other process object. */
+    Command *GetFilterObserver (void)
+    { return m_Observer.GetPointer(); }
+    void Observe (ProcessObject *filter);
+
+    double GetWallSeconds (void) const
+    { return m_WallSeconds; }
+    double GetUserSeconds (void) const
+    { return m_UserSeconds; }
+    double GetSystemSeconds (void) const
+    { return m_SystemSeconds; }
+    unsigned long long GetPeakResidentBytes (void) const
+    { return m_PeakResidentBytes; }
+    bool GetPeakResidentOfCommand (void) const
+    { return m_PeakResidentOfCommand; }
+    unsigned long long GetMinorPageFaults (void) const
+    { return m_MinorPageFaults; }
+    unsigned long long GetMajorPageFaults (void) const
+    { return m_MajorPageFaults; }
+
+    /** Filters in the order they started. */
+    std::vector<StageProfile> GetStages (void) const;
+
+    /** Human readable report, or one JSON object on one line. */
+    void WriteReport (std::ostream &os) const;
+    void WriteJSON (std::ostream &os) const;
+
+  protected:
+    CommandProfiler();
+    ~CommandProfiler();
+
+    void PrintSelf (std::ostream &os, Indent indent) const;
+
+  private:
+    CommandProfiler (const Self&);
+    void operator=(const Self&);
+
+    void OnFilterEvent (Object *caller, const EventObject &event);
+    void OnConstFilterEvent (const Object *caller, const EventObject &event);
+
+    typedef MemberCommand<Self> ObserverType;
+
+    ObserverType::Pointer     m_Observer;
+    std::string               m_CommandName;
+    int                       m_ExitCode;
+    double                    m_Started;
+    double                    m_WallSeconds;
+    double                    m_UserSeconds;
+    double                    m_SystemSeconds;
+    unsigned long long        m_PeakResidentBytes;
+    bool                      m_PeakResidentOfCommand;
+    unsigned long long        m_MinorPageFaults;
+    unsigned long long        m_MajorPageFaults;
+
+    /** Filters by address, and their order; events may come from the
+        threads of the filters. */
+    std::map<const Object*, unsigned int> m_StageIndex;
+    std::vector<StageProfile>             m_Stages;
+    mutable SimpleFastMutexLock           m_StagesLock;
+  };
+
+} // end of namespace
+
+#endif
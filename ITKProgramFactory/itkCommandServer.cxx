@@ -0,0 +1,477 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkCommandServer.h"
+
+#include <itksys/SystemTools.hxx>
+
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32) || defined(__CYGWIN__)
+#define ITK_COMMAND_SERVER_POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#endif
+
+namespace itk
+{
+
+#ifdef ITK_COMMAND_SERVER_POSIX
+  namespace
+  {
+    /** Whole reads and writes, through interruptions and short counts. */
+    bool ReadFully (int fd, void *data, size_t size)
+    {
+      char *p = static_cast<char*>(data);
+      while (size)
+      {
+        const ssize_t n = read (fd, p, size);
+        if (n<0 && errno==EINTR)
+          continue;
+        if (n<=0)
+          return false;
+        p += n;
+        size -= n;
+      }
+      return true;
+    }
+
+    bool WriteFully (int fd, const void *data, size_t size)
+    {
+      const char *p = static_cast<const char*>(data);
+      while (size)
+      {
+        const ssize_t n = write (fd, p, size);
+        if (n<0 && errno==EINTR)
+          continue;
+        if (n<=0)
+          return false;
+        p += n;
+        size -= n;
+      }
+      return true;
+    }
+
+    /** Longest request string accepted, against corrupted requests. */
+    const unsigned int MaximumRequestString = 1 << 20;
+
+    /** Written to by SIGCHLD, to wake the server up when a worker ends. */
+    int s_WorkerEndPipe[2] = { -1, -1 };
+
+    extern "C" void OnWorkerEnd (int)
+    {
+      const int saved = errno;
+      if (write (s_WorkerEndPipe[1], "", 1)<0) {}
+      errno = saved;
+    }
+
+    /** User at the other end of a connected local socket. */
+    bool GetPeerUserId (int connection, uid_t &uid)
+    {
+#if defined(SO_PEERCRED)
+      struct ucred credentials;
+      socklen_t length = sizeof(credentials);
+      if (getsockopt (connection, SOL_SOCKET, SO_PEERCRED, &credentials, &length)!=0)
+        return false;
+      uid = credentials.uid;
+      return true;
+#else
+      gid_t gid;
+      return getpeereid (connection, &uid, &gid)==0;
+#endif
+    }
+
+    /** The directory of the socket, created if missing, must belong to
+        this user and be writable by nobody else: otherwise another user
+        could put its own socket in place of the server's. */
+    bool CheckSocketDirectory (const std::string &directory, std::string &error)
+    {
+      if (mkdir (directory.c_str(), 0700)!=0 && errno!=EEXIST)
+      {
+        error = strerror (errno);
+        return false;
+      }
+      struct stat status;
+      if (lstat (directory.c_str(), &status)!=0)
+      {
+        error = strerror (errno);
+        return false;
+      }
+      if (!S_ISDIR(status.st_mode))
+        error = "not a directory";
+      else if (status.st_uid!=getuid())
+        error = "owned by another user";
+      else if (status.st_mode & (S_IWGRP | S_IWOTH))
+        error = "writable by other users";
+      else
+        return true;
+      return false;
+    }
+  }
+#endif
+
+
+  CommandServer::CommandServer()
+  {
+    m_RequestHandler = 0;
+    m_ClientData = 0;
+    m_SocketPath = GetDefaultSocketPath();
+    m_ExecutableName = "programFactoryTest";
+#ifdef ITK_COMMAND_SERVER_POSIX
+    const long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    m_MaximumNumberOfWorkers = cpus>0 ? static_cast<unsigned int>(cpus) : 1;
+#else
+    m_MaximumNumberOfWorkers = 1;
+#endif
+    m_ShutdownRequested = false;
+    m_ListeningSocket = -1;
+  }
+
+
+  CommandServer::~CommandServer()
+  {}
+
+
+  std::string CommandServer::GetDefaultSocketPath (void)
+  {
+    std::string path;
+    if (itksys::SystemTools::GetEnv ("IPF_SERVER_SOCKET", path))
+      return path;
+    std::ostringstream name;
+#ifdef ITK_COMMAND_SERVER_POSIX
+    std::string runtime;
+    if (itksys::SystemTools::GetEnv ("XDG_RUNTIME_DIR", runtime) && !runtime.empty())
+      name << runtime << "/ipf-server.sock";
+    else
+      name << "/tmp/ipf-" << getuid() << "/server.sock";
+#endif
+    return name.str();
+  }
+
+
+  void CommandServer::SetRequestHandler (RequestHandlerType handler, void *clientData)
+  {
+    m_RequestHandler = handler;
+    m_ClientData = clientData;
+    this->Modified();
+  }
+
+
+#ifdef ITK_COMMAND_SERVER_POSIX
+
+  bool CommandServer::ReadRequest (int connection, Request &request)
+  {
+    // the string count comes with the client descriptors
+    unsigned int count = 0;
+    struct iovec data;
+    data.iov_base = &count;
+    data.iov_len  = sizeof(count);
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    struct msghdr message;
+    memset (&message, 0, sizeof(message));
+    message.msg_iov        = &data;
+    message.msg_iovlen     = 1;
+    message.msg_control    = control;
+    message.msg_controllen = sizeof(control);
+
+    request.Descriptors[0] = request.Descriptors[1] = request.Descriptors[2] = -1;
+    ssize_t n;
+    do
+      n = recvmsg (connection, &message, 0);
+    while (n<0 && errno==EINTR);
+    if (n<=0)
+      return false;
+
+    struct cmsghdr *header = CMSG_FIRSTHDR (&message);
+    if (header && header->cmsg_level==SOL_SOCKET && header->cmsg_type==SCM_RIGHTS
+        && header->cmsg_len==CMSG_LEN(3 * sizeof(int)))
+      memcpy (request.Descriptors, CMSG_DATA (header), 3 * sizeof(int));
+    if (n<static_cast<ssize_t>(sizeof(count))
+        && !ReadFully (connection, reinterpret_cast<char*>(&count) + n, sizeof(count) - n))
+      return false;
+    if (request.Descriptors[0]<0 || count<2 || count>4096)
+      return false;
+
+    // the working directory, then the arguments
+    std::vector<std::string> strings (count);
+    for (unsigned int i=0; i<count; i++)
+    {
+      unsigned int length = 0;
+      if (!ReadFully (connection, &length, sizeof(length)) || length>MaximumRequestString)
+        return false;
+      strings[i].resize (length);
+      if (length && !ReadFully (connection, &strings[i][0], length))
+        return false;
+    }
+    request.Directory = strings[0];
+    request.Arguments.assign (strings.begin() + 1, strings.end());
+    return true;
+  }
+
+
+  void CommandServer::SendExitCode (int connection, int code)
+  {
+    WriteFully (connection, &code, sizeof(code));
+    close (connection);
+  }
+
+
+  void CommandServer::RunWorker (const Request &request)
+  {
+    // the worker writes to the client, and exits without running the
+    // destructors of the server
+    signal (SIGCHLD, SIG_DFL);
+    signal (SIGPIPE, SIG_DFL);
+    close (s_WorkerEndPipe[0]);
+    close (s_WorkerEndPipe[1]);
+    for (int i=0; i<3; i++)
+    {
+      dup2 (request.Descriptors[i], i);
+      close (request.Descriptors[i]);
+    }
+
+    int code = 126;
+    if (chdir (request.Directory.c_str())!=0)
+      std::cerr << "Error: cannot change to directory " << request.Directory << std::endl;
+    else
+    {
+      std::vector<char*> argv;
+      argv.push_back (const_cast<char*>(m_ExecutableName.c_str()));
+      for (unsigned int i=0; i<request.Arguments.size(); i++)
+        argv.push_back (const_cast<char*>(request.Arguments[i].c_str()));
+      argv.push_back (0);
+      try
+      {
+        code = (*m_RequestHandler)(static_cast<int>(argv.size()) - 1, &argv[0], m_ClientData);
+      }
+      catch (std::exception &e)
+      {
+        std::cerr << "Error: " << e.what() << std::endl;
+        code = EXIT_FAILURE;
+      }
+    }
+    std::cout.flush();
+    std::cerr.flush();
+    fflush (0);
+    _exit (code);
+  }
+
+
+  void CommandServer::StartWorker (int connection, Request &request)
+  {
+    const pid_t pid = fork();
+    if (pid==0)
+    {
+      // only the client connection is the worker's business
+      close (connection);
+      close (m_ListeningSocket);
+      for (std::map<long, int>::const_iterator it=m_Workers.begin(); it!=m_Workers.end(); ++it)
+        close (it->second);
+      this->RunWorker (request);
+    }
+    for (int i=0; i<3; i++)
+      close (request.Descriptors[i]);
+    if (pid<0)
+    {
+      itkWarningMacro (<< "cannot fork a worker: " << strerror (errno));
+      SendExitCode (connection, 125);
+      return;
+    }
+    m_Workers[pid] = connection;
+  }
+
+
+  void CommandServer::ReapWorkers (bool wait)
+  {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid (-1, &status, wait ? 0 : WNOHANG))>0)
+    {
+      std::map<long, int>::iterator it = m_Workers.find (pid);
+      if (it!=m_Workers.end())
+      {
+        SendExitCode (it->second, WIFEXITED (status) ? WEXITSTATUS (status)
+                      : 128 + (WIFSIGNALED (status) ? WTERMSIG (status) : 0));
+        m_Workers.erase (it);
+      }
+      wait = false;
+    }
+  }
+
+
+  bool CommandServer::Serve (void)
+  {
+    if (!m_RequestHandler)
+    {
+      itkExceptionMacro (<< "no request handler");
+    }
+
+    struct sockaddr_un address;
+    memset (&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (m_SocketPath.empty() || m_SocketPath.size()>=sizeof(address.sun_path))
+    {
+      itkWarningMacro (<< "invalid socket path " << m_SocketPath);
+      return false;
+    }
+    strncpy (address.sun_path, m_SocketPath.c_str(), sizeof(address.sun_path) - 1);
+    std::string error;
+    const std::string directory = itksys::SystemTools::GetFilenamePath (m_SocketPath);
+    if (!CheckSocketDirectory (directory.empty() ? "." : directory, error))
+    {
+      itkWarningMacro (<< "unsafe socket directory for " << m_SocketPath << ": " << error);
+      return false;
+    }
+
+    const int listening = m_ListeningSocket = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (listening<0)
+      return false;
+    // a socket left by a server that died; a running one still answers
+    if (connect (listening, reinterpret_cast<struct sockaddr*>(&address), sizeof(address))==0)
+    {
+      itkWarningMacro (<< "a server already listens on " << m_SocketPath);
+      close (listening);
+      return false;
+    }
+    unlink (m_SocketPath.c_str());
+    const mode_t mask = umask (077);
+    const bool bound = bind (listening, reinterpret_cast<struct sockaddr*>(&address), sizeof(address))==0;
+    umask (mask);
+    if (!bound || listen (listening, 64)!=0)
+    {
+      itkWarningMacro (<< "cannot listen on " << m_SocketPath << ": " << strerror (errno));
+      close (listening);
+      return false;
+    }
+
+    // clients leaving early must not kill the server
+    signal (SIGPIPE, SIG_IGN);
+    if (s_WorkerEndPipe[0]<0 && pipe (s_WorkerEndPipe)==0)
+    {
+      for (int i=0; i<2; i++)
+        fcntl (s_WorkerEndPipe[i], F_SETFL, fcntl (s_WorkerEndPipe[i], F_GETFL) | O_NONBLOCK);
+    }
+    signal (SIGCHLD, OnWorkerEnd);
+
+    m_ShutdownRequested = false;
+    while (!m_ShutdownRequested)
+    {
+      this->ReapWorkers (m_Workers.size()>=m_MaximumNumberOfWorkers);
+
+      // exit codes are sent as soon as the workers end
+      struct pollfd ready[2];
+      ready[0].fd = listening;
+      ready[1].fd = s_WorkerEndPipe[0];
+      ready[0].events = ready[1].events = POLLIN;
+      ready[0].revents = ready[1].revents = 0;
+      if (poll (ready, 2, -1)<=0)
+        continue;
+      if (ready[1].revents)
+      {
+        char drain[64];
+        while (read (s_WorkerEndPipe[0], drain, sizeof(drain))>0) {}
+      }
+      if (!(ready[0].revents & POLLIN))
+        continue;
+      const int connection = accept (listening, 0, 0);
+      if (connection<0)
+        continue;
+      // the socket mode should keep them out; descriptors left unread are dropped
+      uid_t peer;
+      if (!GetPeerUserId (connection, peer) || peer!=getuid())
+      {
+        close (connection);
+        continue;
+      }
+
+      Request request;
+      if (!ReadRequest (connection, request))
+      {
+        for (int i=0; i<3; i++)
+          if (request.Descriptors[i]>=0)
+            close (request.Descriptors[i]);
+        SendExitCode (connection, 125);
+        continue;
+      }
+      if (request.Arguments.size()==1 && request.Arguments[0]=="--shutdown")
+      {
+        for (int i=0; i<3; i++)
+          close (request.Descriptors[i]);
+        SendExitCode (connection, 0);
+        m_ShutdownRequested = true;
+        continue;
+      }
+      this->StartWorker (connection, request);
+    }
+
+    close (listening);
+    unlink (m_SocketPath.c_str());
+    while (!m_Workers.empty())
+      this->ReapWorkers (true);
+    signal (SIGCHLD, SIG_DFL);
+    return true;
+  }
+
+#else
+
+  bool CommandServer::ReadRequest (int, Request &)
+  {
+    return false;
+  }
+
+  void CommandServer::SendExitCode (int, int)
+  {}
+
+  void CommandServer::RunWorker (const Request &)
+  {}
+
+  void CommandServer::StartWorker (int, Request &)
+  {}
+
+  void CommandServer::ReapWorkers (bool)
+  {}
+
+  bool CommandServer::Serve (void)
+  {
+    itkWarningMacro (<< "the command server needs UNIX sockets");
+    return false;
+  }
+
+#endif
+
+
+  void CommandServer::PrintSelf (std::ostream &os, Indent indent) const
+  {
+    Superclass::PrintSelf (os, indent);
+    os << indent << "SocketPath: " << m_SocketPath << std::endl;
+    os << indent << "ExecutableName: " << m_ExecutableName << std::endl;
+    os << indent << "MaximumNumberOfWorkers: " << m_MaximumNumberOfWorkers << std::endl;
+    os << indent << "NumberOfWorkers: " << m_Workers.size() << std::endl;
+  }
+
+} // end of namespace
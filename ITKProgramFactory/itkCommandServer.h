@@ -0,0 +1,124 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_CommandServer_h_
+#define _itk_CommandServer_h_
+
+#include "itkObject.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+   Resident server running command lines sent by programFactoryClient
+   over a local UNIX socket, so that the libraries, factories and plugins
+   are loaded once instead of for every command.
+
+   Each request is the working directory and the arguments of the
+   client, sent with its stdin, stdout and stderr as SCM_RIGHTS file
+   descriptors. The server forks a worker per request, at most
+   MaximumNumberOfWorkers at once: the worker inherits everything loaded
+   so far, moves to the client directory, writes straight to the client
+   output and runs the request handler; the server then sends the exit
+   code of the worker back to the client, 128 + the signal number if it
+   was killed. A worker failing alone does not bring the server down.
+   Commands released by a worker (CommandObjectFactory::
+   ReleaseCommandObject) are pooled in that worker only, and go with it:
+   requests do not reuse the commands of earlier requests, only the
+   libraries and plugins the server loaded before forking.
+
+   A request made of the single argument --shutdown stops the server. The
+   socket is only accessible to its owner, in a directory no other user
+   can write to, and connections from other users are closed unanswered.
+   Not available on Windows.
+ */
+
+namespace itk
+{
+
+  class CommandServer : public Object
+  {
+  public:
+    typedef CommandServer            Self;
+    typedef Object                   Superclass;
+    typedef SmartPointer<Self>       Pointer;
+    typedef SmartPointer<const Self> ConstPointer;
+
+    itkNewMacro (Self);
+    itkTypeMacro (CommandServer, Object);
+
+    /** Runs a request in the worker; argv[0] is the server executable. */
+    typedef int (*RequestHandlerType)(int argc, char *argv[], void *clientData);
+
+    void SetRequestHandler (RequestHandlerType handler, void *clientData);
+
+    /** Socket path; by default IPF_SERVER_SOCKET, else
+        $XDG_RUNTIME_DIR/ipf-server.sock, else /tmp/ipf-<uid>/server.sock,
+        as for programFactoryClient. Serve creates its directory, mode 0700,
+        and refuses one that another user owns or can write to. */
+    itkSetStringMacro (SocketPath);
+    itkGetStringMacro (SocketPath);
+    static std::string GetDefaultSocketPath (void);
+
+    itkSetStringMacro (ExecutableName);
+    itkGetStringMacro (ExecutableName);
+
+    /** Requests run at once (default: the number of CPUs). */
+    itkSetMacro (MaximumNumberOfWorkers, unsigned int);
+    itkGetConstMacro (MaximumNumberOfWorkers, unsigned int);
+
+    /** Serve until shut down; false if the socket cannot be created. */
+    bool Serve (void);
+
+  protected:
+    CommandServer();
+    ~CommandServer();
+
+    void PrintSelf (std::ostream &os, Indent indent) const;
+
+  private:
+    CommandServer (const Self&);
+    void operator=(const Self&);
+
+    struct Request
+    {
+      std::string              Directory;
+      std::vector<std::string> Arguments;
+      int                      Descriptors[3];
+    };
+
+    static bool ReadRequest (int connection, Request &request);
+    static void SendExitCode (int connection, int code);
+    void StartWorker (int connection, Request &request);
+    void RunWorker (const Request &request);
+    void ReapWorkers (bool wait);
+
+    RequestHandlerType    m_RequestHandler;
+    void                 *m_ClientData;
+    std::string           m_SocketPath;
+    std::string           m_ExecutableName;
+    unsigned int          m_MaximumNumberOfWorkers;
+    bool                  m_ShutdownRequested;
+    int                   m_ListeningSocket;
+
+    /** Connection of each running worker, by process id. */
+    std::map<long, int>   m_Workers;
+  };
+
+} // end of namespace
+
+#endif
@@ -25,24 +25,61 @@ namespace itk
 	HelloWorldCommand::~HelloWorldCommand()
 	{}
 	
+	namespace
+	{
+		const char *s_Name = "HelloWorld";
+		const char *s_ShortDescription = "This is a short description";
+		const char *s_LongDescription = "This is a long description";
+		const char *s_Category = "Examples";
+	}
+	
 	const char *HelloWorldCommand::GetCommandName()
 	{
-		return "HelloWorld";
+		return s_Name;
 	}
 	
 	const char *HelloWorldCommand::GetShortDescription() const
 	{
-		return "This is a short description";
+		return s_ShortDescription;
 	}
 	
 	const char *HelloWorldCommand::GetLongDescription() const
 	{
-		return "This is a long description";
+		return s_LongDescription;
+	}
+	
+	bool HelloWorldCommand::Reset()
+	{
+		// nothing is kept from one execution to the next
+		Superclass::Reset();
+		return true;
+	}
+	
+	CommandDescription HelloWorldCommand::GetStaticDescription()
+	{
+		CommandDescription description;
+		description.Name = s_Name;
+		description.ShortDescription = s_ShortDescription;
+		description.LongDescription = s_LongDescription;
+		description.Category = s_Category;
+		
+		CommandArgumentSchema::Pointer arguments = CommandArgumentSchema::New();
+		arguments->AddOption( "-n", CommandArgumentSchema::String, "who to greet", false, "World" );
+		arguments->AddOption( "-r", CommandArgumentSchema::Integer, "number of greetings", false, "1" );
+		description.Arguments = arguments.GetPointer();
+		return description;
 	}
 	
 	int HelloWorldCommand::Execute (int nargs, const char *args[])
 	{
-		std::cout << "Hello World!" << std::endl;
+		if( !this->CheckArguments( nargs, args ) )
+			return EXIT_FAILURE;
+		
+		// not registered with its description: no schema
+		const char *name = m_Arguments.IsValid() ? m_Arguments.GetString( "-n" ) : "World";
+		const long count = m_Arguments.IsValid() ? m_Arguments.GetInteger( "-r" ) : 1;
+		for( long i=0; i<count; i++ )
+			std::cout << "Hello " << name << "!" << std::endl;
 		return EXIT_SUCCESS;
 	}
 	
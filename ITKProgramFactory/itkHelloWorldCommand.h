@@ -43,6 +43,11 @@ namespace itk
 		virtual const char *GetLongDescription (void) const;
 		
 		virtual int Execute (int nargs, const char *args[]);
+		virtual bool Reset (void);
+		
+		/** Name and descriptions, registered by the factory without
+		    constructing the command. */
+		static CommandDescription GetStaticDescription (void);
 		
 	protected:
 		HelloWorldCommand();
@@ -15,6 +15,7 @@
 
 =========================================================================*/
 #include "itkHelloWorldCommandFactory.h"
+#include "itkCommandObjectFactory.h"
 #include "itkCreateObjectFunction.h"
 #include "itkHelloWorldCommand.h"
 #include "itkVersion.h"
@@ -29,10 +30,14 @@ namespace itk
 							   "Hello World Command",
 							   1,
 							   CreateObjectFunction<HelloWorldCommand>::New());
+		CommandObjectFactory::RegisterCommand(HelloWorldCommand::GetStaticDescription(),
+											  CreateObjectFunction<HelloWorldCommand>::New(),
+											  "itkHelloWorldCommand");
 	}
 	
 	HelloWorldCommandFactory::~HelloWorldCommandFactory()
 	{
+		CommandObjectFactory::UnRegisterCommand(HelloWorldCommand::GetStaticDescription().Name.c_str());
 	}
 	
 	const char* 
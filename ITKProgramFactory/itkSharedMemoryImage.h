@@ -0,0 +1,102 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_SharedMemoryImage_h_
+#define _itk_SharedMemoryImage_h_
+
+#include "itkImageBase.h"
+#include "itkImportImageContainer.h"
+#include "itkSharedMemoryImageSegment.h"
+
+/**
+   Images of commands named shm://name live in a SharedMemoryImageSegment
+   instead of a file: the reader maps the pixel buffer of the writer as
+   the buffer of its itk::Image, without serialization or copy.
+
+   A command writing shm://name can create its output image in the
+   segment with CreateSharedMemoryImage and fill it in place, e.g. as
+   the grafted output of its last filter; WriteSharedMemoryImage then
+   has nothing to do, and copies the buffer once for other images.
+   Reading unlinks the segment by default: the name is consumed, the
+   mapping lives as long as the image buffer.
+
+   ReadCommandImage and WriteCommandImage take shm://name or file names,
+   so that commands accept both as inputs and outputs.
+ */
+
+namespace itk
+{
+
+  /** Pixel container mapping the buffer of a segment, unmapped when the
+      last image using it goes away. */
+  template <class TElementIdentifier, class TElement>
+  class SharedMemoryImageContainer : public ImportImageContainer<TElementIdentifier, TElement>
+  {
+  public:
+    typedef SharedMemoryImageContainer                        Self;
+    typedef ImportImageContainer<TElementIdentifier, TElement> Superclass;
+    typedef SmartPointer<Self>                                Pointer;
+    typedef SmartPointer<const Self>                          ConstPointer;
+
+    itkNewMacro (Self);
+    itkTypeMacro (SharedMemoryImageContainer, ImportImageContainer);
+
+    /** Use the buffer of segment, of size elements. */
+    void SetSegment (SharedMemoryImageSegment *segment, TElementIdentifier size);
+    SharedMemoryImageSegment *GetSegment (void) const
+    { return m_Segment.GetPointer(); }
+
+  protected:
+    SharedMemoryImageContainer() {}
+    ~SharedMemoryImageContainer() {}
+
+  private:
+    SharedMemoryImageContainer (const Self&);
+    void operator=(const Self&);
+
+    SharedMemoryImageSegment::Pointer m_Segment;
+  };
+
+
+  /** New image of the geometry of the buffered region of reference,
+      its buffer in the segment shm://name. */
+  template <class TImage>
+  typename TImage::Pointer CreateSharedMemoryImage (const char *filename, const ImageBase<TImage::ImageDimension> *reference);
+
+  /** Image of the segment shm://name; throws if it holds another pixel
+      type or dimension. */
+  template <class TImage>
+  typename TImage::Pointer ReadSharedMemoryImage (const char *filename, bool unlink = true);
+
+  /** Put image in the segment shm://name, unless it already is there
+      and the name still refers to that segment. */
+  template <class TImage>
+  void WriteSharedMemoryImage (const TImage *image, const char *filename);
+
+  /** Image of a command line name: shm://name, or a file. */
+  template <class TImage>
+  typename TImage::Pointer ReadCommandImage (const char *filename);
+
+  template <class TImage>
+  void WriteCommandImage (const TImage *image, const char *filename);
+
+} // end of namespace
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkSharedMemoryImage.txx"
+#endif
+
+#endif
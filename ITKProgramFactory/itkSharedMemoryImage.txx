@@ -0,0 +1,195 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_SharedMemoryImage_txx_
+#define _itk_SharedMemoryImage_txx_
+
+#include "itkSharedMemoryImage.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkImageIOBase.h"
+#include "itkPixelTraits.h"
+
+#include <string.h>
+
+namespace itk
+{
+
+  /** Component type of a pixel type, as recorded in the segment header. */
+  template <class TValue> ImageIOBase::IOComponentType GetSharedMemoryComponentType (void)   { return ImageIOBase::UNKNOWNCOMPONENTTYPE; }
+  template <> inline ImageIOBase::IOComponentType GetSharedMemoryComponentType<unsigned char> (void)  { return ImageIOBase::UCHAR; }
+  template <> inline ImageIOBase::IOComponentType GetSharedMemoryComponentType<char> (void)           { return ImageIOBase::CHAR; }
+  template <> inline ImageIOBase::IOComponentType GetSharedMemoryComponentType<unsigned short> (void) { return ImageIOBase::USHORT; }
+  template <> inline ImageIOBase::IOComponentType GetSharedMemoryComponentType<short> (void)          { return ImageIOBase::SHORT; }
+  template <> inline ImageIOBase::IOComponentType GetSharedMemoryComponentType<unsigned int> (void)   { return ImageIOBase::UINT; }
+  template <> inline ImageIOBase::IOComponentType GetSharedMemoryComponentType<int> (void)            { return ImageIOBase::INT; }
+  template <> inline ImageIOBase::IOComponentType GetSharedMemoryComponentType<unsigned long> (void)  { return ImageIOBase::ULONG; }
+  template <> inline ImageIOBase::IOComponentType GetSharedMemoryComponentType<long> (void)           { return ImageIOBase::LONG; }
+  template <> inline ImageIOBase::IOComponentType GetSharedMemoryComponentType<float> (void)          { return ImageIOBase::FLOAT; }
+  template <> inline ImageIOBase::IOComponentType GetSharedMemoryComponentType<double> (void)         { return ImageIOBase::DOUBLE; }
+
+
+  template <class TElementIdentifier, class TElement>
+  void SharedMemoryImageContainer<TElementIdentifier, TElement>
+  ::SetSegment (SharedMemoryImageSegment *segment, TElementIdentifier size)
+  {
+    // the segment, not the container, owns the buffer
+    this->SetImportPointer (static_cast<TElement*>(segment->GetBuffer()), size, false);
+    m_Segment = segment;
+  }
+
+
+  /** Image on the buffer of a mapped segment, of the geometry of its header. */
+  template <class TImage>
+  typename TImage::Pointer MapSharedMemoryImage (SharedMemoryImageSegment *segment)
+  {
+    typedef typename TImage::PixelType                        PixelType;
+    typedef SharedMemoryImageContainer<unsigned long, PixelType> ContainerType;
+    const unsigned int Dimension = TImage::ImageDimension;
+    const SharedMemoryImageHeader *header = segment->GetHeader();
+
+    typename TImage::RegionType region;
+    typename TImage::SpacingType spacing;
+    typename TImage::PointType origin;
+    typename TImage::DirectionType direction;
+    for (unsigned int i=0; i<Dimension; i++)
+    {
+      typename TImage::IndexType index = region.GetIndex();
+      typename TImage::SizeType size = region.GetSize();
+      index[i] = header->Index[i];
+      size[i] = header->Size[i];
+      region.SetIndex (index);
+      region.SetSize (size);
+      spacing[i] = header->Spacing[i];
+      origin[i] = header->Origin[i];
+      for (unsigned int j=0; j<Dimension; j++)
+        direction[i][j] = header->Direction[i*Dimension + j];
+    }
+
+    typename ContainerType::Pointer container = ContainerType::New();
+    container->SetSegment (segment, region.GetNumberOfPixels());
+    typename TImage::Pointer image = TImage::New();
+    image->SetRegions (region);
+    image->SetSpacing (spacing);
+    image->SetOrigin (origin);
+    image->SetDirection (direction);
+    image->SetPixelContainer (container);
+    return image;
+  }
+
+
+  template <class TImage>
+  typename TImage::Pointer CreateSharedMemoryImage (const char *filename, const ImageBase<TImage::ImageDimension> *reference)
+  {
+    typedef typename TImage::PixelType                  PixelType;
+    typedef typename PixelTraits<PixelType>::ValueType  ValueType;
+    const unsigned int Dimension = TImage::ImageDimension;
+    if (Dimension > SharedMemoryImageHeader::MaximumDimension)
+      itkGenericExceptionMacro (<< "shared memory images have at most "
+                                << SharedMemoryImageHeader::MaximumDimension << " dimensions");
+
+    SharedMemoryImageHeader header;
+    memset (&header, 0, sizeof (header));
+    header.Dimension          = Dimension;
+    header.ComponentType      = GetSharedMemoryComponentType<ValueType>();
+    header.NumberOfComponents = sizeof (PixelType) / sizeof (ValueType);
+    header.PixelSize          = sizeof (PixelType);
+    const typename TImage::RegionType &region = reference->GetBufferedRegion();
+    for (unsigned int i=0; i<Dimension; i++)
+    {
+      header.Index[i]   = region.GetIndex()[i];
+      header.Size[i]    = region.GetSize()[i];
+      header.Spacing[i] = reference->GetSpacing()[i];
+      header.Origin[i]  = reference->GetOrigin()[i];
+      for (unsigned int j=0; j<Dimension; j++)
+        header.Direction[i*Dimension + j] = reference->GetDirection()[i][j];
+    }
+
+    SharedMemoryImageSegment::Pointer segment = SharedMemoryImageSegment::New();
+    segment->Create (filename, header);
+    return MapSharedMemoryImage<TImage> (segment);
+  }
+
+
+  template <class TImage>
+  typename TImage::Pointer ReadSharedMemoryImage (const char *filename, bool unlink)
+  {
+    typedef typename TImage::PixelType                  PixelType;
+    typedef typename PixelTraits<PixelType>::ValueType  ValueType;
+
+    SharedMemoryImageSegment::Pointer segment = SharedMemoryImageSegment::New();
+    segment->Open (filename, unlink);
+    const SharedMemoryImageHeader *header = segment->GetHeader();
+    if (header->Dimension!=TImage::ImageDimension
+        || header->ComponentType!=static_cast<unsigned int>(GetSharedMemoryComponentType<ValueType>())
+        || header->PixelSize!=sizeof (PixelType))
+      itkGenericExceptionMacro (<< filename << " holds an image of dimension " << header->Dimension
+                                << " and pixels of " << header->NumberOfComponents << " components of type "
+                                << header->ComponentType << ", not the one expected");
+    return MapSharedMemoryImage<TImage> (segment);
+  }
+
+
+  template <class TImage>
+  void WriteSharedMemoryImage (const TImage *image, const char *filename)
+  {
+    typedef SharedMemoryImageContainer<unsigned long, typename TImage::PixelType> ContainerType;
+    // in place only while the name still leads to the buffer: a segment
+    // opened by a reader is usually unlinked already
+    const ContainerType *container = dynamic_cast<const ContainerType*>(image->GetPixelContainer());
+    if (container && container->GetSegment()->GetName()==filename
+        && container->GetSegment()->IsLinked())
+      return;
+
+    typename TImage::Pointer copy = CreateSharedMemoryImage<TImage> (filename, image);
+    memcpy (copy->GetBufferPointer(), image->GetBufferPointer(),
+            image->GetBufferedRegion().GetNumberOfPixels() * sizeof (typename TImage::PixelType));
+  }
+
+
+  template <class TImage>
+  typename TImage::Pointer ReadCommandImage (const char *filename)
+  {
+    if (SharedMemoryImageSegment::IsSharedMemoryName (filename))
+      return ReadSharedMemoryImage<TImage> (filename);
+
+    typename ImageFileReader<TImage>::Pointer reader = ImageFileReader<TImage>::New();
+    reader->SetFileName (filename);
+    reader->Update();
+    typename TImage::Pointer image = reader->GetOutput();
+    image->DisconnectPipeline();
+    return image;
+  }
+
+
+  template <class TImage>
+  void WriteCommandImage (const TImage *image, const char *filename)
+  {
+    if (SharedMemoryImageSegment::IsSharedMemoryName (filename))
+    {
+      WriteSharedMemoryImage (image, filename);
+      return;
+    }
+
+    typename ImageFileWriter<TImage>::Pointer writer = ImageFileWriter<TImage>::New();
+    writer->SetFileName (filename);
+    writer->SetInput (image);
+    writer->Update();
+  }
+
+} // end of namespace
+
+#endif
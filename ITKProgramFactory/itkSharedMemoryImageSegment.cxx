@@ -0,0 +1,252 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkSharedMemoryImageSegment.h"
+
+#include <string.h>
+
+#if !defined(_WIN32) || defined(__CYGWIN__)
+#define ITK_SHARED_MEMORY_POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace itk
+{
+
+  namespace
+  {
+    const char s_Prefix[] = "shm://";
+    const char s_Magic[8] = "ITKSHM1";
+    const unsigned long s_BufferAlignment = 4096;
+
+    /** POSIX name of the segment of shm://name: /name. */
+    std::string SegmentName (const char *filename)
+    {
+      return std::string ("/") + (filename + sizeof (s_Prefix) - 1);
+    }
+  }
+
+
+  SharedMemoryImageSegment::SharedMemoryImageSegment()
+    : m_Mapping (0),
+      m_Length (0),
+      m_Device (0),
+      m_Inode (0)
+  {}
+
+
+  SharedMemoryImageSegment::~SharedMemoryImageSegment()
+  {
+    this->Unmap();
+  }
+
+
+  bool SharedMemoryImageSegment::IsSharedMemoryName (const char *filename)
+  {
+    return filename && strncmp (filename, s_Prefix, sizeof (s_Prefix) - 1)==0
+      && filename[sizeof (s_Prefix) - 1] && !strchr (filename + sizeof (s_Prefix) - 1, '/');
+  }
+
+
+  bool SharedMemoryImageSegment::Exists (const char *filename)
+  {
+#ifdef ITK_SHARED_MEMORY_POSIX
+    if (!IsSharedMemoryName (filename))
+      return false;
+    const int fd = shm_open (SegmentName (filename).c_str(), O_RDONLY, 0);
+    if (fd<0)
+      return false;
+    close (fd);
+    return true;
+#else
+    return false;
+#endif
+  }
+
+
+  void SharedMemoryImageSegment::Unlink (const char *filename)
+  {
+#ifdef ITK_SHARED_MEMORY_POSIX
+    if (IsSharedMemoryName (filename))
+      shm_unlink (SegmentName (filename).c_str());
+#endif
+  }
+
+
+  void SharedMemoryImageSegment::Create (const char *filename, const SharedMemoryImageHeader &header)
+  {
+    if (!IsSharedMemoryName (filename))
+      itkExceptionMacro (<< filename << " is not a shm://name segment");
+    this->Unmap();
+
+#ifdef ITK_SHARED_MEMORY_POSIX
+    SharedMemoryImageHeader information = header;
+    memcpy (information.Magic, s_Magic, sizeof (s_Magic));
+    unsigned long pixels = information.Dimension ? 1 : 0;
+    for (unsigned int i=0; i<information.Dimension; i++)
+      pixels *= information.Size[i];
+    information.BufferOffset = (sizeof (information) + s_BufferAlignment - 1) / s_BufferAlignment * s_BufferAlignment;
+    information.BufferSize = pixels * information.PixelSize;
+
+    // replaced rather than resized under a reader still mapping it
+    const std::string name = SegmentName (filename);
+    shm_unlink (name.c_str());
+    const int fd = shm_open (name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd<0)
+      itkExceptionMacro (<< "cannot create " << filename << ": " << strerror (errno));
+    const unsigned long length = information.BufferOffset + information.BufferSize;
+    if (ftruncate (fd, static_cast<off_t>(length))!=0)
+    {
+      const int error = errno;
+      close (fd);
+      shm_unlink (name.c_str());
+      itkExceptionMacro (<< "cannot size " << filename << ": " << strerror (error));
+    }
+    m_Name = filename;
+    this->Map (fd, length, true);
+    memcpy (m_Mapping, &information, sizeof (information));
+#else
+    itkExceptionMacro (<< "shared memory images need POSIX shared memory");
+#endif
+  }
+
+
+  void SharedMemoryImageSegment::Open (const char *filename, bool unlink)
+  {
+    if (!IsSharedMemoryName (filename))
+      itkExceptionMacro (<< filename << " is not a shm://name segment");
+    this->Unmap();
+
+#ifdef ITK_SHARED_MEMORY_POSIX
+    const std::string name = SegmentName (filename);
+    const int fd = shm_open (name.c_str(), O_RDWR, 0);
+    if (fd<0)
+      itkExceptionMacro (<< "cannot open " << filename << ": " << strerror (errno));
+    struct stat status;
+    if (fstat (fd, &status)!=0 || static_cast<unsigned long>(status.st_size) < sizeof (SharedMemoryImageHeader))
+    {
+      close (fd);
+      itkExceptionMacro (<< filename << " holds no image");
+    }
+    m_Name = filename;
+    this->Map (fd, static_cast<unsigned long>(status.st_size), false);
+
+    // the image described must fit in the buffer, the buffer in the segment
+    const SharedMemoryImageHeader *header = this->GetHeader();
+    bool valid = memcmp (header->Magic, s_Magic, sizeof (s_Magic))==0
+      && header->Dimension <= SharedMemoryImageHeader::MaximumDimension
+      && header->PixelSize > 0
+      && header->BufferOffset >= sizeof (SharedMemoryImageHeader)
+      && header->BufferOffset <= m_Length
+      && header->BufferSize <= m_Length - header->BufferOffset;
+    unsigned long pixels = header->Dimension ? 1 : 0;
+    for (unsigned int i=0; valid && i<header->Dimension; i++)
+    {
+      valid = header->Size[i]==0 || pixels <= header->BufferSize / header->Size[i];
+      pixels *= header->Size[i];
+    }
+    if (!valid || pixels > header->BufferSize / header->PixelSize)
+    {
+      this->Unmap();
+      itkExceptionMacro (<< filename << " holds no image");
+    }
+    if (unlink)
+      shm_unlink (name.c_str());
+#else
+    itkExceptionMacro (<< "shared memory images need POSIX shared memory");
+#endif
+  }
+
+
+  void SharedMemoryImageSegment::Map (int fd, unsigned long length, bool created)
+  {
+#ifdef ITK_SHARED_MEMORY_POSIX
+    struct stat status;
+    if (fstat (fd, &status)==0)
+    {
+      m_Device = status.st_dev;
+      m_Inode  = status.st_ino;
+    }
+    void *mapping = mmap (0, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    const int error = errno;
+    close (fd);
+    if (mapping==MAP_FAILED)
+    {
+      if (created)
+        shm_unlink (SegmentName (m_Name.c_str()).c_str());
+      itkExceptionMacro (<< "cannot map " << m_Name << ": " << strerror (error));
+    }
+    m_Mapping = mapping;
+    m_Length = length;
+#endif
+  }
+
+
+  void SharedMemoryImageSegment::Unmap (void)
+  {
+#ifdef ITK_SHARED_MEMORY_POSIX
+    if (m_Mapping)
+      munmap (m_Mapping, m_Length);
+#endif
+    m_Mapping = 0;
+    m_Length = 0;
+  }
+
+
+  bool SharedMemoryImageSegment::IsLinked (void) const
+  {
+#ifdef ITK_SHARED_MEMORY_POSIX
+    if (!m_Mapping)
+      return false;
+    const int fd = shm_open (SegmentName (m_Name.c_str()).c_str(), O_RDONLY, 0);
+    if (fd<0)
+      return false;
+    struct stat status;
+    const bool same = fstat (fd, &status)==0
+      && static_cast<unsigned long long>(status.st_dev)==m_Device
+      && static_cast<unsigned long long>(status.st_ino)==m_Inode;
+    close (fd);
+    return same;
+#else
+    return false;
+#endif
+  }
+
+
+  const SharedMemoryImageHeader *SharedMemoryImageSegment::GetHeader (void) const
+  {
+    return static_cast<const SharedMemoryImageHeader*>(m_Mapping);
+  }
+
+
+  void *SharedMemoryImageSegment::GetBuffer (void) const
+  {
+    return m_Mapping ? static_cast<char*>(m_Mapping) + this->GetHeader()->BufferOffset : 0;
+  }
+
+
+  void SharedMemoryImageSegment::PrintSelf (std::ostream &os, Indent indent) const
+  {
+    Superclass::PrintSelf (os, indent);
+    os << indent << "Name: " << m_Name << std::endl;
+    os << indent << "Length: " << m_Length << std::endl;
+  }
+
+} // end of namespace
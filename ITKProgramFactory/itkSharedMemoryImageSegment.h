@@ -0,0 +1,117 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef _itk_SharedMemoryImageSegment_h_
+#define _itk_SharedMemoryImageSegment_h_
+
+#include "itkObject.h"
+
+#include <string>
+
+/**
+   Named POSIX shared memory segment holding an image: a fixed header
+   describing it, then its pixel buffer, page aligned, so that commands
+   of different processes exchange images as shm://name instead of
+   files, mapping the buffer of the producer without copying it.
+
+   The segment outlives the process creating it until it is unlinked,
+   usually by the process reading it once it is mapped; the mapping
+   stays valid until the segment object is destroyed. Only readable and
+   writable by its owner. Not available on Windows.
+ */
+
+namespace itk
+{
+
+  struct SharedMemoryImageHeader
+  {
+    enum { MaximumDimension = 4 };
+
+    char          Magic[8];
+    unsigned int  Dimension;
+    unsigned int  ComponentType;       // ImageIOBase::IOComponentType
+    unsigned int  NumberOfComponents;
+    unsigned int  PixelSize;
+    long          Index[MaximumDimension];
+    unsigned long Size[MaximumDimension];
+    double        Spacing[MaximumDimension];
+    double        Origin[MaximumDimension];
+    double        Direction[MaximumDimension*MaximumDimension];
+    unsigned long BufferOffset;
+    unsigned long BufferSize;
+  };
+
+  class SharedMemoryImageSegment : public Object
+  {
+  public:
+    typedef SharedMemoryImageSegment Self;
+    typedef Object                   Superclass;
+    typedef SmartPointer<Self>       Pointer;
+    typedef SmartPointer<const Self> ConstPointer;
+
+    itkNewMacro (Self);
+    itkTypeMacro (SharedMemoryImageSegment, Object);
+
+    /** Whether a file name is a shm://name segment. */
+    static bool IsSharedMemoryName (const char *filename);
+
+    /** Whether the segment of a shm://name exists. */
+    static bool Exists (const char *filename);
+
+    /** Remove the name of a segment; mappings stay valid. */
+    static void Unlink (const char *filename);
+
+    /** Create the segment for an image described by header, replacing
+        any segment of that name, and map it; the buffer offset and size
+        are computed here. Throws on failure. */
+    void Create (const char *filename, const SharedMemoryImageHeader &header);
+
+    /** Map an existing segment, unlinking its name once mapped if asked.
+        Throws if it cannot be mapped or holds no image. */
+    void Open (const char *filename, bool unlink);
+
+    const std::string &GetName (void) const
+    { return m_Name; }
+
+    /** Whether the name of the segment still refers to this mapping:
+        false once it has been unlinked, or replaced by another segment. */
+    bool IsLinked (void) const;
+    const SharedMemoryImageHeader *GetHeader (void) const;
+    void *GetBuffer (void) const;
+
+  protected:
+    SharedMemoryImageSegment();
+    ~SharedMemoryImageSegment();
+
+    void PrintSelf (std::ostream &os, Indent indent) const;
+
+  private:
+    SharedMemoryImageSegment (const Self&);
+    void operator=(const Self&);
+
+    void Map (int fd, unsigned long length, bool created);
+    void Unmap (void);
+
+    std::string        m_Name;
+    void              *m_Mapping;
+    unsigned long      m_Length;
+    unsigned long long m_Device;
+    unsigned long long m_Inode;
+  };
+
+} // end of namespace
+
+#endif
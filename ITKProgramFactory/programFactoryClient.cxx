@@ -0,0 +1,170 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+/**
+   Thin client of the resident command server (programFactoryTest
+   --serve): sends its working directory and arguments, with its stdin,
+   stdout and stderr, to the server, which runs them as programFactoryTest
+   would, writing straight to this process output, and returns the exit
+   code of the command. Does not link ITK.
+
+   The socket is IPF_SERVER_SOCKET, else $XDG_RUNTIME_DIR/ipf-server.sock,
+   else /tmp/ipf-<uid>/server.sock, as in
+   itk::CommandServer::GetDefaultSocketPath. The descriptors are only sent
+   to a server run by the same user.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+bool WriteFully (int fd, const void *data, size_t size)
+{
+	const char *p = static_cast<const char*>(data);
+	while (size) {
+		const ssize_t n = write (fd, p, size);
+		if (n<0 && errno==EINTR)
+			continue;
+		if (n<=0)
+			return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+
+bool GetPeerUserId (int connection, uid_t &uid)
+{
+#if defined(SO_PEERCRED)
+	struct ucred credentials;
+	socklen_t length = sizeof(credentials);
+	if (getsockopt (connection, SOL_SOCKET, SO_PEERCRED, &credentials, &length)!=0)
+		return false;
+	uid = credentials.uid;
+	return true;
+#else
+	gid_t gid;
+	return getpeereid (connection, &uid, &gid)==0;
+#endif
+}
+
+
+int main (int narg, char *args[])
+{
+	if (narg<2) {
+		std::cout << "Usage: " << args[0] << " command [arguments] [! command [arguments] ...] | --shutdown\n";
+		return EXIT_FAILURE;
+	}
+	
+	std::string path;
+	if (getenv ("IPF_SERVER_SOCKET"))
+		path = getenv ("IPF_SERVER_SOCKET");
+	else {
+		std::ostringstream name;
+		const char *runtime = getenv ("XDG_RUNTIME_DIR");
+		if (runtime && *runtime)
+			name << runtime << "/ipf-server.sock";
+		else
+			name << "/tmp/ipf-" << getuid() << "/server.sock";
+		path = name.str();
+	}
+	
+	struct sockaddr_un address;
+	memset (&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy (address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+	const int server = socket (AF_UNIX, SOCK_STREAM, 0);
+	if (server<0 || connect (server, reinterpret_cast<struct sockaddr*>(&address), sizeof(address))!=0) {
+		std::cerr << "Error: no command server on " << path << " (start one with programFactoryTest --serve)" << std::endl;
+		return 127;
+	}
+	
+	// our stdin, stdout and stderr only go to a server of our own
+	uid_t peer;
+	if (!GetPeerUserId (server, peer) || peer!=getuid()) {
+		std::cerr << "Error: the command server on " << path << " is not run by this user" << std::endl;
+		return 127;
+	}
+	
+	// working directory and arguments, sent after their count
+	std::vector<char> directory (4096);
+	while (!getcwd (&directory[0], directory.size()) && errno==ERANGE)
+		directory.resize (directory.size() * 2);
+	std::vector<std::string> strings;
+	strings.push_back (&directory[0]);
+	strings.insert (strings.end(), args + 1, args + narg);
+	
+	// the count carries the descriptors of this process stdin, stdout and stderr
+	unsigned int count = strings.size();
+	int descriptors[3] = { 0, 1, 2 };
+	struct iovec data;
+	data.iov_base = &count;
+	data.iov_len  = sizeof(count);
+	char control[CMSG_SPACE(sizeof(descriptors))];
+	memset (control, 0, sizeof(control));
+	struct msghdr message;
+	memset (&message, 0, sizeof(message));
+	message.msg_iov        = &data;
+	message.msg_iovlen     = 1;
+	message.msg_control    = control;
+	message.msg_controllen = sizeof(control);
+	struct cmsghdr *header = CMSG_FIRSTHDR (&message);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type  = SCM_RIGHTS;
+	header->cmsg_len   = CMSG_LEN(sizeof(descriptors));
+	memcpy (CMSG_DATA (header), descriptors, sizeof(descriptors));
+	
+	bool sent = sendmsg (server, &message, 0)==static_cast<ssize_t>(sizeof(count));
+	for (unsigned int i=0; i<strings.size() && sent; i++) {
+		const unsigned int length = strings[i].size();
+		sent = WriteFully (server, &length, sizeof(length))
+			&& WriteFully (server, strings[i].data(), length);
+	}
+	if (!sent) {
+		std::cerr << "Error: cannot send the request to " << path << std::endl;
+		return 127;
+	}
+	
+	// the command writes to our output itself: only its exit code comes back
+	int code = 0;
+	char *p = reinterpret_cast<char*>(&code);
+	size_t left = sizeof(code);
+	while (left) {
+		const ssize_t n = read (server, p, left);
+		if (n<0 && errno==EINTR)
+			continue;
+		if (n<=0) {
+			std::cerr << "Error: the command server closed the connection" << std::endl;
+			return 127;
+		}
+		p += n;
+		left -= n;
+	}
+	close (server);
+	return code;
+}
@@ -16,41 +16,275 @@
 =========================================================================*/
 #include "itkHelloWorldCommandFactory.h"
 #include "itkCommandObjectFactory.h"
+#include "itkCommandPluginLoader.h"
+#include "itkCommandBatchExecutor.h"
+#include "itkCommandProfiler.h"
+#include "itkCommandServer.h"
 
 
-int main (int narg, char *args[])
+#include <fstream>
+#include <set>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+
+/** Create a command, linked in or from the plugin providing it, or take
+    one released to the pool by an earlier stage. */
+itk::CommandObjectBase::Pointer CreateCommand (const char *name, itk::CommandPluginLoader *plugins)
 {
+	itk::CommandObjectBase::Pointer prog = itk::CommandObjectFactory::AcquireCommandObject( name );
+	if( prog.IsNull() && plugins->LoadCommand( name ) )
+		prog = itk::CommandObjectFactory::AcquireCommandObject( name );
+	return prog;
+}
 
-	itk::HelloWorldCommandFactory::RegisterOneFactory();
 
+/** Check the arguments of a command, name first, against its schema,
+    loading the plugin providing it if needed, without building it. The
+    input files of produced, written by earlier commands, need not exist;
+    the output files of this one are added to it. */
+bool CheckCommand (int narg, char *args[], itk::CommandPluginLoader *plugins,
+                   itk::CommandArguments &arguments, std::set<std::string> &produced)
+{
+	itk::CommandDescription description;
+	if( !itk::CommandObjectFactory::GetCommandDescription( args[0], description ) && plugins->LoadCommand( args[0] ) )
+		itk::CommandObjectFactory::GetCommandDescription( args[0], description );
+	if( description.Arguments.IsNull() )
+		return true;
 	
-	if (narg<2) {
-		itk::CommandObjectFactory::PrintHelp( std::cout, 0 );
-		return EXIT_FAILURE;
+	std::string error;
+	if( description.Arguments->Parse( narg-1, const_cast<const char**>( args+1 ), arguments, error, &produced ) )
+	{
+		const std::vector<itk::CommandArgumentSchema::Argument> &declared = description.Arguments->GetArguments();
+		for( unsigned int i=0; i<declared.size(); i++ )
+		{
+			const char *file = arguments.GetString( declared[i].Name.c_str() );
+			if( declared[i].Type==itk::CommandArgumentSchema::OutputFile && file && *file )
+				produced.insert( file );
+		}
+		return true;
 	}
+	std::cerr << "Error: " << args[0] << ": " << error << "\nUsage: ";
+	description.Arguments->WriteUsage( std::cerr, args[0] );
+	return false;
+}
+
+
+/** Run the commands separated by "!" in sequence, each one given the
+    pipeline output of the previous one, in memory, as pipeline input.
+    Each command gets the usual arguments: the executable, its name, then
+    its own arguments. Stops at the first failing command. With a
+    profiler, each command is reported on std::cerr, or as a JSON line on
+    profileJSON if given. */
+int RunPipeline (int narg, char *args[], itk::CommandPluginLoader *plugins,
+                 itk::CommandProfiler *profiler, std::ostream *profileJSON)
+{
+	itk::DataObject::Pointer handoff;
+	int returnValue = EXIT_SUCCESS;
 	
+	if( strcmp( args[narg-1], "!" )==0 )
+	{
+		std::cerr << "Error: empty command in the pipeline" << std::endl;
+		return EXIT_FAILURE;
+	}
 	
-	const char *programName = args[1];
-	
-	
-	itk::CommandObjectBase::Pointer prog = itk::CommandObjectFactory::CreateCommandObject( programName );
-	
-	int returnValue = EXIT_SUCCESS;
+	// every command is checked before the first one is built; files
+	// written by a command may be read by the next ones
+	std::vector<int> firsts, ends;
+	std::vector<itk::CommandArguments> arguments;
+	std::set<std::string> produced;
+	for( int first=1; first<narg; )
+	{
+		int end = first;
+		while( end<narg && strcmp( args[end], "!" )!=0 )
+			end++;
+		if( end==first )
+		{
+			std::cerr << "Error: empty command in the pipeline" << std::endl;
+			return EXIT_FAILURE;
+		}
+		arguments.push_back( itk::CommandArguments() );
+		if( !CheckCommand( end - first, args + first, plugins, arguments.back(), produced ) )
+			return EXIT_FAILURE;
+		firsts.push_back( first );
+		ends.push_back( end );
+		first = end + 1;
+	}
 	
-	if( !prog.IsNull() )
+	for( unsigned int stage=0; stage<firsts.size() && returnValue==EXIT_SUCCESS; stage++ )
 	{
+		const int first = firsts[stage];
+		const int end = ends[stage];
+		
+		std::vector<const char*> stageArgs;
+		stageArgs.push_back( args[0] );
+		stageArgs.insert( stageArgs.end(), args + first, args + end );
+		
+		itk::CommandObjectBase::Pointer prog = CreateCommand( args[first], plugins );
+		if( prog.IsNull() )
+		{
+			std::cout << "Prog is null: " << args[first] << std::endl;
+			return EXIT_FAILURE;
+		}
+		
 		std::cout << prog->GetCommandName() << std::endl;
 		std::cout << prog->GetShortDescription() << std::endl;
 		std::cout << prog->GetLongDescription() << std::endl;
 		
+		prog->SetArguments( arguments[stage] );
+		prog->SetPipelineInput( handoff );
+		if( profiler )
+		{
+			prog->SetFilterObserver( profiler->GetFilterObserver() );
+			profiler->Observe( prog );
+			profiler->Start( prog->GetCommandName() );
+		}
 		std::cout << "Executing...\n";
-		returnValue = prog->Execute(narg, (const char**)args);
+		returnValue = prog->Execute( static_cast<int>(stageArgs.size()), &stageArgs[0] );
 		std::cout << "Done." << std::endl;
+		if( profiler )
+		{
+			profiler->Stop( returnValue );
+			if( profileJSON )
+				profiler->WriteJSON( *profileJSON );
+			else
+				profiler->WriteReport( std::cerr );
+		}
+		
+		handoff = prog->GetPipelineOutput();
+		if( end<narg && handoff.IsNull() && returnValue==EXIT_SUCCESS )
+			std::cerr << "Warning: " << args[first] << " gives no output to the next command" << std::endl;
+		
+		// a later stage running the same command reuses it, unobserved
+		if( profiler )
+			prog->RemoveAllObservers();
+		itk::CommandObjectFactory::ReleaseCommandObject( prog );
 	}
-	else {
-		std::cout << "Prog is null" << std::endl;
+	
+	return returnValue;
+}
+
+
+/** --batch jobs [--jobs N] [--threads N] [--summary file]: run the
+    commands of a job file concurrently and summarize them. */
+int RunBatch (int narg, char *args[], itk::CommandPluginLoader *plugins)
+{
+	itk::CommandBatchExecutor::Pointer batch = itk::CommandBatchExecutor::New();
+	batch->SetExecutableName( args[0] );
+	batch->SetPluginLoader( plugins );
+	
+	std::string summary;
+	for( int i=3; i<narg; i++ )
+	{
+		if( strcmp( args[i], "--jobs" )==0 && i+1<narg )
+			batch->SetNumberOfConcurrentJobs( atoi( args[++i] ) );
+		else if( strcmp( args[i], "--threads" )==0 && i+1<narg )
+			batch->SetThreadBudget( atoi( args[++i] ) );
+		else if( strcmp( args[i], "--summary" )==0 && i+1<narg )
+			summary = args[++i];
+		else
+		{
+			std::cerr << "Error: unknown batch option " << args[i] << std::endl;
+			return EXIT_FAILURE;
+		}
 	}
+	
+	if( narg<3 || !batch->ReadJobFile( args[2] ) )
+	{
+		std::cerr << "Error: cannot read the job file" << std::endl;
+		return EXIT_FAILURE;
+	}
+	
+	const unsigned int failures = batch->Run();
+	if( summary.empty() )
+		batch->WriteSummary( std::cout );
+	else
+	{
+		std::ofstream file( summary.c_str() );
+		batch->WriteSummary( file );
+	}
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
 
-	return returnValue;
+
+/** Run a command line without the executable options: the commands, or
+    a batch, after the profiling options. Also runs the requests of the
+    server, in its workers. */
+int RunCommandLine (int argc, char *argv[], void *clientData)
+{
+	itk::CommandPluginLoader *plugins = static_cast<itk::CommandPluginLoader*>(clientData);
+	
+	// --profile reports each command on std::cerr, --profile-json file
+	// appends one JSON line per command to file
+	itk::CommandProfiler::Pointer profiler;
+	std::ofstream profileFile;
+	std::vector<char*> arguments( 1, argv[0] );
+	int option = 1;
+	for( ; option<argc && strncmp( argv[option], "--profile", 9 )==0; option++ )
+	{
+		profiler = itk::CommandProfiler::New();
+		if( strcmp( argv[option], "--profile-json" )==0 && option+1<argc )
+			profileFile.open( argv[++option], std::ios::app );
+	}
+	arguments.insert( arguments.end(), argv + option, argv + argc );
+	int narg = static_cast<int>(arguments.size());
+	char **args = &arguments[0];
+	
+	if (narg<2) {
+		itk::CommandObjectFactory::PrintHelp( std::cout, 0, plugins->GetCommandDescriptions() );
+		std::cout << "\nUsage: " << args[0] << " [--profile | --profile-json file] command [arguments] [! command [arguments] ...]\n"
+		          << "       " << args[0] << " --help-json (commands and their arguments, as JSON)\n"
+		          << "       " << args[0] << " --batch jobs.txt [--jobs N] [--threads N] [--summary file]\n"
+		          << "       " << args[0] << " --serve [socket] [--workers N] (then run programFactoryClient command ...)\n";
+		return EXIT_FAILURE;
+	}
+	
+	if( strcmp( args[1], "--help-json" )==0 )
+	{
+		plugins->LoadAllPlugins();
+		itk::CommandObjectFactory::PrintHelpJSON( std::cout, plugins->GetCommandDescriptions() );
+		return EXIT_SUCCESS;
+	}
+	if( strcmp( args[1], "--batch" )==0 )
+		return RunBatch( narg, args, plugins );
+	return RunPipeline( narg, args, plugins, profiler, profileFile.is_open() ? &profileFile : 0 );
+}
+
+
+/** --serve [socket] [--workers N]: stay resident, running the command
+    lines of programFactoryClient with every plugin already loaded. */
+int Serve (int narg, char *args[], itk::CommandPluginLoader *plugins)
+{
+	itk::CommandServer::Pointer server = itk::CommandServer::New();
+	server->SetExecutableName( args[0] );
+	server->SetRequestHandler( RunCommandLine, plugins );
+	for( int i=2; i<narg; i++ )
+	{
+		if( strcmp( args[i], "--workers" )==0 && i+1<narg )
+			server->SetMaximumNumberOfWorkers( atoi( args[++i] ) );
+		else
+			server->SetSocketPath( args[i] );
+	}
+	
+	plugins->LoadAllPlugins();
+	std::cout << "Serving on " << server->GetSocketPath() << std::endl;
+	return server->Serve() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+int main (int narg, char *args[])
+{
+
+	itk::HelloWorldCommandFactory::RegisterOneFactory();
+
+	// the other commands come from the plugins of IPF_COMMAND_PATH,
+	// loaded only when asked for
+	itk::CommandPluginLoader::Pointer plugins = itk::CommandPluginLoader::New();
+	plugins->SetSearchPathFromEnvironment();
+	
+	if( narg>1 && strcmp( args[1], "--serve" )==0 )
+		return Serve( narg, args, plugins );
+	return RunCommandLine( narg, args, plugins );
 
 }
@@ -0,0 +1,141 @@
+/*=========================================================================
+
+  Program:   ITK Program Factory
+  Module:    $RCSfile: $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) INRIA Saclay Île-de-France, Parietal Research Team. All rights reserved.
+  See CodeCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "itkImage.h"
+#include "itkSharedMemoryImage.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+/**
+   Round trip of shm://name images: an image created in its segment is
+   written in place while the name still leads to it; reading unlinks
+   the name, and writing the image read then creates a new segment.
+   Segments whose header describes more pixels than they hold are
+   rejected.
+ */
+
+namespace
+{
+  typedef itk::Image<unsigned short, 3> ImageType;
+
+  unsigned int s_Checks = 0, s_Failures = 0;
+
+  void Check (bool passed, const char *what)
+  {
+    s_Checks++;
+    if (!passed)
+    {
+      std::cerr << "failed: " << what << std::endl;
+      s_Failures++;
+    }
+  }
+
+
+  itk::SharedMemoryImageSegment *GetSegment (const ImageType *image)
+  {
+    typedef itk::SharedMemoryImageContainer<unsigned long, ImageType::PixelType> ContainerType;
+    const ContainerType *container = dynamic_cast<const ContainerType*>(image->GetPixelContainer());
+    return container ? container->GetSegment() : 0;
+  }
+
+
+  bool HasPixels (const ImageType *image, unsigned long pixels, unsigned short first)
+  {
+    if (image->GetBufferedRegion().GetNumberOfPixels()!=pixels)
+      return false;
+    for (unsigned long i=0; i<pixels; i++)
+      if (image->GetBufferPointer()[i]!=static_cast<unsigned short>(first + i))
+        return false;
+    return true;
+  }
+
+
+  bool Throws (const char *filename)
+  {
+    try
+    {
+      itk::ReadSharedMemoryImage<ImageType> (filename);
+    }
+    catch (itk::ExceptionObject &)
+    {
+      return true;
+    }
+    return false;
+  }
+}
+
+
+int main (int, char *[])
+{
+  std::ostringstream name;
+  name << "shm://sharedMemoryImageTest-" << getpid();
+  const std::string filename = name.str();
+
+  ImageType::RegionType region;
+  ImageType::SizeType size;
+  size[0] = 5;
+  size[1] = 4;
+  size[2] = 3;
+  ImageType::IndexType index;
+  index.Fill (0);
+  region.SetSize (size);
+  region.SetIndex (index);
+  ImageType::Pointer reference = ImageType::New();
+  reference->SetRegions (region);
+  const unsigned long pixels = region.GetNumberOfPixels();
+
+  try
+  {
+    // written in place while the name leads to its segment
+    ImageType::Pointer created = itk::CreateSharedMemoryImage<ImageType> (filename.c_str(), reference);
+    for (unsigned long i=0; i<pixels; i++)
+      created->GetBufferPointer()[i] = static_cast<unsigned short>(i);
+    itk::WriteSharedMemoryImage<ImageType> (created, filename.c_str());
+    Check (GetSegment (created) && GetSegment (created)->IsLinked(), "write in place");
+
+    // reading consumes the name
+    ImageType::Pointer read = itk::ReadSharedMemoryImage<ImageType> (filename.c_str());
+    Check (HasPixels (read, pixels, 0), "pixels read");
+    Check (!itk::SharedMemoryImageSegment::Exists (filename.c_str()) && !GetSegment (created)->IsLinked(),
+           "unlinking by the reader");
+
+    // an unlinked image is written again, not taken as in place
+    for (unsigned long i=0; i<pixels; i++)
+      read->GetBufferPointer()[i] = static_cast<unsigned short>(i + 100);
+    itk::WriteSharedMemoryImage<ImageType> (read, filename.c_str());
+    Check (itk::SharedMemoryImageSegment::Exists (filename.c_str()), "write of an unlinked image");
+    ImageType::Pointer again = itk::ReadSharedMemoryImage<ImageType> (filename.c_str());
+    Check (HasPixels (again, pixels, 100) && GetSegment (again)!=GetSegment (read), "pixels written again");
+
+    // a header describing more pixels than the segment holds
+    ImageType::Pointer corrupt = itk::CreateSharedMemoryImage<ImageType> (filename.c_str(), reference);
+    const_cast<itk::SharedMemoryImageHeader*>(GetSegment (corrupt)->GetHeader())->Size[2] = 1UL << 20;
+    Check (Throws (filename.c_str()), "segment smaller than its image");
+  }
+  catch (itk::ExceptionObject &e)
+  {
+    std::cerr << e << std::endl;
+    s_Failures++;
+  }
+  itk::SharedMemoryImageSegment::Unlink (filename.c_str());
+
+  std::cout << s_Checks - s_Failures << " of " << s_Checks << " checks passed" << std::endl;
+  return s_Failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}